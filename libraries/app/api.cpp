@@ -245,19 +245,54 @@ namespace graphene { namespace app {
 	vector<transaction_id_type> transaction_api::list_transactions(uint32_t blocknum , uint32_t nums)
 	{
 		vector<transaction_id_type> result;
-		const auto& history_idx = _app.chain_database()->get_index_type<history_transaction_index>();
-		int32_t ncount = 0;
-		history_idx.inspect_all_objects([&](const object& obj) {
-			const history_transaction_object& p = static_cast<const history_transaction_object&>(obj);
-			if (p.block_num >= blocknum && ncount <= nums)
+		const auto& by_block_idx = _app.chain_database()->get_index_type<history_transaction_index>().indices().get<by_block_num>();
+		for (auto itr = by_block_idx.lower_bound(blocknum); itr != by_block_idx.end() && result.size() < nums; ++itr)
+			result.push_back(itr->trx_id);
+		return result;
+	}
+
+	namespace {
+		/** walks [start, end) of an index ordered by (..., block_num, id) and fills a page of at most limit entries */
+		template<typename Iterator>
+		transaction_history_page make_transaction_history_page(Iterator start, Iterator end, uint32_t end_block, uint32_t limit)
+		{
+			transaction_history_page page;
+			for (; start != end && start->block_num <= end_block; ++start)
 			{
-				ncount++;
-				auto trx_op = _app.chain_database()->fetch_trx(p.trx_id);
-				if (trx_op.valid())
-					result.push_back((*trx_op).trx_id);
+				if (page.entries.size() == limit)
+				{
+					transaction_history_cursor next;
+					next.block_num = page.entries.back().block_num;
+					next.id = page.entries.back().id;
+					page.next = next;
+					break;
+				}
+				page.entries.push_back(*start);
 			}
-		});
-		return result;
+			return page;
+		}
+	}
+
+	transaction_history_page transaction_api::list_transactions_page(uint32_t start_block, uint32_t end_block, uint32_t limit,
+		optional<transaction_history_cursor> after)
+	{
+		FC_ASSERT(limit > 0 && limit <= 1000);
+		const auto& by_block_idx = _app.chain_database()->get_index_type<history_transaction_index>().indices().get<by_block_num>();
+		auto start = after.valid() && after->block_num >= start_block
+			? by_block_idx.upper_bound(boost::make_tuple(after->block_num, after->id))
+			: by_block_idx.lower_bound(start_block);
+		return make_transaction_history_page(start, by_block_idx.end(), end_block, limit);
+	}
+
+	transaction_history_page transaction_api::list_address_transactions(const address& addr, uint32_t start_block, uint32_t end_block, uint32_t limit,
+		optional<transaction_history_cursor> after)
+	{
+		FC_ASSERT(limit > 0 && limit <= 1000);
+		const auto& by_addr_idx = _app.chain_database()->get_index_type<history_transaction_index>().indices().get<by_addr_block_num>();
+		auto start = after.valid() && after->block_num >= start_block
+			? by_addr_idx.upper_bound(boost::make_tuple(addr, after->block_num, after->id))
+			: by_addr_idx.lower_bound(boost::make_tuple(addr, start_block));
+		return make_transaction_history_page(start, by_addr_idx.upper_bound(addr), end_block, limit);
 	}
 	void transaction_api::set_tracked_addr(const address& addr)
 	{
@@ -555,6 +555,7 @@ namespace graphene {
             _chain_db->add_checkpoints(loaded_checkpoints);
 
             bool replay = false;
+            bool unclean_shutdown = false;
             std::string replay_reason = "reason not provided";
 
             // never replay if data dir is empty
@@ -568,6 +569,7 @@ namespace graphene {
               else if (!clean)
               {
                 replay = true;
+                unclean_shutdown = true;
                 replay_reason = "unclean shutdown detected";
               }
               else if (!fc::exists(_data_dir / "db_version"))
@@ -606,6 +608,12 @@ namespace graphene {
                 }
                 _chain_db->open(_data_dir / "blockchain", initial_state);
               }
+              catch (const graphene::db::corrupted_index_file& e)
+              {
+                // a damaged snapshot is not silently replaced by a replay, let the operator decide
+                elog("Object database is corrupted, restart with --replay-blockchain to rebuild it: ${e}", ("e", e.to_detail_string()));
+                throw;
+              }
               catch (const fc::exception& e)
               {
                 ilog("Caught exception ${e} in open()", ("e", e.to_detail_string()));
@@ -614,6 +622,21 @@ namespace graphene {
                 replay_reason = "exception in open()";
               }
             }
+            _chain_db->set_state_snapshot_interval(_options->at("state-snapshot-interval").as<uint32_t>());
+            if (replay && unclean_shutdown)
+            {
+              try
+              {
+                if (_chain_db->open_from_state_snapshot(_data_dir / "blockchain"))
+                  replay = false;
+                else
+                  ilog("No usable state snapshot found");
+              }
+              catch (const fc::exception& e)
+              {
+                elog("Failed to open state snapshot: ${e}", ("e", e.to_detail_string()));
+              }
+            }
             if (replay)
             {
               ilog("Replaying blockchain due to: ${reason}", ("reason", replay_reason));
@@ -891,7 +914,8 @@ namespace graphene {
                 ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
               FC_ASSERT(opt_block.valid());
               // ilog("Serving up block #${num}", ("num", opt_block->block_num()));
-              return block_message(std::move(*opt_block));
+              // the requested id is the block id, no need to hash the header again
+              return block_message(*opt_block, id.item_hash);
             }
             return trx_message(_chain_db->get_recent_transaction(id.item_hash));
           } FC_CAPTURE_AND_RETHROW((id))
@@ -1178,6 +1202,7 @@ namespace graphene {
         ("seed-node,s", bpo::value<vector<string>>()->composing(), "P2P nodes to connect to on startup (may specify multiple times)")
         ("seed-nodes", bpo::value<string>()->composing(), "JSON array of P2P nodes to connect to on startup")
         ("checkpoint,c", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
+        ("state-snapshot-interval", bpo::value<uint32_t>()->default_value(0), "Save a state snapshot every this many irreversible blocks, used instead of a full replay after an unclean shutdown. Block processing stops while a snapshot is written (0 to disable)")
         ("rpc-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8090"), "Endpoint for websocket RPC to listen on")
         ("rpc-tls-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8089"), "Endpoint for TLS websocket RPC to listen on")
         ("server-pem,p", bpo::value<string>()->implicit_value("server.pem"), "The TLS certificate file for this server")
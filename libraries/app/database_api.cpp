@@ -27,6 +27,9 @@
 
 #include <fc/bloom_filter.hpp>
 #include <fc/smart_ref_impl.hpp>
+#include <fc/io/raw_variant.hpp>
+#include <fc/thread/scoped_lock.hpp>
+#include <fc/thread/thread.hpp>
 
 #include <fc/crypto/hex.hpp>
 
@@ -41,6 +44,10 @@
 #include <cfenv>
 #include <iostream>
 #define GET_REQUIRED_FEES_MAX_RECURSION 4
+/** batches a subscriber may have waiting before they are merged into one */
+#define GRAPHENE_MAX_PENDING_SUBSCRIPTION_BATCHES 64
+/** objects whose last sent state a session keeps to compute field deltas */
+#define GRAPHENE_MAX_SUBSCRIPTION_DELTA_OBJECTS 100000
 
 typedef std::map< std::pair<graphene::chain::asset_id_type, graphene::chain::asset_id_type>, std::vector<fc::variant> > market_queue_type;
 
@@ -48,6 +55,86 @@ namespace graphene { namespace app {
 
 class database_api_impl;
 
+/**
+ * Variants of the objects reported by one new/changed/removed notification of the database, built once and
+ * shared by every database_api session of that database.
+ */
+class changed_object_variants
+{
+   public:
+      explicit changed_object_variants( graphene::chain::database& db );
+      ~changed_object_variants();
+
+      static std::shared_ptr<changed_object_variants> get( graphene::chain::database& db );
+
+      /** the sessions pack their deltas and call their subscribe callbacks here instead of on the chain thread */
+      static fc::thread& delivery_thread();
+
+      const variant& full( const object& obj );
+
+   private:
+      void reset() { _full.clear(); }
+
+      static std::mutex                                                                             registry_mutex;
+      static std::map<const graphene::chain::database*, std::weak_ptr<changed_object_variants>>    registry;
+
+      const graphene::chain::database*     _db;
+      std::map<object_id_type, variant>    _full;
+      boost::signals2::scoped_connection   _new_connection;
+      boost::signals2::scoped_connection   _change_connection;
+      boost::signals2::scoped_connection   _removed_connection;
+};
+
+std::mutex changed_object_variants::registry_mutex;
+std::map<const graphene::chain::database*, std::weak_ptr<changed_object_variants>> changed_object_variants::registry;
+
+changed_object_variants::changed_object_variants( graphene::chain::database& db ):_db(&db)
+{
+   // connected in front of the sessions so the cache is reset before any of them reads it
+   _new_connection = db.new_objects.connect( boost::signals2::at_front,
+      [this]( const vector<object_id_type>&, const flat_set<account_id_type>& ) { reset(); } );
+   _change_connection = db.changed_objects.connect( boost::signals2::at_front,
+      [this]( const vector<object_id_type>&, const flat_set<account_id_type>& ) { reset(); } );
+   _removed_connection = db.removed_objects.connect( boost::signals2::at_front,
+      [this]( const vector<object_id_type>&, const vector<const object*>&, const flat_set<account_id_type>& ) { reset(); } );
+}
+
+changed_object_variants::~changed_object_variants()
+{
+   fc::scoped_lock<std::mutex> lock( registry_mutex );
+   // get() may already have replaced this cache with a new one for the same database
+   auto itr = registry.find( _db );
+   if( itr != registry.end() && itr->second.expired() )
+      registry.erase( itr );
+}
+
+std::shared_ptr<changed_object_variants> changed_object_variants::get( graphene::chain::database& db )
+{
+   fc::scoped_lock<std::mutex> lock( registry_mutex );
+   auto result = registry[&db].lock();
+   if( !result )
+   {
+      result = std::make_shared<changed_object_variants>( db );
+      registry[&db] = result;
+   }
+   return result;
+}
+
+fc::thread& changed_object_variants::delivery_thread()
+{
+   // never owned by a session, the last reference to a session may be dropped on this thread
+   static fc::thread thread( "subscription_delivery" );
+   return thread;
+}
+
+const variant& changed_object_variants::full( const object& obj )
+{
+   auto itr = _full.find( obj.id );
+   if( itr == _full.end() )
+      itr = _full.emplace( obj.id, obj.to_variant() ).first;
+   return itr->second;
+}
+
 
 class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 {
@@ -60,6 +147,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 
       // Subscriptions
       void set_subscribe_callback( std::function<void(const variant&)> cb, bool notify_remove_create );
+      void set_subscription_deltas( bool enabled );
       void set_pending_transaction_callback( std::function<void(const variant&)> cb );
       void set_block_applied_callback( std::function<void(const variant& block_id)> cb );
       void cancel_all_subscriptions();
@@ -236,11 +324,14 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 
          auto sub = _market_subscriptions.find( market );
          if( sub != _market_subscriptions.end() ) {
-            queue[market].emplace_back( full_object ? obj->to_variant() : fc::variant(obj->id) );
+            queue[market].emplace_back( full_object ? _changed_variants->full( *obj ) : fc::variant(obj->id) );
          }
       }
 
+      /** { "id": id, "delta": { changed fields } } against the state last sent to this session, else the full object */
+      variant delta_variant( const variant& current );
       void broadcast_updates( const vector<variant>& updates );
+      void deliver_pending_updates();
       void broadcast_market_updates( const market_queue_type& queue);
       void handle_object_changed(bool force_notify, bool full_object, const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts, std::function<const object*(object_id_type id)> find_object);
 
@@ -251,6 +342,9 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       void on_applied_block();
 
       bool _notify_remove_create = false;
+      /** last state sent to this session of every object it gets deltas for, each session has its own base.
+       *  only used on the delivery thread */
+      std::map<object_id_type, variant> _sent_states;
       mutable fc::bloom_filter _subscribe_filter;
       std::set<account_id_type> _subscribed_accounts;
       std::function<void(const fc::variant&)> _subscribe_callback;
@@ -264,6 +358,18 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       boost::signals2::scoped_connection                                                                                           _pending_trx_connection;
       map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> >      _market_subscriptions;
       graphene::chain::database&                                                                                                            _db;
+      std::shared_ptr<changed_object_variants>                                                                                              _changed_variants;
+
+      /** guards the delivery queue, the subscribe callback and the delta settings, which the delivery thread reads */
+      std::mutex                                                                                                                            _delivery_mutex;
+      /** full objects and ids of removed objects, turned into deltas on the delivery thread */
+      std::deque<vector<variant>>                                                                                                           _pending_updates;
+      bool                                                                                                                                  _delivery_scheduled = false;
+      bool                                                                                                                                  _subscription_deltas = false;
+      /** set when _sent_states is to be cleared before the next batch */
+      bool                                                                                                                                  _reset_sent_states = false;
+      /** removed objects to drop from _sent_states before the next batch */
+      vector<object_id_type>                                                                                                                _removed_sent_states;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -277,7 +383,7 @@ database_api::database_api( graphene::chain::database& db )
 
 database_api::~database_api() {}
 
-database_api_impl::database_api_impl( graphene::chain::database& db ):_db(db)
+database_api_impl::database_api_impl( graphene::chain::database& db ):_db(db),_changed_variants(changed_object_variants::get(db))
 {
    wlog("creating database api ${x}", ("x",int64_t(this)) );
    _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) {
@@ -351,7 +457,13 @@ void database_api::set_subscribe_callback( std::function<void(const variant&)> c
 void database_api_impl::set_subscribe_callback( std::function<void(const variant&)> cb, bool notify_remove_create )
 {
    //edump((clear_filter));
-   _subscribe_callback = cb;
+   {
+      fc::scoped_lock<std::mutex> lock( _delivery_mutex );
+      _subscribe_callback = cb;
+      _pending_updates.clear();
+      // dropped batches may have carried states the deltas would build on
+      _reset_sent_states = true;
+   }
    _notify_remove_create = notify_remove_create;
    _subscribed_accounts.clear();
 
@@ -363,6 +475,18 @@ void database_api_impl::set_subscribe_callback( std::function<void(const variant
    _subscribe_filter = fc::bloom_filter(param);
 }
 
+void database_api::set_subscription_deltas( bool enabled )
+{
+   my->set_subscription_deltas( enabled );
+}
+
+void database_api_impl::set_subscription_deltas( bool enabled )
+{
+   fc::scoped_lock<std::mutex> lock( _delivery_mutex );
+   _subscription_deltas = enabled;
+   _reset_sent_states = true;
+}
+
 static void load_apis_in_contract_object_if_native(contract_object& cont) {
 	// if is native contract, get contract apis and fill it
     if(cont.type_of_contract == contract_type::native_contract) {
@@ -3455,14 +3579,137 @@ vector<optional<multisig_address_object>> database_api_impl::get_multisig_addres
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
+vector<variant> coalesce_subscription_updates( const std::deque<vector<variant>>& batches )
+{
+   vector<variant> result;
+   std::map<string, size_t> positions;
+   auto id_of = []( const variant& v ) -> string {
+      if( v.is_object() && v.get_object().contains( "id" ) )
+         return v.get_object()["id"].as_string();
+      return v.as_string();
+   };
+   for( const auto& batch : batches )
+   {
+      for( const auto& update : batch )
+      {
+         auto id = id_of( update );
+         auto pos = positions.find( id );
+         if( pos == positions.end() )
+         {
+            positions[id] = result.size();
+            result.push_back( update );
+            continue;
+         }
+         variant& queued = result[pos->second];
+         const bool is_delta = update.is_object() && update.get_object().contains( "delta" );
+         if( is_delta && queued.is_object() )
+         {
+            const bool queued_delta = queued.get_object().contains( "delta" );
+            fc::mutable_variant_object merged( queued_delta ? queued.get_object()["delta"].get_object() : queued.get_object() );
+            for( const auto& entry : update.get_object()["delta"].get_object() )
+               merged( entry.key(), entry.value() );
+            if( queued_delta )
+               queued = fc::mutable_variant_object( "id", queued.get_object()["id"] )( "delta", merged );
+            else
+               queued = merged;
+         }
+         else
+            queued = update;
+      }
+   }
+   return result;
+}
+
+variant database_api_impl::delta_variant( const variant& current )
+{
+   auto id = current.get_object()["id"].as<object_id_type>();
+   auto prev = _sent_states.find( id );
+   if( prev == _sent_states.end() )
+   {
+      // sent in full, tracked from now on
+      if( _sent_states.size() >= GRAPHENE_MAX_SUBSCRIPTION_DELTA_OBJECTS )
+         _sent_states.clear();
+      _sent_states.emplace( id, current );
+      return current;
+   }
+   variant result = current;
+   if( current.is_object() && prev->second.is_object() )
+   {
+      const auto& current_obj = current.get_object();
+      const auto& prev_obj = prev->second.get_object();
+      fc::mutable_variant_object changed;
+      for( const auto& entry : current_obj )
+      {
+         auto old_value = prev_obj.find( entry.key() );
+         if( old_value == prev_obj.end() || fc::raw::pack( old_value->value() ) != fc::raw::pack( entry.value() ) )
+            changed( entry.key(), entry.value() );
+      }
+      result = fc::mutable_variant_object( "id", id )( "delta", changed );
+   }
+   prev->second = current;
+   return result;
+}
+
 void database_api_impl::broadcast_updates( const vector<variant>& updates )
 {
    if( updates.size() && _subscribe_callback ) {
-      auto capture_this = shared_from_this();
-      fc::async([capture_this,updates](){
-          if(capture_this->_subscribe_callback)
-            capture_this->_subscribe_callback( fc::variant(updates) );
-      });
+      fc::scoped_lock<std::mutex> lock( _delivery_mutex );
+      _pending_updates.push_back( updates );
+      // a subscriber that falls behind gets its backlog merged instead of an unbounded queue
+      if( _pending_updates.size() > GRAPHENE_MAX_PENDING_SUBSCRIPTION_BATCHES )
+      {
+         auto merged = coalesce_subscription_updates( _pending_updates );
+         _pending_updates.clear();
+         _pending_updates.push_back( std::move( merged ) );
+      }
+      if( !_delivery_scheduled )
+      {
+         _delivery_scheduled = true;
+         auto capture_this = shared_from_this();
+         changed_object_variants::delivery_thread().async( [capture_this](){
+            capture_this->deliver_pending_updates();
+         }, "deliver_pending_updates" );
+      }
+   }
+}
+
+void database_api_impl::deliver_pending_updates()
+{
+   while( true )
+   {
+      vector<variant> batch;
+      std::function<void(const fc::variant&)> callback;
+      bool deltas = false;
+      {
+         fc::scoped_lock<std::mutex> lock( _delivery_mutex );
+         if( _reset_sent_states )
+            _sent_states.clear();
+         _reset_sent_states = false;
+         for( const auto& id : _removed_sent_states )
+            _sent_states.erase( id );
+         _removed_sent_states.clear();
+         if( _pending_updates.empty() || !_subscribe_callback )
+         {
+            _pending_updates.clear();
+            _delivery_scheduled = false;
+            return;
+         }
+         batch = std::move( _pending_updates.front() );
+         _pending_updates.pop_front();
+         callback = _subscribe_callback;
+         deltas = _subscription_deltas;
+      }
+      if( deltas )
+      {
+         for( auto& update : batch )
+            if( update.is_object() )
+               update = delta_variant( update );
+      }
+      try {
+         callback( fc::variant( batch ) );
+      } catch( const fc::exception& e ) {
+         wlog( "subscription notification failed: ${e}", ("e", e.to_detail_string()) );
+      }
    }
 }
 
@@ -3484,6 +3731,18 @@ void database_api_impl::broadcast_market_updates( const market_queue_type& queue
 
 void database_api_impl::on_objects_removed( const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts)
 {
+   {
+      // the base is cleared anyway when deltas are turned on
+      fc::scoped_lock<std::mutex> lock( _delivery_mutex );
+      if( _subscription_deltas )
+         _removed_sent_states.insert( _removed_sent_states.end(), ids.begin(), ids.end() );
+      // bounded like the base itself while no batch is delivered
+      if( _removed_sent_states.size() >= GRAPHENE_MAX_SUBSCRIPTION_DELTA_OBJECTS )
+      {
+         _removed_sent_states.clear();
+         _reset_sent_states = true;
+      }
+   }
    handle_object_changed(_notify_remove_create, false, ids, impacted_accounts,
       [objs](object_id_type id) -> const object* {
          auto it = std::find_if(
@@ -3527,7 +3786,7 @@ void database_api_impl::handle_object_changed(bool force_notify, bool full_objec
                auto obj = find_object(id);
                if( obj )
                {
-                  updates.emplace_back( obj->to_variant() );
+                  updates.emplace_back( _changed_variants->full( *obj ) );
                }
             }
             else
@@ -82,6 +82,20 @@ namespace graphene { namespace app {
       asset_id_type   asset_id;
       int             count;
    };
+
+   /** position of the last entry of a history page, pass it back to get the next page */
+   struct transaction_history_cursor
+   {
+      uint32_t        block_num = 0;
+      object_id_type  id;
+   };
+
+   struct transaction_history_page
+   {
+      vector<history_transaction_object>   entries;
+      /** set when more entries may follow */
+      optional<transaction_history_cursor> next;
+   };
    
    /**
    * @brief The history_api class implements the RPC API for transaction
@@ -96,6 +110,21 @@ namespace graphene { namespace app {
 	   optional<trx_object> fetch_trx(transaction_id_type trx_id);
 	   optional<graphene::chain::full_transaction> get_transaction(transaction_id_type trx_id);
 	   vector<transaction_id_type> list_transactions(uint32_t blocknum=0,uint32_t nums=-1);
+	   /**
+	    * @brief Get the tracked transaction history in block order
+	    * @param start_block first block to include
+	    * @param end_block last block to include
+	    * @param limit maximum number of entries to return, 1 to 1000
+	    * @param after cursor returned with the previous page, the page starts right after it
+	    */
+	   transaction_history_page list_transactions_page(uint32_t start_block, uint32_t end_block, uint32_t limit,
+	                                                    optional<transaction_history_cursor> after = optional<transaction_history_cursor>());
+	   /**
+	    * @brief Get the tracked transaction history of one address in block order
+	    * @see list_transactions_page
+	    */
+	   transaction_history_page list_address_transactions(const address& addr, uint32_t start_block, uint32_t end_block, uint32_t limit,
+	                                                      optional<transaction_history_cursor> after = optional<transaction_history_cursor>());
 	   void set_tracked_addr(const address& addr);
    private:
 	   application & _app;
@@ -448,6 +477,8 @@ FC_REFLECT( graphene::app::verify_range_proof_rewind_result,
 
 FC_REFLECT( graphene::app::account_asset_balance, (name)(account_id)(amount) );
 FC_REFLECT( graphene::app::asset_holders, (asset_id)(count) );
+FC_REFLECT( graphene::app::transaction_history_cursor, (block_num)(id) );
+FC_REFLECT( graphene::app::transaction_history_page, (entries)(next) );
 
 FC_API(graphene::app::history_api,
        (get_account_history)
@@ -475,6 +506,8 @@ FC_API(graphene::app::localnode_api,
 FC_API(graphene::app::transaction_api,
 	(get_transaction)
 	(list_transactions)
+	(list_transactions_page)
+	(list_address_transactions)
 	(set_tracked_addr)
 	)
 FC_API(graphene::app::network_broadcast_api,
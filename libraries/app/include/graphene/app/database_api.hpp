@@ -57,6 +57,7 @@
 
 #include <boost/container/flat_set.hpp>
 
+#include <deque>
 #include <functional>
 #include <map>
 #include <memory>
@@ -113,6 +114,13 @@ struct market_trade
    double                     value;
 };
 
+/**
+ * Merges the waiting notification batches of a slow subscriber into one, keeping only the latest state of every
+ * object: a full object or removal replaces what was queued before it, a delta is folded into the queued object
+ * or delta.
+ */
+vector<variant> coalesce_subscription_updates( const std::deque<vector<variant>>& batches );
+
 /**
  * @brief The database_api class implements the RPC API for the chain database.
  *
@@ -144,6 +152,13 @@ class database_api
       ///////////////////
 
       void set_subscribe_callback( std::function<void(const variant&)> cb, bool clear_filter );
+      /**
+       * @brief Send changed objects as field deltas
+       *
+       * When enabled a changed object is notified as { "id": id, "delta": { changed fields } } against the state
+       * last sent to this session, objects it was not sent yet are still sent in full.
+       */
+      void set_subscription_deltas( bool enabled );
       void set_pending_transaction_callback( std::function<void(const variant&)> cb );
       void set_block_applied_callback( std::function<void(const variant& block_id)> cb );
       /**
@@ -698,6 +713,7 @@ FC_API(graphene::app::database_api,
 	(get_objects)
 
 	// Subscriptions
+	(set_subscription_deltas)
 	(cancel_all_subscriptions)
 
 	// Blocks and transactions
@@ -24,7 +24,14 @@
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/interprocess/file_mapping.hpp>
 #include <fc/smart_ref_impl.hpp>
+#include <fc/thread/scoped_lock.hpp>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace graphene { namespace chain {
 
@@ -39,6 +46,27 @@ FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
 
 namespace graphene { namespace chain {
 
+/** bytes of the blocks file asked to be paged in ahead of a sequential reader */
+static const uint64_t block_read_ahead_window = 8 * 1024 * 1024;
+
+block_database::mapped_file::mapped_file( const fc::path& p )
+{
+   _file_mapping.reset( new fc::file_mapping( p.generic_string().c_str(), fc::read_only ) );
+   _mapped_region.reset( new fc::mapped_region( *_file_mapping, fc::read_only ) );
+}
+
+block_database::mapped_file::~mapped_file() {}
+
+const char* block_database::mapped_file::data()const
+{
+   return (const char*)_mapped_region->get_address();
+}
+
+uint64_t block_database::mapped_file::size()const
+{
+   return _mapped_region->get_size();
+}
+
 void block_database::open( const fc::path& dbdir )
 { try {
    fc::create_directories(dbdir);
@@ -46,17 +74,24 @@ void block_database::open( const fc::path& dbdir )
 	 _blocks.clear();*/
    _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
    _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+   _index_path = dbdir/"index";
+   _blocks_path = dbdir/"blocks";
+   // index entries are written in place one at a time, so they go straight to the file
+   // and mapped readers see them without a flush
+   _block_num_to_pos.rdbuf()->pubsetbuf( nullptr, 0 );
 
-   if( !fc::exists( dbdir/"index" ) )
+   if( !fc::exists( _index_path ) )
    {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+     _block_num_to_pos.open( _index_path.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+     _blocks.open( _blocks_path.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
    }
    else
    {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+     _block_num_to_pos.open( _index_path.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+     _blocks.open( _blocks_path.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
    }
+   _index_size = fc::file_size( _index_path );
+   _blocks_size = fc::file_size( _blocks_path );
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
 bool block_database::is_open()const
@@ -66,6 +101,13 @@ bool block_database::is_open()const
 
 void block_database::close()
 {
+	{
+		fc::scoped_lock<std::mutex> lock(_map_mutex);
+		_blocks_map.reset();
+		_index_map.reset();
+	}
+	_index_size = 0;
+	_blocks_size = 0;
 	if (_blocks.is_open())
 		_blocks.close();
 	if (_block_num_to_pos.is_open())
@@ -95,20 +137,21 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
    e.block_size = vec.size();
    e.block_id   = id;
    _blocks.write( vec.data(), vec.size() );
+   // the block has to reach the file before its index entry so mapped readers never see a dangling entry
+   _blocks.flush();
+   _blocks_size = e.block_pos + e.block_size;
    _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   uint64_t index_end = sizeof( index_entry ) * uint64_t(num) + sizeof(e);
+   if( index_end > _index_size )
+      _index_size = index_end;
 }
 
 void block_database::remove( const block_id_type& id )
 { try {
    index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_index_entry( block_header::num_from_id(id), e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    if( e.block_id == id )
    {
       e.block_size = 0;
@@ -117,18 +160,60 @@ void block_database::remove( const block_id_type& id )
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
+block_database::mapped_file_ptr block_database::map_file( mapped_file_ptr& current, const fc::path& p,
+                                                          uint64_t file_size, uint64_t min_size )const
+{
+   fc::scoped_lock<std::mutex> lock(_map_mutex);
+   if( current && current->size() >= min_size )
+      return current;
+   if( !is_open() )
+      return mapped_file_ptr();
+   // the file only grows while it is open; lookups past its end keep the current mapping
+   if( file_size > 0 && min_size <= file_size && ( !current || file_size > current->size() ) )
+      current = std::make_shared<const mapped_file>( p );
+   return current;
+}
+
+bool block_database::read_index_entry( uint32_t block_num, index_entry& e )const
+{
+   uint64_t index_pos = uint64_t(sizeof(e)) * block_num;
+   auto index = map_file( _index_map, _index_path, _index_size, index_pos + sizeof(e) );
+   if( !index || index->size() < index_pos + sizeof(e) )
+      return false;
+   memcpy( (char*)&e, index->data() + index_pos, sizeof(e) );
+   return true;
+}
+
+optional<signed_block> block_database::read_block( const index_entry& e )const
+{
+   auto blocks = map_file( _blocks_map, _blocks_path, _blocks_size, e.block_pos + e.block_size );
+   FC_ASSERT( blocks && blocks->size() >= e.block_pos + e.block_size, "Block data past the end of the block database" );
+   read_ahead( *blocks, e.block_pos + e.block_size );
+   return fc::raw::unpack<signed_block>( blocks->data() + e.block_pos, e.block_size );
+}
+
+void block_database::read_ahead( const mapped_file& m, uint64_t pos )const
+{
+#ifndef WIN32
+   // only re-advise once the reader is halfway through the previous window
+   if( pos + block_read_ahead_window / 2 < _read_ahead_end || pos >= m.size() )
+      return;
+   static const uint64_t page_size = sysconf( _SC_PAGESIZE );
+   uint64_t start = pos & ~(page_size - 1);
+   uint64_t len = std::min<uint64_t>( block_read_ahead_window, m.size() - start );
+   madvise( (void*)(m.data() + start), len, MADV_WILLNEED );
+   _read_ahead_end = start + len;
+#endif
+}
+
 bool block_database::contains( const block_id_type& id )const
 {
    if( id == block_id_type() )
       return false;
 
    index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_index_entry( block_header::num_from_id(id), e ) )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
    return e.block_id == id && e.block_size > 0;
 }
@@ -137,14 +222,9 @@ block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
    index_entry e;
-   auto index_pos = sizeof(e)*block_num;
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= int64_t(index_pos) )
+   if( !read_index_entry( block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
    return e.block_id;
 }
@@ -154,22 +234,13 @@ optional<signed_block> block_database::fetch_optional( const block_id_type& id )
    try
    {
       index_entry e;
-      auto index_pos = sizeof(e)*block_header::num_from_id(id);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_header::num_from_id(id), e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
       if( e.block_id != id ) return optional<signed_block>();
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      if (e.block_size)
-         _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
+      auto result = read_block( e );
+      FC_ASSERT( result->id() == e.block_id );
       return result;
    }
    catch (const fc::exception&)
@@ -186,19 +257,16 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    try
    {
       index_entry e;
-      auto index_pos = sizeof(e)*block_num;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_num, e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+      // a sequential reader (reindex) gets the following blocks paged in ahead of time
+      if( block_num != _last_read_num + 1 )
+         _read_ahead_end = 0;
+      _last_read_num = block_num;
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
+      auto result = read_block( e );
+      FC_ASSERT( result->id() == e.block_id );
       return result;
    }
    catch (const fc::exception&)
@@ -210,34 +278,38 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    return optional<signed_block>();
 }
 
+optional<uint32_t> block_database::last_block_num()const
+{
+   if( !is_open() )
+      return optional<uint32_t>();
+   uint64_t size = _index_size;
+   if( size < sizeof(index_entry) )
+      return optional<uint32_t>();
+   auto index = map_file( _index_map, _index_path, size, size );
+   if( !index || index->size() < sizeof(index_entry) )
+      return optional<uint32_t>();
+
+   uint64_t count = index->size() / sizeof(index_entry);
+   index_entry e;
+   for( uint64_t num = count; num > 0; --num )
+   {
+      memcpy( (char*)&e, index->data() + (num - 1) * sizeof(e), sizeof(e) );
+      if( e.block_size > 0 )
+         return uint32_t(num - 1);
+   }
+   return optional<uint32_t>();
+}
+
 optional<signed_block> block_database::last()const
 {
    try
    {
+      auto num = last_block_num();
       index_entry e;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-
-      if( _block_num_to_pos.tellp() < sizeof(index_entry) )
-         return optional<signed_block>();
-
-      _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.end );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      uint64_t pos = _block_num_to_pos.tellg();
-      while( e.block_size == 0 && pos > 0 )
-      {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      }
-
-      if( e.block_size == 0 )
+      if( !num.valid() || !read_index_entry( *num, e ) )
          return optional<signed_block>();
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      return result;
+      return read_block( e );
    }
    catch (const fc::exception&)
    {
@@ -252,23 +324,9 @@ optional<block_id_type> block_database::last_id()const
 {
    try
    {
+      auto num = last_block_num();
       index_entry e;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-
-      if( _block_num_to_pos.tellp() < sizeof(index_entry) )
-         return optional<block_id_type>();
-
-      _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.end );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      uint64_t pos = _block_num_to_pos.tellg();
-      while( e.block_size == 0 && pos > 0 )
-      {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      }
-
-      if( e.block_size == 0 )
+      if( !num.valid() || !read_index_entry( *num, e ) )
          return optional<block_id_type>();
 
       return e.block_id;
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/contract_bytecode_cache.hpp>
+
+#include <fc/thread/scoped_lock.hpp>
+
+namespace graphene {
+	namespace chain {
+
+		contract_bytecode_cache::contract_bytecode_cache(size_t max_entries)
+			: _max_entries(max_entries)
+		{
+		}
+
+		std::string contract_bytecode_cache::make_key(const std::string& contract_key, const std::string& code_hash)
+		{
+			std::string key;
+			key.reserve(contract_key.size() + code_hash.size() + 1);
+			key.append(contract_key).push_back('\0');
+			key.append(code_hash);
+			return key;
+		}
+
+		contract_bytecode_cache::stream_ptr contract_bytecode_cache::get_or_load(const std::string& contract_key,
+			const uvm::blockchain::Code& code, const loader_type& loader)
+		{
+			if (code.code_hash.empty())
+				return loader(code);
+
+			auto key = make_key(contract_key, code.code_hash);
+			{
+				fc::scoped_lock<std::mutex> lock(_mutex);
+				auto itr = _entries.find(key);
+				if (itr != _entries.end())
+				{
+					_lru.splice(_lru.begin(), _lru, itr->second);
+					++_metrics.hits;
+					return itr->second->stream;
+				}
+				if (_max_entries > 0)
+					++_metrics.misses;
+			}
+
+			// build outside of the lock, a concurrent miss on the same key just keeps the first result
+			auto stream = loader(code);
+			if (!stream)
+				return stream;
+
+			fc::scoped_lock<std::mutex> lock(_mutex);
+			if (_max_entries == 0)
+				return stream;
+			auto itr = _entries.find(key);
+			if (itr != _entries.end())
+				return itr->second->stream;
+			_lru.push_front(entry{ contract_key, code.code_hash, stream });
+			_entries[key] = _lru.begin();
+			shrink_to(_max_entries);
+			return stream;
+		}
+
+		void contract_bytecode_cache::invalidate(const std::string& contract_key)
+		{
+			fc::scoped_lock<std::mutex> lock(_mutex);
+			for (auto itr = _lru.begin(); itr != _lru.end();)
+			{
+				if (itr->contract_key == contract_key)
+				{
+					_entries.erase(make_key(itr->contract_key, itr->code_hash));
+					itr = _lru.erase(itr);
+					++_metrics.invalidations;
+				}
+				else
+					++itr;
+			}
+		}
+
+		void contract_bytecode_cache::clear()
+		{
+			fc::scoped_lock<std::mutex> lock(_mutex);
+			_metrics.invalidations += _lru.size();
+			_entries.clear();
+			_lru.clear();
+		}
+
+		void contract_bytecode_cache::set_max_entries(size_t max_entries)
+		{
+			fc::scoped_lock<std::mutex> lock(_mutex);
+			_max_entries = max_entries;
+			shrink_to(_max_entries);
+		}
+
+		size_t contract_bytecode_cache::max_entries()const
+		{
+			fc::scoped_lock<std::mutex> lock(_mutex);
+			return _max_entries;
+		}
+
+		contract_bytecode_cache_metrics contract_bytecode_cache::get_metrics()const
+		{
+			fc::scoped_lock<std::mutex> lock(_mutex);
+			auto result = _metrics;
+			result.entries = _lru.size();
+			return result;
+		}
+
+		void contract_bytecode_cache::shrink_to(size_t max_entries)
+		{
+			while (_lru.size() > max_entries)
+			{
+				const auto& last = _lru.back();
+				_entries.erase(make_key(last.contract_key, last.code_hash));
+				_lru.pop_back();
+				++_metrics.evictions;
+			}
+		}
+
+		contract_bytecode_cache& contract_bytecode_cache::instance()
+		{
+			static contract_bytecode_cache cache;
+			return cache;
+		}
+
+	}
+}
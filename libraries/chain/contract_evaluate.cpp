@@ -2,6 +2,7 @@
 #include <graphene/chain/contract.hpp>
 #include <graphene/chain/storage.hpp>
 #include <graphene/chain/contract_entry.hpp>
+#include <graphene/chain/contract_bytecode_cache.hpp>
 #include <graphene/chain/contract_engine_builder.hpp>
 #include <graphene/chain/uvm_chain_api.hpp>
 #include <graphene/chain/database.hpp>
@@ -798,6 +799,8 @@ namespace graphene {
                 contract.contract_name = o.contract_name;
                 contract.contract_desc = o.contract_desc;
                 d.update_contract(contract);
+                contract_bytecode_cache::instance().invalidate(o.contract_id.operator fc::string());
+                contract_bytecode_cache::instance().invalidate(o.contract_name);
                 auto trx_id = get_current_trx_id();
                 // commit contract result to db
                 apply_storage_change(d, d.head_block_num(), trx_id);
@@ -1645,13 +1648,18 @@ namespace graphene {
                  address contract_addr(contract_id);
                  contracts.insert(contract_addr);
                  const auto &contract_storage_changes = pair1.second;
+                 // the invoke result keeps its changes for the result digest, the batch gets one copy to move from
+                 vector<contract_storage_write> writes;
+                 writes.reserve(contract_storage_changes.size());
                  for (const auto &pair2 : contract_storage_changes)
                  {
-                     const auto &storage_name = pair2.first;
-                     const auto &change = pair2.second;
-                     d.set_contract_storage(contract_addr, storage_name, change.after);
-                     d.add_contract_storage_change(trx_id, contract_addr, storage_name, change.storage_diff);
+                     contract_storage_write write;
+                     write.storage_name = pair2.first;
+                     write.value = pair2.second.after.storage_data;
+                     write.diff = pair2.second.storage_diff.storage_data;
+                     writes.push_back(std::move(write));
                  }
+                 d.apply_contract_storage_changes(trx_id, contract_addr, std::move(writes));
              }
              for(auto& addr:contracts)
              {
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/contract_storage_types.hpp>
+
+#include <fc/thread/scoped_lock.hpp>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene {
+	namespace chain {
+
+		namespace {
+			struct deref_hash
+			{
+				size_t operator()(const std::string* s)const { return std::hash<std::string>()(*s); }
+			};
+			struct deref_equal
+			{
+				bool operator()(const std::string* a, const std::string* b)const { return *a == *b; }
+			};
+
+			/**
+			 * Names are found by content through pointers into the entries, so each name is stored
+			 * once. An entry removes itself when its last storage_name_type goes away.
+			 */
+			class storage_name_pool
+			{
+			public:
+				typedef storage_name_type::entry entry;
+
+				std::shared_ptr<const entry> intern(const std::string& name)
+				{
+					fc::scoped_lock<std::mutex> lock(_mutex);
+					auto itr = _entries.find(&name);
+					if (itr != _entries.end())
+					{
+						auto existing = itr->second.lock();
+						if (existing)
+							return existing;
+						// the last owner is about to release it, its deleter will see the entry is gone
+						_entries.erase(itr);
+					}
+					entry* e = new entry{ name, std::hash<std::string>()(name) };
+					std::shared_ptr<const entry> result(e, [this](const entry* dead) { release(dead); });
+					_entries.emplace(&e->value, result);
+					return result;
+				}
+
+				size_t size()const
+				{
+					fc::scoped_lock<std::mutex> lock(_mutex);
+					return _entries.size();
+				}
+
+				// never destroyed, storage objects in static databases may outlive any static pool
+				static storage_name_pool& instance()
+				{
+					static storage_name_pool* pool = new storage_name_pool();
+					return *pool;
+				}
+
+			private:
+				void release(const entry* dead)
+				{
+					{
+						fc::scoped_lock<std::mutex> lock(_mutex);
+						auto itr = _entries.find(&dead->value);
+						if (itr != _entries.end() && itr->first == &dead->value)
+							_entries.erase(itr);
+					}
+					delete dead;
+				}
+
+				mutable std::mutex _mutex;
+				std::unordered_map<const std::string*, std::weak_ptr<const entry>, deref_hash, deref_equal> _entries;
+			};
+		}
+
+		void storage_name_type::assign(const std::string& name)
+		{
+			if (name.empty())
+				_entry.reset();
+			else if (!_entry || _entry->value != name)
+				_entry = storage_name_pool::instance().intern(name);
+		}
+
+		const std::string& storage_name_type::empty_string()
+		{
+			static const std::string empty;
+			return empty;
+		}
+
+		size_t storage_name_type::empty_hash()
+		{
+			static const size_t hash = std::hash<std::string>()(std::string());
+			return hash;
+		}
+
+		size_t storage_name_type::pool_size()
+		{
+			return storage_name_pool::instance().size();
+		}
+
+		void storage_value_type::assign(const char* data, size_t size)
+		{
+			FC_ASSERT(size <= UINT32_MAX);
+			if (size <= inline_capacity)
+			{
+				// data may point into our own heap block, copy before releasing it
+				char tmp[inline_capacity];
+				if (size && data)
+					memcpy(tmp, data, size);
+				release();
+				if (size && data)
+					memcpy(_data, tmp, size);
+			}
+			else
+			{
+				char* block = new char[size];
+				if (data)
+					memcpy(block, data, size);
+				release();
+				memcpy(_data, &block, sizeof(block));
+			}
+			_size = (uint32_t)size;
+		}
+
+	}
+}
+
+namespace fc
+{
+	void to_variant(const graphene::chain::storage_name_type& var, fc::variant& vo)
+	{
+		vo = var.str();
+	}
+
+	void from_variant(const fc::variant& var, graphene::chain::storage_name_type& vo)
+	{
+		vo = var.as_string();
+	}
+
+	void to_variant(const graphene::chain::storage_value_type& var, fc::variant& vo)
+	{
+		to_variant(var.to_vector(), vo);
+	}
+
+	void from_variant(const fc::variant& var, graphene::chain::storage_value_type& vo)
+	{
+		std::vector<char> value;
+		from_variant(var, value);
+		vo = value;
+	}
+}
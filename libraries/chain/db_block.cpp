@@ -35,7 +35,9 @@
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/evaluator.hpp>
+#include <graphene/db/worker_latch.hpp>
 #include <iostream>
+#include <thread>
 #include <fc/smart_ref_impl.hpp>
 
 namespace graphene { namespace chain {
@@ -49,9 +51,76 @@ bool database::is_known_block( const block_id_type& id )const
  * method is called with a VERY old transaction we will return false, they should
  * query things by blocks if they are that old.
  */
+void database::init_signature_threads()const
+{
+   if( !_signature_threads.empty() )
+      return;
+   // leave one core to the chain thread
+   uint32_t count = std::max( std::thread::hardware_concurrency(), 2u ) - 1;
+   for( uint32_t i = 0; i < count; ++i )
+      _signature_threads.emplace_back( new fc::thread( "signature_" + fc::to_string(i) ) );
+}
+
+void database::precompute_signature_keys( const vector<processed_transaction>& trxs )const
+{ try {
+   if( trxs.empty() )
+      return;
+   init_signature_threads();
+   const chain_id_type& chain_id = get_chain_id();
+   const size_t chunks = std::min( trxs.size(), _signature_threads.size() );
+   const size_t chunk_size = ( trxs.size() + chunks - 1 ) / chunks;
+   worker_latch done( chunks );
+   for( size_t i = 0; i < chunks; ++i )
+   {
+      size_t begin = i * chunk_size;
+      size_t end = std::min( begin + chunk_size, trxs.size() );
+      _signature_threads[i]->async( [&trxs, &chain_id, &done, begin, end]() {
+         for( size_t j = begin; j < end; ++j )
+         {
+            try {
+               trxs[j].cache_signature_keys( chain_id );
+            } catch( ... ) {
+               // left uncached, the serial verify_authority reports the error
+            }
+         }
+         done.count_down();
+      }, "precompute_signature_keys" );
+   }
+   done.wait();
+} FC_CAPTURE_AND_RETHROW() }
+
+void database::precompute_signature_keys( const signed_transaction& trx )const
+{ try {
+   if( trx.signatures.empty() )
+      return;
+   // a single transaction is recovered in place, handing it to a worker would only add a round trip
+   try {
+      trx.cache_signature_keys( get_chain_id() );
+   } catch( const fc::exception& ) {
+      // left uncached, the serial verify_authority reports the error
+   }
+} FC_CAPTURE_AND_RETHROW() }
+
 bool database::is_known_transaction( const transaction_id_type& id )const
 {
-	return fetch_trx(id).valid();
+	return has_trx(id);
+}
+
+bool database::has_trx(const transaction_id_type& trx_id) const
+{
+	const auto& dedupe_index = get_index_type<transaction_index>().indices().get<by_trx_id>();
+	if (dedupe_index.find(trx_id) != dedupe_index.end())
+		return true;
+	const auto& index = get_index_type<trx_index>().indices().get<by_trx_id>();
+	if (index.find(trx_id) != index.end())
+		return true;
+	// key probe only, the bloom filter of the transactions db answers most misses without touching disk
+	auto db = get_levelDB();
+	FC_ASSERT(db, "transaction api closed");
+	string out;
+	leveldb::ReadOptions read_options;
+	read_options.fill_cache = false;
+	return db->Get(read_options, trx_id.str(), &out).ok();
 }
 
 optional<trx_object> database::fetch_trx(const transaction_id_type trx_id) const
@@ -65,7 +134,7 @@ optional<trx_object> database::fetch_trx(const transaction_id_type trx_id) const
 		leveldb::Status sta = db->Get(read_options, trx_id.str(), &out);
 		if (sta.ok())
 		{
-			return fc::json::from_string(out).as<trx_object>();
+			return unpack_trx_record(out);
 		}	
 	}
 	catch (const fc::exception&)
@@ -141,10 +210,21 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
-      detail::without_pending_transactions( *this, std::move(_pending_tx),
+      detail::without_pending_transactions( *this, _pending_tx.take_all(),
       [&]()
       {
          result = _push_block(new_block);
+         // pending transactions are popped here, so the snapshot holds exactly the state of the head block
+         if( _state_snapshot_interval > 0 &&
+             get_dynamic_global_properties().last_irreversible_block_num >= _last_state_snapshot_block + _state_snapshot_interval )
+         {
+            try {
+               save_state_snapshot();
+            } catch( const fc::exception& e ) {
+               elog( "Failed to save state snapshot: ${e}", ("e",e.to_detail_string()) );
+               _last_state_snapshot_block = get_dynamic_global_properties().last_irreversible_block_num;
+            }
+         }
       });
    });
    return result;
@@ -292,6 +372,8 @@ bool database::_push_block(const signed_block& new_block)
  */
 processed_transaction database::push_transaction( const signed_transaction& trx, uint32_t skip )
 { try {
+   if( !(skip & (skip_transaction_signatures | skip_authority_check)) )
+      precompute_signature_keys( trx );
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -321,7 +403,7 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
    });
 
    //auto processed_trx = _apply_transaction( trx );
-   _pending_tx.push_back(processed_trx);
+   _pending_tx.add(processed_trx);
 
    // notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
@@ -495,6 +577,9 @@ signed_block database::_generate_block(
    // the value of the "when" variable is known, which means we need to
    // re-apply pending transactions in this method.
    //
+   // Transactions are tried in pending_transaction_pool::block_order(), their
+   // size, gas and contract op count were computed when they entered the pool.
+   //
    _pending_tx_session.reset();
    _pending_tx_session = _undo_db.start_undo_session();
    uint64_t postponed_tx_count = 0;
@@ -504,9 +589,22 @@ signed_block database::_generate_block(
    reset_current_collected_fee();
    map<string, int > temp_signature;
    _current_gas_in_block = 0;
-   for( const processed_transaction& tx : _pending_tx )
+   // expired transactions would only be rejected one by one by _apply_transaction
+   size_t expired_tx_count = _pending_tx.remove_expired( when );
+   // stop in time for the block to reach the other miners within the slot
+   const fc::time_point assembly_deadline = fc::time_point::now() + fc::milliseconds( get_global_properties().parameters.block_interval * 1000 / 4 );
+   const auto block_order = _pending_tx.block_order();
+   uint64_t postponed_tx_count_by_deadline = 0;
+   for( size_t i = 0; i < block_order.size(); ++i )
    {
-      size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
+      if( fc::time_point::now() > assembly_deadline )
+      {
+         postponed_tx_count_by_deadline = block_order.size() - i;
+         break;
+      }
+      const pending_transaction_entry& entry = *block_order[i];
+      const processed_transaction& tx = entry.trx;
+      size_t new_total_size = total_block_size + entry.size;
 	  bool continue_if = false;
       // postpone transaction if it would make block too big
       if( new_total_size >= maximum_block_size )
@@ -514,52 +612,9 @@ signed_block database::_generate_block(
          postponed_tx_count++;
          continue;
       }
-	  bool related_with_contract = false;
-	  int contract_op_in_trx = 0;
-	  gas_count_type gas_count = 0; 
-	  for (auto& op : tx.operations)
-	  {
-
-		  switch (op.which())
-		  {
-		  case operation::tag<chain::contract_register_operation>::value:
-		  {
-			  printf("Got A contract_register_operation\n");
-			  gas_count+=op.get<contract_register_operation>().init_cost;
-			  related_with_contract = true;
-			  contract_op_in_trx++;
-			  break;
-		  }
-		  case operation::tag<chain::contract_upgrade_operation>::value:
-		  {
-			  gas_count += op.get<contract_upgrade_operation>().invoke_cost;
-			  related_with_contract = true;
-			  contract_op_in_trx++;
-			  break;
-		  }
-		  case operation::tag<chain::contract_invoke_operation>::value:
-		  {
-			  gas_count += op.get<contract_invoke_operation>().invoke_cost;
-			  related_with_contract = true;
-			  contract_op_in_trx++;
-			  break;
-		  }
-		  case operation::tag<chain::transfer_contract_operation>::value:
-		  {
-			  gas_count += op.get<transfer_contract_operation>().invoke_cost;
-			  related_with_contract = true;
-			  contract_op_in_trx++;
-			  break;
-		  }
-		  case operation::tag<chain::native_contract_register_operation>::value:
-		  {
-			  gas_count += op.get<native_contract_register_operation>().init_cost;
-			  related_with_contract = true;
-			  contract_op_in_trx++;
-			  break;
-		  }
-		  }
-	  }
+	  bool related_with_contract = entry.contract_op_count > 0;
+	  int contract_op_in_trx = entry.contract_op_count;
+	  gas_count_type gas_count = entry.gas_count;
 	  if (related_with_contract&&(_current_gas_in_block+gas_count > _gas_limit_in_in_block))
 	  {
 		      printf("Gas limit block reached\n");
@@ -605,6 +660,14 @@ signed_block database::_generate_block(
    {
 	   wlog("Postponed ${n} transactions due to block contract op limit reached", ("n", postponed_tx_count_by_contract_op_limit));
    }
+   if( postponed_tx_count_by_deadline > 0 )
+   {
+      wlog( "Postponed ${n} transactions to produce the block in time", ("n", postponed_tx_count_by_deadline) );
+   }
+   if( expired_tx_count > 0 )
+   {
+      wlog( "Dropped ${n} expired pending transactions", ("n", expired_tx_count) );
+   }
    _pending_tx_session.reset();
 
 
@@ -704,7 +767,7 @@ void database::pop_block()
 
 void database::clear_pending()
 { try {
-   assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
+   assert( _pending_tx.empty() || _pending_tx_session.valid() );
    _pending_tx.clear();
    _pending_tx_session.reset();
 } FC_CAPTURE_AND_RETHROW() }
@@ -775,6 +838,9 @@ void database::_apply_block( const signed_block& next_block )
    _current_secret_key = next_block.previous_secret;
    _current_contract_call_num = 0;
   
+   if( !(skip & (skip_transaction_signatures | skip_authority_check)) )
+      precompute_signature_keys( next_block.transactions );
+
    map<string, int> temp_signature;
    for( const auto& trx : next_block.transactions )
    {
@@ -1018,7 +1084,7 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    const chain_id_type& chain_id = get_chain_id();
    auto trx_id = trx.id();    
    FC_ASSERT( (skip & skip_transaction_dupe_check) ||
-              !fetch_trx(trx_id).valid() );
+              !has_trx(trx_id) );
    transaction_evaluation_state eval_state(this);
    const chain_parameters& chain_parameters = get_global_properties().parameters;
    eval_state._trx = &trx;
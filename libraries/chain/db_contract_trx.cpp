@@ -16,7 +16,7 @@ namespace graphene {
 		StorageDataType database::get_contract_storage(const address& contract_id, const string& name)
 		{
 			try {
-				auto& storage_index = get_index_type<contract_storage_object_index>().indices().get<by_contract_id_storage_name>();
+				auto& storage_index = get_index_type<contract_storage_object_index>().indices().get<by_contract_id_storage_name_hash>();
 				auto storage_iter = storage_index.find(boost::make_tuple(contract_id, name));
 				if (storage_iter == storage_index.end())
 				{
@@ -32,7 +32,7 @@ namespace graphene {
 				{
 					const auto &storage_data = *storage_iter;
 					StorageDataType storage;
-					storage.storage_data = storage_data.storage_value;
+					storage.storage_data = storage_data.storage_value.to_vector();
 					return storage;
 				}
 			} FC_CAPTURE_AND_RETHROW((contract_id)(name));
@@ -41,15 +41,15 @@ namespace graphene {
 		std::map<std::string, StorageDataType> database::get_contract_all_storages(const address& contract_id) {
 			try {
 				std::map<std::string, StorageDataType> result;
-                                auto& storage_index = get_index_type<contract_storage_object_index>().indices().get<by_storage_contract_id>();
-                                auto storage_iter = storage_index.find(contract_id);
-                                while(storage_iter != storage_index.end() && storage_iter->contract_address == contract_id)
-                                {
-                                        StorageDataType storage;
-                                        storage.storage_data = storage_iter->storage_value;
-                                        result[storage_iter->storage_name] = storage;
-                                        ++storage_iter;
-                                }
+				auto& storage_index = get_index_type<contract_storage_object_index>().indices().get<by_contract_id_storage_name>();
+				auto storage_iter = storage_index.lower_bound(boost::make_tuple(contract_id));
+				// the index is already ordered by name, so every insert goes to the end of the map
+				while (storage_iter != storage_index.end() && storage_iter->contract_address == contract_id)
+				{
+					auto inserted = result.emplace_hint(result.end(), storage_iter->storage_name.str(), StorageDataType());
+					inserted->second.storage_data = storage_iter->storage_value.to_vector();
+					++storage_iter;
+				}
 				return result;
                         } FC_CAPTURE_AND_RETHROW((contract_id));
 		}
@@ -57,7 +57,7 @@ namespace graphene {
 		optional<contract_storage_object> database::get_contract_storage_object(const address& contract_id, const string& name)
 		{
 			try {
-				auto& storage_index = get_index_type<contract_storage_object_index>().indices().get<by_contract_id_storage_name>();
+				auto& storage_index = get_index_type<contract_storage_object_index>().indices().get<by_contract_id_storage_name_hash>();
 				auto storage_iter = storage_index.find(boost::make_tuple(contract_id, name));
 				if (storage_iter == storage_index.end())
 				{
@@ -77,7 +77,7 @@ namespace graphene {
 				auto itr = index.find(contract_id);
 				FC_ASSERT(itr != index.end());*/
 
-				auto& storage_index = get_index_type<contract_storage_object_index>().indices().get<by_contract_id_storage_name>();
+				auto& storage_index = get_index_type<contract_storage_object_index>().indices().get<by_contract_id_storage_name_hash>();
 				auto storage_iter = storage_index.find(boost::make_tuple(contract_id, name));
 				if (storage_iter == storage_index.end()) {
 					create<contract_storage_object>([&](contract_storage_object & obj) {
@@ -117,6 +117,56 @@ namespace graphene {
 				});
 			} FC_CAPTURE_AND_RETHROW((trx_id)(contract_id)(name)(diff));
 		}
+		void database::apply_contract_storage_changes(const transaction_id_type& trx_id, const address& contract_id, vector<contract_storage_write>&& changes)
+		{
+			try {
+				if (changes.empty())
+					return;
+				auto by_name = [](const contract_storage_write& a, const contract_storage_write& b) { return a.storage_name < b.storage_name; };
+				if (!std::is_sorted(changes.begin(), changes.end(), by_name))
+					std::stable_sort(changes.begin(), changes.end(), by_name);
+
+				auto& storage_index = get_index_type<contract_storage_object_index>().indices().get<by_contract_id_storage_name>();
+				auto storage_iter = storage_index.lower_bound(boost::make_tuple(contract_id, changes.front().storage_name));
+				for (auto& change : changes)
+				{
+					// changed names are usually close to each other, only seek again after a long gap
+					int steps = 0;
+					while (storage_iter != storage_index.end() && storage_iter->contract_address == contract_id
+						&& storage_iter->storage_name < change.storage_name)
+					{
+						if (++steps > 16)
+						{
+							storage_iter = storage_index.lower_bound(boost::make_tuple(contract_id, change.storage_name));
+							break;
+						}
+						++storage_iter;
+					}
+					if (storage_iter != storage_index.end() && storage_iter->contract_address == contract_id
+						&& storage_iter->storage_name == change.storage_name)
+					{
+						modify(*storage_iter, [&](contract_storage_object& obj) {
+							obj.storage_value = std::move(change.value);
+						});
+					}
+					else
+					{
+						// inserting does not invalidate storage_iter, it still points at the first name after this one
+						create<contract_storage_object>([&](contract_storage_object& obj) {
+							obj.contract_address = contract_id;
+							obj.storage_name = change.storage_name;
+							obj.storage_value = std::move(change.value);
+						});
+					}
+					create<transaction_contract_storage_diff_object>([&](transaction_contract_storage_diff_object& o) {
+						o.contract_address = contract_id;
+						o.storage_name = std::move(change.storage_name);
+						o.diff = std::move(change.diff);
+						o.trx_id = trx_id;
+					});
+				}
+			} FC_CAPTURE_AND_RETHROW((trx_id)(contract_id));
+		}
         void  database::store_contract_storage_change_obj(const address& contract, uint32_t block_num)
 		{
             try {
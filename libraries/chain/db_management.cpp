@@ -27,17 +27,95 @@
 #include <graphene/chain/operation_history_object.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
+#include <graphene/db/worker_latch.hpp>
+
 #include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
 
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <deque>
+#include <memory>
 
 #include "boost/filesystem/operations.hpp"
 #include <leveldb/db.h>
 #include <leveldb/cache.h>
 namespace graphene { namespace chain {
 
+namespace {
+
+/// Checks skipped for blocks that were already accepted once, when rebuilding state from the block database.
+const uint32_t replay_skip_flags = database::skip_miner_signature |
+                                   database::skip_transaction_signatures |
+                                   database::skip_transaction_dupe_check |
+                                   database::skip_tapos_check |
+                                   database::skip_witness_schedule_check |
+                                   database::skip_authority_check;
+
+/// Key of the transactions db entry holding the head block of the latest state snapshot. It is
+/// written with a synced write, so every transaction record before it is on disk as well.
+const char* const state_snapshot_marker_key = "state_snapshot_block_num";
+
+/// Reads the snapshot marker from the transactions db in @p data_dir, 0 if there is none.
+uint32_t read_state_snapshot_marker( const fc::path& data_dir )
+{
+   leveldb::DB* db = nullptr;
+   leveldb::Options options;
+   if( !leveldb::DB::Open( options, (data_dir / "transactions").string(), &db ).ok() )
+      return 0;
+   std::unique_ptr<leveldb::DB> db_guard( db );
+   std::string value;
+   if( !db->Get( leveldb::ReadOptions(), state_snapshot_marker_key, &value ).ok() )
+      return 0;
+   return fc::to_uint64( value );
+}
+
+fc::optional<state_snapshot_info> read_state_snapshot_info( const fc::path& snapshot_dir )
+{
+   try {
+      if( fc::exists( snapshot_dir / "snapshot.json" ) )
+         return fc::json::from_file( snapshot_dir / "snapshot.json" ).as<state_snapshot_info>();
+   } catch( const fc::exception& e ) {
+      wlog( "Unable to read state snapshot manifest in ${d}: ${e}", ("d",snapshot_dir)("e",e.to_detail_string()) );
+   }
+   return fc::optional<state_snapshot_info>();
+}
+
+/// A block read ahead of the chain thread during replay, with the checks that do not need chain state already done.
+/// done counts down once the block is fetched and prepared, error holds what the fetch or the checks threw.
+struct replay_block
+{
+   optional<signed_block>         block;
+   bool                           merkle_root_ok = false;
+   std::shared_ptr<fc::exception> error;
+   worker_latch                   done{ 1 };
+
+   void fail( const fc::exception& e ) { error = e.dynamic_copy_exception(); }
+   void fail( const std::exception& e )
+   {
+      error = std::make_shared<fc::exception>( FC_LOG_MESSAGE( error, "replaying block: ${what}", ("what",e.what()) ) );
+   }
+   void fail()
+   {
+      error = std::make_shared<fc::unhandled_exception>( FC_LOG_MESSAGE( error, "replaying block: unknown exception" ), std::current_exception() );
+   }
+};
+
+/// Waits for the blocks still in flight, so that no read outlives the replay loop when it exits early.
+struct replay_pending_guard
+{
+   std::deque< std::unique_ptr<replay_block> >& pending;
+   ~replay_pending_guard()
+   {
+      for( auto& b : pending )
+         b->done.wait();
+      pending.clear();
+   }
+};
+
+}
+
 database::database()
 {
    initialize_indexes();
@@ -85,41 +163,7 @@ void database::reindex(fc::path data_dir, const genesis_state_type& initial_allo
    _undo_db.set_max_size(GRAPHENE_UNDO_BUFF_MAX_SIZE);
    reinitialize_leveldb();
    uint32_t undo_enable_num = last_block_num - 1440;
-   for( uint32_t i = 1; i <= last_block_num; ++i )
-   {
-      if( i % 10000 == 0 ) std::cerr << "   " << double(i*100)/last_block_num << "%   "<<i << " of " <<last_block_num<<"   \n";
-      fc::optional< signed_block > block = _block_id_to_block.fetch_by_number(i);
-      if( !block.valid() )
-      {
-         wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
-         uint32_t dropped_count = 0;
-         while( true )
-         {
-            fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
-            // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
-            if( !last_id.valid() )
-               break;
-            // we've caught up to the gap
-            if( block_header::num_from_id( *last_id ) <= i )
-               break;
-            _block_id_to_block.remove( *last_id );
-            dropped_count++;
-         }
-         wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
-         break;
-      }
-      _fork_db.push_block(*block);
-	  if (i >= undo_enable_num)
-		  _undo_db.set_max_size(1440);
-	  auto session=_undo_db.start_undo_session();
-      apply_block(*block, skip_miner_signature |
-                          skip_transaction_signatures |
-                          skip_transaction_dupe_check |
-                          skip_tapos_check |
-                          skip_witness_schedule_check |
-                          skip_authority_check);
-	  session.commit();
-   }
+   replay_blocks( 1, last_block_num, undo_enable_num, replay_skip_flags );
    auto end = fc::time_point::now();
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
 
@@ -153,13 +197,129 @@ void database::reindex(fc::path data_dir, const genesis_state_type& initial_allo
    //
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+void database::replay_blocks( uint32_t first_block_num, uint32_t last_block_num, uint32_t undo_enable_num, uint32_t replay_skip )
+{
+   // Replay pipeline: a reader thread fetches and unpacks blocks in order, the
+   // signature worker threads check merkle roots (and recover signature keys when
+   // they are not skipped), the chain thread only applies. At most
+   // prefetch_window blocks are in flight.
+   const uint32_t prefetch_window = 1024;
+   init_signature_threads();
+   const chain_id_type chain_id = get_chain_id();
+   fc::thread reader( "reindex_reader" );
+   std::deque< std::unique_ptr<replay_block> > pending;
+   replay_pending_guard pending_guard{ pending };
+   uint32_t next_fetch = first_block_num;
+   // the chain thread blocks on the latch of each block, waiting on a future would yield its fiber
+   auto schedule_next = [&]() {
+      const uint32_t num = next_fetch++;
+      pending.emplace_back( new replay_block );
+      replay_block* prepared = pending.back().get();
+      fc::thread* worker = _signature_threads[num % _signature_threads.size()].get();
+      reader.async( [this, num, prepared, worker, replay_skip, &chain_id]() {
+         try {
+            prepared->block = _block_id_to_block.fetch_by_number( num );
+         } catch( const fc::exception& e ) {
+            prepared->fail( e );
+         } catch( const std::exception& e ) {
+            prepared->fail( e );
+         } catch( ... ) {
+            prepared->fail();
+         }
+         if( prepared->error || !prepared->block.valid() )
+         {
+            prepared->done.count_down();
+            return;
+         }
+         worker->async( [prepared, replay_skip, &chain_id]() {
+            try {
+               const signed_block& block = *prepared->block;
+               prepared->merkle_root_ok = block.transaction_merkle_root == block.calculate_merkle_root();
+               if( !(replay_skip & (skip_transaction_signatures | skip_authority_check)) )
+                  for( const auto& trx : block.transactions )
+                  {
+                     try {
+                        trx.cache_signature_keys( chain_id );
+                     } catch( const fc::exception& ) {
+                     }
+                  }
+            } catch( const fc::exception& e ) {
+               prepared->fail( e );
+            } catch( const std::exception& e ) {
+               prepared->fail( e );
+            } catch( ... ) {
+               prepared->fail();
+            }
+            prepared->done.count_down();
+         }, "reindex_prepare" );
+      }, "reindex_fetch" );
+   };
+   while( next_fetch <= last_block_num && pending.size() < prefetch_window )
+      schedule_next();
+
+   auto progress_time = fc::time_point::now();
+   for( uint32_t i = first_block_num; i <= last_block_num; ++i )
+   {
+      if( i % 10000 == 0 )
+      {
+         auto now = fc::time_point::now();
+         double rate = 10000 * 1000000.0 / std::max<int64_t>( (now - progress_time).count(), 1 );
+         progress_time = now;
+         std::cerr << "   " << double(i*100)/last_block_num << "%   "<<i << " of " <<last_block_num
+                   << "   " << uint64_t(rate) << " blocks/s, " << uint64_t((last_block_num - i) / rate) << " s left   \n";
+      }
+      pending.front()->done.wait();
+      std::unique_ptr<replay_block> prepared = std::move( pending.front() );
+      pending.pop_front();
+      if( prepared->error )
+         prepared->error->dynamic_rethrow_exception();
+      if( next_fetch <= last_block_num )
+         schedule_next();
+      fc::optional< signed_block >& block = prepared->block;
+      if( !block.valid() )
+      {
+         // blocks may only be removed once no read is in flight
+         for( auto& b : pending )
+            b->done.wait();
+         pending.clear();
+         wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
+         uint32_t dropped_count = 0;
+         while( true )
+         {
+            fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
+            // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
+            if( !last_id.valid() )
+               break;
+            // we've caught up to the gap
+            if( block_header::num_from_id( *last_id ) <= i )
+               break;
+            _block_id_to_block.remove( *last_id );
+            dropped_count++;
+         }
+         wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
+         break;
+      }
+      _fork_db.push_block(*block);
+	  if (i >= undo_enable_num)
+		  _undo_db.set_max_size(1440);
+	  auto session=_undo_db.start_undo_session();
+      // a bad merkle root is left to apply_block, which reports it
+      apply_block(*block, replay_skip | (prepared->merkle_root_ok ? skip_merkle_check : 0));
+	  session.commit();
+   }
+}
+
 void database::wipe(const fc::path& data_dir, bool include_blocks)
 {
    ilog("Wiping database", ("include_blocks", include_blocks));
    close();
    object_database::wipe(data_dir);
    if( include_blocks )
+   {
       fc::remove_all( data_dir / "database" );
+      fc::remove_all( data_dir / "state_snapshot" );
+      fc::remove_all( data_dir / "state_snapshot.old" );
+   }
 }
 
 void database::open(
@@ -198,9 +358,132 @@ void database::open(
 		  fc::path fork_data_dir = get_data_dir() / "fork_db";
 		  _fork_db.from_file(fork_data_dir.string());
 		  initialize_leveldb();
+		  auto snapshot = read_state_snapshot_info(data_dir / "state_snapshot");
+		  _last_state_snapshot_block = snapshot.valid() ? snapshot->last_irreversible_block_num : 0;
    }
    FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
-} 
+}
+
+void database::discard_opened_state()
+{
+   clear_pending();
+   // the stored undo states are replaced by the next from_file() or dropped by reindex()
+   _undo_db.reset();
+   _fork_db.reset();
+   object_database::clear_objects();
+   if( _block_id_to_block.is_open() )
+      _block_id_to_block.close();
+   destruct_leveldb();
+   _last_state_snapshot_block = 0;
+}
+
+bool database::open_from_state_snapshot(const fc::path& data_dir)
+{ try {
+   // a failed open() may have loaded part of the state already
+   discard_opened_state();
+   _block_id_to_block.open( data_dir / "database" / "block_num_to_block" );
+   const uint32_t marker = read_state_snapshot_marker( data_dir );
+
+   // the previous snapshot is only removed once the next one is complete
+   fc::path snapshot_dir;
+   state_snapshot_info info;
+   for( const auto& dir : { data_dir / "state_snapshot", data_dir / "state_snapshot.old" } )
+   {
+      auto candidate = read_state_snapshot_info( dir );
+      if( !candidate.valid() )
+         continue;
+      if( candidate->block_num > marker )
+      {
+         wlog( "State snapshot of block ${n} is newer than the transaction records (${m})", ("n",candidate->block_num)("m",marker) );
+         continue;
+      }
+      if( !_block_id_to_block.fetch_optional( candidate->block_id ).valid() )
+      {
+         wlog( "State snapshot block ${id} is not in the block database", ("id",candidate->block_id) );
+         continue;
+      }
+      snapshot_dir = dir;
+      info = *candidate;
+      break;
+   }
+   if( snapshot_dir == fc::path() )
+   {
+      _block_id_to_block.close();
+      return false;
+   }
+
+   ilog( "Opening state snapshot of block ${n}", ("n",info.block_num) );
+   auto start = fc::time_point::now();
+   try {
+      object_database::open( data_dir, snapshot_dir / "object_database" );
+      FC_ASSERT( find( global_property_id_type() ) && head_block_id() == info.block_id,
+                 "state snapshot does not match its manifest", ("info",info) );
+
+      fc::path undo_data_dir = data_dir / "undo_db";
+      undo_database::restore_snapshot( snapshot_dir / "undo_db", undo_data_dir.string() );
+      _undo_db.from_file( undo_data_dir.string() );
+      fc::path fork_data_dir = data_dir / "fork_db";
+      fc::remove_all( fork_data_dir );
+      if( fc::exists( snapshot_dir / "fork_db" ) )
+         fc::copy_file( snapshot_dir / "fork_db", fork_data_dir );
+      _fork_db.start_block( *_block_id_to_block.fetch_optional( info.block_id ) );
+      _fork_db.from_file( fork_data_dir.string() );
+      initialize_leveldb();
+      _last_state_snapshot_block = info.last_irreversible_block_num;
+
+      auto last_block = _block_id_to_block.last();
+      if( last_block.valid() && last_block->block_num() > info.block_num )
+      {
+         ilog( "Replaying blocks ${f} to ${l} on top of the state snapshot", ("f",info.block_num + 1)("l",last_block->block_num()) );
+         _undo_db.enable();
+         replay_blocks( info.block_num + 1, last_block->block_num(), info.block_num + 1, replay_skip_flags );
+      }
+   } catch( ... ) {
+      // the caller falls back to a reindex, which expects a closed and empty database
+      discard_opened_state();
+      throw;
+   }
+   ilog( "Done opening state snapshot, elapsed time: ${t} sec", ("t",double((fc::time_point::now()-start).count())/1000000.0) );
+   return true;
+} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+
+void database::save_state_snapshot()
+{ try {
+   const fc::path data_dir = get_data_dir();
+   const fc::path snapshot_dir = data_dir / "state_snapshot";
+   const fc::path tmp_dir = data_dir / "state_snapshot.tmp";
+   const fc::path old_dir = data_dir / "state_snapshot.old";
+   auto start = fc::time_point::now();
+
+   state_snapshot_info info;
+   info.block_num = head_block_num();
+   info.block_id = head_block_id();
+   info.last_irreversible_block_num = get_dynamic_global_properties().last_irreversible_block_num;
+   info.time = head_block_time();
+
+   fc::remove_all( tmp_dir );
+   fc::create_directories( tmp_dir );
+   object_database::save_snapshot( tmp_dir / "object_database" );
+   _undo_db.save_snapshot( tmp_dir / "undo_db" );
+   _fork_db.save_to_file( (tmp_dir / "fork_db").string() );
+
+   // the synced write also brings every transaction record before it to disk
+   auto db = get_levelDB();
+   FC_ASSERT( db, "transaction db closed" );
+   leveldb::WriteOptions write_options;
+   write_options.sync = true;
+   auto status = db->Put( write_options, state_snapshot_marker_key, fc::to_string( info.block_num ) );
+   FC_ASSERT( status.ok(), "failed to write the state snapshot marker: ${e}", ("e",status.ToString()) );
+   fc::json::save_to_file( info, tmp_dir / "snapshot.json" );
+
+   fc::remove_all( old_dir );
+   if( fc::exists( snapshot_dir ) )
+      fc::rename( snapshot_dir, old_dir );
+   fc::rename( tmp_dir, snapshot_dir );
+   fc::remove_all( old_dir );
+   _last_state_snapshot_block = info.last_irreversible_block_num;
+   ilog( "Saved state snapshot of block ${n} in ${t} ms", ("n",info.block_num)("t",(fc::time_point::now() - start).count() / 1000) );
+} FC_CAPTURE_AND_RETHROW() } 
 
 void database::clear()
 {
@@ -23,9 +23,21 @@
  */
 #pragma once
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include <graphene/chain/protocol/block.hpp>
 
+namespace fc { class file_mapping; class mapped_region; }
+
 namespace graphene { namespace chain {
+   struct index_entry;
+
+   /**
+    * Blocks are appended to the "blocks" file and located through fixed size entries in the "index" file.
+    * Writes go through the fstreams; every read goes through a read-only memory mapping of the files,
+    * so readers on API threads neither share a seek position nor block the writer.
+    */
    class block_database 
    {
       public:
@@ -44,7 +56,39 @@ namespace graphene { namespace chain {
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
       private:
-         mutable std::fstream _blocks;
-         mutable std::fstream _block_num_to_pos;
+         struct mapped_file
+         {
+            mapped_file( const fc::path& p );
+            ~mapped_file();
+            const char* data()const;
+            uint64_t    size()const;
+
+            std::unique_ptr<fc::file_mapping>  _file_mapping;
+            std::unique_ptr<fc::mapped_region> _mapped_region;
+         };
+         typedef std::shared_ptr<const mapped_file> mapped_file_ptr;
+
+         /**
+          * returns a mapping of the file covering at least min_size bytes, or of the whole file if it is shorter;
+          * the file is only remapped once file_size, the bytes written so far, has grown past the mapping
+          */
+         mapped_file_ptr map_file( mapped_file_ptr& current, const fc::path& p, uint64_t file_size, uint64_t min_size )const;
+         bool            read_index_entry( uint32_t block_num, index_entry& e )const;
+         optional<signed_block> read_block( const index_entry& e )const;
+         optional<uint32_t>     last_block_num()const;
+         void            read_ahead( const mapped_file& m, uint64_t pos )const;
+
+         std::fstream _blocks;
+         std::fstream _block_num_to_pos;
+         fc::path     _blocks_path;
+         fc::path     _index_path;
+
+         mutable std::mutex              _map_mutex;
+         mutable mapped_file_ptr         _blocks_map;
+         mutable mapped_file_ptr         _index_map;
+         std::atomic<uint64_t>           _blocks_size{0};
+         std::atomic<uint64_t>           _index_size{0};
+         mutable std::atomic<uint32_t>   _last_read_num{0};
+         mutable std::atomic<uint64_t>   _read_ahead_end{0};
    };
 } }
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/contract_entry.hpp>
+#include <uvm/uvm_api.h>
+
+#include <fc/reflect/reflect.hpp>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#define GRAPHENE_CONTRACT_BYTECODE_CACHE_SIZE 256
+
+namespace graphene {
+	namespace chain {
+
+		struct contract_bytecode_cache_metrics
+		{
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t evictions = 0;
+			uint64_t invalidations = 0;
+			uint64_t entries = 0;
+		};
+
+		/**
+		 * @brief LRU cache of the module byte streams handed to the uvm when a contract is opened
+		 *
+		 * Entries are keyed by the contract address (or name) the uvm asked for together with the
+		 * code hash, so a stream is only reused while the stored bytecode is unchanged. Streams are
+		 * shared between lua_States and must be treated as read only once they are in the cache.
+		 */
+		class contract_bytecode_cache
+		{
+		public:
+			typedef std::shared_ptr<UvmModuleByteStream> stream_ptr;
+			typedef std::function<stream_ptr(const uvm::blockchain::Code&)> loader_type;
+
+			explicit contract_bytecode_cache(size_t max_entries = GRAPHENE_CONTRACT_BYTECODE_CACHE_SIZE);
+
+			/**
+			 * Returns the cached stream of @p code, building it with @p loader on a miss.
+			 * Codes without a hash are never cached.
+			 */
+			stream_ptr get_or_load(const std::string& contract_key, const uvm::blockchain::Code& code, const loader_type& loader);
+
+			/** drops every entry of the contract, whatever its code hash */
+			void invalidate(const std::string& contract_key);
+			void clear();
+
+			void set_max_entries(size_t max_entries);
+			size_t max_entries()const;
+			contract_bytecode_cache_metrics get_metrics()const;
+
+			static contract_bytecode_cache& instance();
+
+		private:
+			struct entry
+			{
+				std::string contract_key;
+				std::string code_hash;
+				stream_ptr  stream;
+			};
+			typedef std::list<entry> lru_list;
+
+			static std::string make_key(const std::string& contract_key, const std::string& code_hash);
+			void shrink_to(size_t max_entries);
+
+			mutable std::mutex                                   _mutex;
+			lru_list                                             _lru;
+			std::unordered_map<std::string, lru_list::iterator> _entries;
+			size_t                                               _max_entries;
+			contract_bytecode_cache_metrics                      _metrics;
+		};
+
+	}
+}
+
+FC_REFLECT(graphene::chain::contract_bytecode_cache_metrics, (hits)(misses)(evictions)(invalidations)(entries))
@@ -2,7 +2,9 @@
 #include <graphene/chain/protocol/operations.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <graphene/chain/contract_entry.hpp>
+#include <graphene/chain/contract_storage_types.hpp>
 #include <graphene/chain/vesting_balance_object.hpp>
 #include <vector>
 namespace graphene {
@@ -76,8 +78,8 @@ namespace graphene {
 			static const uint8_t type_id = contract_storage_object_type;
 
 			address contract_address;
-			string storage_name;
-			std::vector<char> storage_value;
+			storage_name_type storage_name;
+			storage_value_type storage_value;
 	};
 
 	class contract_storage_view {
@@ -90,21 +92,26 @@ namespace graphene {
 	};
 
 		struct by_contract_id_storage_name {};
-		struct by_storage_contract_id {};
+		struct by_contract_id_storage_name_hash {};
+		typedef composite_key<
+			contract_storage_object,
+			member<contract_storage_object, address, &contract_storage_object::contract_address>,
+			member<contract_storage_object, storage_name_type, &contract_storage_object::storage_name>
+		> contract_storage_key;
+		/**
+		 * the ordered index is the per contract storage map (whole contract scans, batched writes),
+		 * point lookups by name go through the hashed one
+		 */
 		typedef multi_index_container<
 			contract_storage_object,
 			indexed_by<
 			ordered_unique<tag<by_id>, member<object, object_id_type, &object::id>>,
-			ordered_unique< tag<by_contract_id_storage_name>,
-			composite_key<
-			contract_storage_object,
-			member<contract_storage_object, address, &contract_storage_object::contract_address>,
-			member<contract_storage_object, string, &contract_storage_object::storage_name>
-			>
+			ordered_unique< tag<by_contract_id_storage_name>, contract_storage_key,
+				composite_key_compare<std::less<address>, storage_name_less>
 			>,
-			
-			 ordered_non_unique<tag<by_storage_contract_id>,
-			member<contract_storage_object, address, &contract_storage_object::contract_address>
+			hashed_unique< tag<by_contract_id_storage_name_hash>, contract_storage_key,
+				composite_key_hash<std::hash<address>, storage_name_hash>,
+				composite_key_equal_to<std::equal_to<address>, storage_name_equal>
 			>
 			>> contract_storage_object_multi_index_type;
 		typedef generic_index<contract_storage_object, contract_storage_object_multi_index_type> contract_storage_object_index;
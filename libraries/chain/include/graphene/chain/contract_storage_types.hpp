@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <fc/io/raw.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/variant.hpp>
+
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace graphene {
+	namespace chain {
+
+		/**
+		 * @brief Interned contract storage name
+		 *
+		 * Equal names share one heap string (and its hash) through a process wide pool, so the
+		 * storage object, its diff objects and every undo copy of them hold one pointer instead of
+		 * their own copy of keys like "users/XWC...". Names compare by content, an empty name holds
+		 * no pool entry at all. Serialized exactly like std::string.
+		 */
+		class storage_name_type
+		{
+		public:
+			storage_name_type() {}
+			storage_name_type(const std::string& name) { assign(name); }
+
+			storage_name_type& operator=(const std::string& name) { assign(name); return *this; }
+
+			const std::string& str()const { return _entry ? _entry->value : empty_string(); }
+			operator const std::string&()const { return str(); }
+			const char* c_str()const { return str().c_str(); }
+			size_t size()const { return _entry ? _entry->value.size() : 0; }
+			bool empty()const { return size() == 0; }
+			/** std::hash<std::string> of the name, computed once per pool entry */
+			size_t hash()const { return _entry ? _entry->hash : empty_hash(); }
+
+			friend bool operator==(const storage_name_type& a, const storage_name_type& b)
+			{
+				return a._entry == b._entry || a.str() == b.str();
+			}
+			friend bool operator<(const storage_name_type& a, const storage_name_type& b)
+			{
+				return a._entry != b._entry && a.str() < b.str();
+			}
+			friend bool operator!=(const storage_name_type& a, const storage_name_type& b) { return !(a == b); }
+			friend bool operator==(const storage_name_type& a, const std::string& b) { return a.str() == b; }
+			friend bool operator==(const std::string& a, const storage_name_type& b) { return a == b.str(); }
+			friend bool operator!=(const storage_name_type& a, const std::string& b) { return a.str() != b; }
+			friend bool operator!=(const std::string& a, const storage_name_type& b) { return a != b.str(); }
+			friend bool operator<(const storage_name_type& a, const std::string& b) { return a.str() < b; }
+			friend bool operator<(const std::string& a, const storage_name_type& b) { return a < b.str(); }
+
+			template<typename T>
+			inline friend T& operator<<(T& ds, const storage_name_type& name)
+			{
+				fc::raw::pack(ds, name.str());
+				return ds;
+			}
+			template<typename T>
+			inline friend T& operator>>(T& ds, storage_name_type& name)
+			{
+				std::string tmp;
+				fc::raw::unpack(ds, tmp);
+				name.assign(tmp);
+				return ds;
+			}
+
+			struct entry
+			{
+				std::string value;
+				size_t      hash;
+			};
+
+			/** number of distinct names currently held by the pool */
+			static size_t pool_size();
+
+		private:
+			void assign(const std::string& name);
+			static const std::string& empty_string();
+			static size_t empty_hash();
+
+			std::shared_ptr<const entry> _entry;
+		};
+
+		/** comparator of the storage index, lets lookups by std::string skip interning */
+		struct storage_name_less
+		{
+			template<typename A, typename B>
+			bool operator()(const A& a, const B& b)const { return a < b; }
+		};
+		struct storage_name_equal
+		{
+			template<typename A, typename B>
+			bool operator()(const A& a, const B& b)const { return a == b; }
+		};
+		struct storage_name_hash
+		{
+			size_t operator()(const storage_name_type& name)const { return name.hash(); }
+			size_t operator()(const std::string& name)const { return std::hash<std::string>()(name); }
+		};
+
+		/**
+		 * @brief Contract storage value with inline storage for short values
+		 *
+		 * Most cbor encoded storage values (integers, bools, short strings) fit in the inline
+		 * buffer, so they need no heap block of their own. Longer values are kept in one heap
+		 * block whose pointer reuses the inline buffer. The object is as large as a std::vector<char>.
+		 * Serialized exactly like std::vector<char>.
+		 */
+		class storage_value_type
+		{
+		public:
+			static const uint32_t inline_capacity = 20;
+
+			storage_value_type() : _size(0) {}
+			storage_value_type(const std::vector<char>& value) : _size(0) { assign(value.data(), value.size()); }
+			storage_value_type(const char* data, size_t size) : _size(0) { assign(data, size); }
+			storage_value_type(const storage_value_type& other) : _size(0) { assign(other.data(), other.size()); }
+			storage_value_type(storage_value_type&& other) : _size(other._size)
+			{
+				memcpy(_data, other._data, sizeof(_data));
+				other._size = 0;
+			}
+			~storage_value_type() { release(); }
+
+			storage_value_type& operator=(const storage_value_type& other)
+			{
+				if (this != &other)
+					assign(other.data(), other.size());
+				return *this;
+			}
+			storage_value_type& operator=(storage_value_type&& other)
+			{
+				if (this != &other)
+				{
+					release();
+					memcpy(_data, other._data, sizeof(_data));
+					_size = other._size;
+					other._size = 0;
+				}
+				return *this;
+			}
+			storage_value_type& operator=(const std::vector<char>& value)
+			{
+				assign(value.data(), value.size());
+				return *this;
+			}
+
+			void assign(const char* data, size_t size);
+
+			const char* data()const { return is_inline() ? _data : heap(); }
+			char* data() { return is_inline() ? _data : heap(); }
+			size_t size()const { return _size; }
+			bool empty()const { return _size == 0; }
+
+			std::vector<char> to_vector()const { return std::vector<char>(data(), data() + _size); }
+			operator std::vector<char>()const { return to_vector(); }
+
+			friend bool operator==(const storage_value_type& a, const storage_value_type& b)
+			{
+				return a._size == b._size && memcmp(a.data(), b.data(), a._size) == 0;
+			}
+			friend bool operator!=(const storage_value_type& a, const storage_value_type& b) { return !(a == b); }
+
+			template<typename T>
+			inline friend T& operator<<(T& ds, const storage_value_type& value)
+			{
+				fc::raw::pack(ds, fc::unsigned_int(value._size));
+				if (value._size)
+					ds.write(value.data(), value._size);
+				return ds;
+			}
+			template<typename T>
+			inline friend T& operator>>(T& ds, storage_value_type& value)
+			{
+				fc::unsigned_int size;
+				fc::raw::unpack(ds, size);
+				FC_ASSERT(size.value < MAX_ARRAY_ALLOC_SIZE);
+				value.assign(nullptr, size.value);
+				if (size.value)
+					ds.read(value.data(), size.value);
+				return ds;
+			}
+
+		private:
+			bool is_inline()const { return _size <= inline_capacity; }
+			char* heap()const
+			{
+				char* p;
+				memcpy(&p, _data, sizeof(p));
+				return p;
+			}
+			void release()
+			{
+				if (!is_inline())
+					delete[] heap();
+				_size = 0;
+			}
+
+			char     _data[inline_capacity];
+			uint32_t _size;
+		};
+
+	}
+}
+
+namespace fc
+{
+	void to_variant(const graphene::chain::storage_name_type& var, fc::variant& vo);
+	void from_variant(const fc::variant& var, graphene::chain::storage_name_type& vo);
+	void to_variant(const graphene::chain::storage_value_type& var, fc::variant& vo);
+	void from_variant(const fc::variant& var, graphene::chain::storage_value_type& vo);
+}
+
+FC_REFLECT_TYPENAME(graphene::chain::storage_name_type)
+FC_REFLECT_TYPENAME(graphene::chain::storage_value_type)
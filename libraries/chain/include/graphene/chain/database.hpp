@@ -29,6 +29,7 @@
 #include <graphene/chain/fork_database.hpp>
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/genesis_state.hpp>
+#include <graphene/chain/pending_transaction_pool.hpp>
 #include <graphene/chain/evaluator.hpp>
 #include <graphene/chain/crosschain_trx_object.hpp>
 #include <graphene/chain/coldhot_transfer_object.hpp>
@@ -40,6 +41,7 @@
 #include <graphene/chain/protocol/protocol.hpp>
 #include <graphene/chain/contract_object.hpp>
 #include <fc/log/logger.hpp>
+#include <fc/thread/thread.hpp>
 #include <fc/uint128.hpp>
 
 #include <map>
@@ -52,6 +54,15 @@ namespace graphene { namespace chain {
 
    struct budget_record;
 
+   /** manifest of a state snapshot directory, see database::save_state_snapshot() */
+   struct state_snapshot_info
+   {
+      uint32_t           block_num = 0;
+      block_id_type      block_id;
+      uint32_t           last_irreversible_block_num = 0;
+      fc::time_point_sec time;
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -116,6 +127,25 @@ namespace graphene { namespace chain {
          void wipe(const fc::path& data_dir, bool include_blocks);
          void close();
 		 void clear();
+
+         /**
+          * @brief Open the database from the latest state snapshot and replay only the blocks after it
+          *
+          * Used instead of @ref database::reindex after an unclean shutdown. The snapshot is checked against the
+          * block database and the transaction records before anything is loaded.
+          *
+          * @return false if there is no usable snapshot. The database is left closed and empty in that case and
+          * when an exception is thrown, ready for @ref database::reindex
+          */
+         bool open_from_state_snapshot(const fc::path& data_dir);
+         /**
+          * Writes the object database, undo and fork state of the current head block to
+          * data_dir/state_snapshot, replacing the previous snapshot only once the new one is complete.
+          * The calling thread blocks until the snapshot is written, nothing may change the state meanwhile.
+          */
+         void save_state_snapshot();
+         /** take a snapshot whenever the last irreversible block moved this many blocks, 0 disables */
+         void set_state_snapshot_interval(uint32_t blocks) { _state_snapshot_interval = blocks; }
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -348,6 +378,11 @@ namespace graphene { namespace chain {
 		 void set_contract_storage(const address& contract_id, const string& name, const StorageDataType &value);
 		 void set_contract_storage_in_contract(const contract_object& contract, const string& name, const StorageDataType& value);
 		 void add_contract_storage_change(const transaction_id_type& trx_id, const address& contract_id, const string& name, const StorageDataType &diff);
+		 /**
+		  * Same as set_contract_storage and add_contract_storage_change for every item of @p changes, done in one
+		  * walk of the storage index in name order. The values and diffs are moved into the objects.
+		  */
+		 void apply_contract_storage_changes(const transaction_id_type& trx_id, const address& contract_id, vector<contract_storage_write>&& changes);
 		 void add_contract_event_notify(const transaction_id_type& trx_id, const address& contract_id, const string& event_name, const string& event_arg, uint64_t block_num, uint64_t
 		                                op_num);
          void  store_contract_storage_change_obj(const address& contract,uint32_t block_num);
@@ -567,8 +602,21 @@ namespace graphene { namespace chain {
          processed_transaction apply_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          operation_result      apply_operation( transaction_evaluation_state& eval_state, const operation& op );
 		 optional<trx_object>   fetch_trx(const transaction_id_type id)const ;
+		 /**
+		  * Recovers the signature keys of all transactions on the signature worker threads and caches
+		  * them in each transaction, the serial apply then only checks authorities. The calling thread
+		  * blocks until the workers are done, it does not yield to other tasks.
+		  */
+		 void                   precompute_signature_keys( const vector<processed_transaction>& trxs )const;
+		 void                   precompute_signature_keys( const signed_transaction& trx )const;
+		 /** existence check for the dupe check, does not decode the stored transaction */
+		 bool                   has_trx(const transaction_id_type& trx_id)const;
       private:
          void                  _apply_block( const signed_block& next_block );
+         void                  init_signature_threads()const;
+         void                  replay_blocks( uint32_t first_block_num, uint32_t last_block_num, uint32_t undo_enable_num, uint32_t skip );
+         /** drops whatever a failed open left in memory and closes the block and transaction dbs, nothing is saved */
+         void                  discard_opened_state();
          processed_transaction _apply_transaction( const signed_transaction& trx ,bool testing=false);
 		 void                  _rollback_votes(const proposal_object& proposal);
 		 bool                  _need_rollback(const proposal_object& proposal);
@@ -610,7 +658,7 @@ namespace graphene { namespace chain {
          ///@}
          ///@}
 
-         vector< processed_transaction >        _pending_tx;
+         pending_transaction_pool               _pending_tx;
          fork_database                          _fork_db;
 
          /**
@@ -654,6 +702,11 @@ namespace graphene { namespace chain {
 		 share_type                        _min_gas_price = 1;
 		 share_type						   _gas_limit_in_in_block = 2000000;
 		 share_type						   _current_gas_in_block= 0;
+
+		 mutable vector<std::unique_ptr<fc::thread>> _signature_threads;
+
+         uint32_t                          _state_snapshot_interval = 0;
+         uint32_t                          _last_state_snapshot_block = 0;
 	public:
 		bool ontestnet = false;
 		volatile bool stop_process = false;
@@ -682,3 +735,4 @@ namespace graphene { namespace chain {
 
 } }
 
+FC_REFLECT( graphene::chain::state_snapshot_info, (block_num)(block_id)(last_irreversible_block_num)(time) )
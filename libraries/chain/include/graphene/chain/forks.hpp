@@ -42,3 +42,5 @@
 #define USE_MOD_CHANGE_LIST_HEIGHT              1
 #define PASS_XWC_BLOCK_NUM                      1
 #define XWC_CROSSCHAIN_ERC_FORK_HEIGHT          11492500
+// exact uvm string pool (vmgc GcState::set_exact_string_pool), not scheduled yet
+#define USE_EXACT_STRING_POOL_FORK_HEIGHT       99999999
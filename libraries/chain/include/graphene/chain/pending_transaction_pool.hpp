@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/transaction.hpp>
+#include <graphene/chain/contract_entry.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
+
+#include <functional>
+
+namespace graphene { namespace chain {
+   using boost::multi_index_container;
+   using namespace boost::multi_index;
+
+   /**
+    * A transaction waiting for a block, with what block assembly needs to know about it
+    * computed once when it enters the pool.
+    */
+   struct pending_transaction_entry
+   {
+      processed_transaction trx;
+      transaction_id_type   id;
+      uint64_t              sequence = 0; ///< arrival order, the order the pending state was built in
+      string                sender;       ///< fee payer of the first operation
+      time_point_sec        expiration;
+      uint64_t              fee = 0;      ///< core asset offered in fees and gas, in base units
+      uint64_t              priority = 0; ///< fee per kilobyte
+      size_t                size = 0;
+      gas_count_type        gas_count = 0;
+      int                   contract_op_count = 0;
+   };
+
+   struct by_trx_id;
+   struct by_sequence;
+   struct by_priority;
+   struct by_expiration;
+   struct by_sender;
+   typedef multi_index_container<
+      pending_transaction_entry,
+      indexed_by<
+         hashed_unique< tag<by_trx_id>, member< pending_transaction_entry, transaction_id_type, &pending_transaction_entry::id >, std::hash<transaction_id_type> >,
+         ordered_unique< tag<by_sequence>, member< pending_transaction_entry, uint64_t, &pending_transaction_entry::sequence > >,
+         ordered_unique< tag<by_priority>,
+            composite_key< pending_transaction_entry,
+               member< pending_transaction_entry, uint64_t, &pending_transaction_entry::priority >,
+               member< pending_transaction_entry, uint64_t, &pending_transaction_entry::sequence >
+            >,
+            composite_key_compare< std::greater<uint64_t>, std::less<uint64_t> >
+         >,
+         ordered_non_unique< tag<by_expiration>, member< pending_transaction_entry, time_point_sec, &pending_transaction_entry::expiration > >,
+         ordered_unique< tag<by_sender>,
+            composite_key< pending_transaction_entry,
+               member< pending_transaction_entry, string, &pending_transaction_entry::sender >,
+               member< pending_transaction_entry, uint64_t, &pending_transaction_entry::sequence >
+            >
+         >
+      >
+   > pending_transaction_multi_index_type;
+
+   /**
+    * @brief The pending transactions of a database, indexed by arrival, fee, expiration and sender
+    */
+   class pending_transaction_pool
+   {
+      public:
+         /** adds a transaction that was applied to the pending state, returns false if it is already in the pool */
+         bool add( const processed_transaction& trx );
+         bool contains( const transaction_id_type& id )const;
+         size_t size()const { return _entries.size(); }
+         bool empty()const { return _entries.empty(); }
+         void clear() { _entries.clear(); }
+
+         /** empties the pool, returning its transactions in arrival order */
+         vector<processed_transaction> take_all();
+
+         /** removes the transactions expiring before @p now, returns how many were removed */
+         size_t remove_expired( time_point_sec now );
+
+         /**
+          * The order block assembly tries the transactions in: highest fee per kilobyte first,
+          * except that the transactions of one sender keep their arrival order, as later ones
+          * may depend on the earlier ones.
+          */
+         vector<const pending_transaction_entry*> block_order()const;
+
+         const pending_transaction_multi_index_type& indices()const { return _entries; }
+
+      private:
+         pending_transaction_multi_index_type _entries;
+         uint64_t                             _next_sequence = 0;
+   };
+
+} }
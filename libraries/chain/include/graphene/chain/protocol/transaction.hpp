@@ -173,10 +173,25 @@ namespace graphene { namespace chain {
 
       flat_set<public_key_type> get_signature_keys( const chain_id_type& chain_id )const;
 
+      /**
+       * Recovers the signature keys and keeps them in @ref _signees, so that later calls to
+       * get_signature_keys() for the same digest skip the secp256k1 recovery. A transaction
+       * with duplicate signatures is left uncached, get_signature_keys() reports the error.
+       */
+      void cache_signature_keys( const chain_id_type& chain_id )const;
+
+      /// hash of sig_digest and the signature bytes, replacing a signature invalidates the cached keys
+      digest_type signees_key( const digest_type& sig_digest )const;
+
       vector<signature_type> signatures;
 
+      /// Not serialized, valid while sig_digest() and the signatures are unchanged
+      mutable flat_set<public_key_type> _signees;
+      /// signees_key() of the digest and signatures @ref _signees were recovered from
+      mutable digest_type               _signees_digest;
+
       /// Removes all operations and signatures
-      void clear() { operations.clear(); signatures.clear(); }
+      void clear() { operations.clear(); signatures.clear(); _signees.clear(); }
    };
    struct full_transaction :signed_transaction
    {
@@ -3,6 +3,7 @@
 #include <graphene/chain/protocol/memo.hpp>
 
 #include <graphene/chain/contract_entry.hpp>
+#include <graphene/chain/contract_storage_types.hpp>
 #include <jsondiff/jsondiff.h>
 #include <jsondiff/exceptions.h>
 #include <uvm/uvm_lib.h>
@@ -38,6 +39,14 @@ namespace graphene {
 			StorageDataType after;
 		};
 
+		/** one item of the change set passed to database::apply_contract_storage_changes */
+		struct contract_storage_write
+		{
+			storage_name_type storage_name;
+			storage_value_type value; // moved into the contract_storage_object as is
+			std::vector<char> diff;
+		};
+
 		struct storage_operation : public base_operation
 		{
 			struct fee_parameters_type {
@@ -51,6 +51,14 @@ namespace graphene { namespace chain {
 	   transaction_id_type trx_id;
 	   uint32_t block_num;
    };
+
+   /**
+    * trx_object records in the "transactions" LevelDB are stored as this version byte followed
+    * by the fc::raw encoded object. Records written by older nodes are JSON and start with '{'.
+    */
+   #define GRAPHENE_TRX_RECORD_FORMAT_VERSION 1
+   std::vector<char> pack_trx_record( const trx_object& obj );
+   trx_object        unpack_trx_record( const std::string& value );
   
    /**
     * The purpose of this object is to enable the detection of duplicate transactions. When a transaction is included
@@ -105,11 +113,29 @@ namespace graphene { namespace chain {
    };
    struct by_addr;
    struct by_block_num;
+   struct by_addr_block_num;
+   /**
+    * by_block_num and by_addr_block_num end with the object id so every entry has a unique position,
+    * a page of history is resumed right after the (block_num, id) of its last entry.
+    */
    typedef multi_index_container<
 	   history_transaction_object,
 	   indexed_by<
 	   ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-	   ordered_non_unique< tag<by_addr>, member<history_transaction_object, address, &history_transaction_object::addr> >
+	   ordered_non_unique< tag<by_addr>, member<history_transaction_object, address, &history_transaction_object::addr> >,
+	   ordered_unique< tag<by_block_num>,
+		   composite_key< history_transaction_object,
+			   member<history_transaction_object, uint32_t, &history_transaction_object::block_num>,
+			   member<object, object_id_type, &object::id>
+		   >
+	   >,
+	   ordered_unique< tag<by_addr_block_num>,
+		   composite_key< history_transaction_object,
+			   member<history_transaction_object, address, &history_transaction_object::addr>,
+			   member<history_transaction_object, uint32_t, &history_transaction_object::block_num>,
+			   member<object, object_id_type, &object::id>
+		   >
+	   >
 	   >
    > history_transaction_multi_index_type;
 
@@ -162,7 +188,7 @@ namespace graphene { namespace chain {
 	   static const uint8_t type_id = contract_storage_diff_type;
 	   transaction_id_type trx_id;
        address contract_address;
-	   std::string storage_name;
+	   storage_name_type storage_name;
 	   std::vector<char> diff;
    };
    struct by_storage_name {};
@@ -20,36 +20,27 @@ namespace graphene {
 
 		void abstract_native_contract::set_contract_storage(const address& contract_address, const string& storage_name, const StorageDataType& value)
 		{
-			if (_contract_invoke_result.storage_changes.find(string(contract_address)) == _contract_invoke_result.storage_changes.end())
-			{
-				_contract_invoke_result.storage_changes[string(contract_address)] = contract_storage_changes_type();
-			}
-			auto& storage_changes = _contract_invoke_result.storage_changes[string(contract_address)];
-			if (storage_changes.find(storage_name) == storage_changes.end())
+			// the address string is base58 with a checksum, build it once per call
+			const auto& contract_address_str = string(contract_address);
+			auto& storage_changes = _contract_invoke_result.storage_changes[contract_address_str];
+			auto found = storage_changes.find(storage_name);
+			if (found == storage_changes.end())
 			{
 				StorageDataChangeType change;
 				change.after = value;
-				const auto &before = _evaluate->get_storage(string(contract_address), storage_name);
-				cbor_diff::CborDiff differ;
-				const auto& before_cbor = cbor_decode(before.storage_data);
-				const auto& after_cbor = cbor_decode(change.after.storage_data);
-				auto diff = differ.diff(before_cbor, after_cbor);
-				change.storage_diff.storage_data = cbor_encode(diff->value());
-				change.before = before;
-				storage_changes[storage_name] = change;
+				change.before = _evaluate->get_storage(contract_address_str, storage_name);
+				found = storage_changes.emplace(storage_name, std::move(change)).first;
 			}
 			else
 			{
-				auto& change = storage_changes[storage_name];
-				auto before = change.before;
-				auto after = value;
-				change.after = after;
-				cbor_diff::CborDiff differ;
-				const auto& before_cbor = cbor_diff::cbor_decode(before.storage_data);
-				const auto& after_cbor = cbor_diff::cbor_decode(after.storage_data);
-				auto diff = differ.diff(before_cbor, after_cbor);
-				change.storage_diff.storage_data = cbor_encode(diff->value());
+				found->second.after = value;
 			}
+			auto& change = found->second;
+			cbor_diff::CborDiff differ;
+			const auto& before_cbor = cbor_diff::cbor_decode(change.before.storage_data);
+			const auto& after_cbor = cbor_diff::cbor_decode(change.after.storage_data);
+			auto diff = differ.diff(before_cbor, after_cbor);
+			change.storage_diff.storage_data = cbor_encode(diff->value());
 		}
 
 		void abstract_native_contract::set_contract_storage(const address& contract_address, const string& storage_name, cbor::CborObjectP cbor_value) {
@@ -68,16 +59,15 @@ namespace graphene {
 
 		StorageDataType abstract_native_contract::get_contract_storage(const address& contract_address, const std::string& storage_name) const
 		{
-			if (_contract_invoke_result.storage_changes.find(contract_address.operator fc::string()) == _contract_invoke_result.storage_changes.end())
-			{
-				return _evaluate->get_storage(contract_address.operator fc::string(), storage_name);
-			}
-			auto& storage_changes = _contract_invoke_result.storage_changes.at(contract_address.address_to_string());
-			if (storage_changes.find(storage_name) == storage_changes.end())
+			const auto& contract_address_str = contract_address.address_to_string();
+			auto contract_changes = _contract_invoke_result.storage_changes.find(contract_address_str);
+			if (contract_changes != _contract_invoke_result.storage_changes.end())
 			{
-				return _evaluate->get_storage(contract_address.operator fc::string(), storage_name);
+				auto change = contract_changes->second.find(storage_name);
+				if (change != contract_changes->second.end())
+					return change->second.after;
 			}
-			return storage_changes.at(storage_name).after;
+			return _evaluate->get_storage(contract_address_str, storage_name);
 		}
 
 		void abstract_native_contract::fast_map_set(const address& contract_address, const std::string& storage_name, const std::string& key, cbor::CborObjectP cbor_value) {
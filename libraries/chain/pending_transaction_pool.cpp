@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/pending_transaction_pool.hpp>
+#include <graphene/chain/protocol/operations.hpp>
+#include <graphene/chain/protocol/fee_schedule.hpp>
+
+#include <fc/smart_ref_impl.hpp>
+#include <fc/uint128.hpp>
+
+#include <queue>
+
+namespace graphene { namespace chain {
+
+namespace {
+
+   /** fills in what the operations offer and what they count against the block budgets */
+   struct pending_operation_visitor
+   {
+      typedef void result_type;
+
+      pending_transaction_entry& entry;
+
+      template<typename T>
+      void operator()( const T& op )const
+      {
+         add_fee( op.fee );
+      }
+      void operator()( const contract_register_operation& op )const
+      {
+         add_contract_op( op.fee, op.init_cost, op.gas_price );
+      }
+      void operator()( const contract_upgrade_operation& op )const
+      {
+         add_contract_op( op.fee, op.invoke_cost, op.gas_price );
+      }
+      void operator()( const contract_invoke_operation& op )const
+      {
+         add_contract_op( op.fee, op.invoke_cost, op.gas_price );
+      }
+      void operator()( const transfer_contract_operation& op )const
+      {
+         add_contract_op( op.fee, op.invoke_cost, op.gas_price );
+      }
+      void operator()( const native_contract_register_operation& op )const
+      {
+         add_contract_op( op.fee, op.init_cost, op.gas_price );
+      }
+
+      void add_fee( const asset& fee )const
+      {
+         if( fee.asset_id == asset_id_type() && fee.amount > 0 )
+            add( fee.amount.value );
+      }
+      void add_contract_op( const asset& fee, gas_count_type gas_limit, gas_price_type gas_price )const
+      {
+         add_fee( fee );
+         fc::uint128 gas_fee = fc::uint128( gas_limit ) * gas_price;
+         add( gas_fee > fc::uint128( std::numeric_limits<uint64_t>::max() ) ? std::numeric_limits<uint64_t>::max() : gas_fee.to_uint64() );
+         entry.gas_count += gas_limit;
+         entry.contract_op_count++;
+      }
+      void add( uint64_t amount )const
+      {
+         entry.fee = amount > std::numeric_limits<uint64_t>::max() - entry.fee ? std::numeric_limits<uint64_t>::max() : entry.fee + amount;
+      }
+   };
+
+}
+
+bool pending_transaction_pool::add( const processed_transaction& trx )
+{
+   pending_transaction_entry entry;
+   entry.trx = trx;
+   entry.id = trx.id();
+   entry.sequence = _next_sequence++;
+   entry.expiration = trx.expiration;
+   entry.size = fc::raw::pack_size( trx );
+   if( !trx.operations.empty() )
+   {
+      try {
+         entry.sender = operation_fee_payer( trx.operations.front() ).as_string();
+      } catch( const fc::exception& ) {
+      }
+   }
+   pending_operation_visitor visitor{ entry };
+   for( const auto& op : trx.operations )
+      op.visit( visitor );
+   entry.priority = ( fc::uint128( entry.fee ) * 1024 / std::max<size_t>( entry.size, 1 ) ).to_uint64();
+   return _entries.insert( std::move( entry ) ).second;
+}
+
+bool pending_transaction_pool::contains( const transaction_id_type& id )const
+{
+   const auto& idx = _entries.get<by_trx_id>();
+   return idx.find( id ) != idx.end();
+}
+
+vector<processed_transaction> pending_transaction_pool::take_all()
+{
+   vector<processed_transaction> result;
+   result.reserve( _entries.size() );
+   for( const auto& entry : _entries.get<by_sequence>() )
+      result.push_back( std::move( const_cast<processed_transaction&>( entry.trx ) ) );
+   _entries.clear();
+   return result;
+}
+
+size_t pending_transaction_pool::remove_expired( time_point_sec now )
+{
+   auto& idx = _entries.get<by_expiration>();
+   auto end = idx.lower_bound( now );
+   size_t removed = std::distance( idx.begin(), end );
+   idx.erase( idx.begin(), end );
+   return removed;
+}
+
+vector<const pending_transaction_entry*> pending_transaction_pool::block_order()const
+{
+   typedef pending_transaction_multi_index_type::index<by_sender>::type::const_iterator sender_iterator;
+   const auto& by_sender_idx = _entries.get<by_sender>();
+   auto lower_priority = []( const sender_iterator& a, const sender_iterator& b ) {
+      return a->priority != b->priority ? a->priority < b->priority : a->sequence > b->sequence;
+   };
+   // the next transaction of every sender, best first
+   std::priority_queue< sender_iterator, vector<sender_iterator>, decltype(lower_priority) > heads( lower_priority );
+   for( auto itr = by_sender_idx.begin(); itr != by_sender_idx.end(); itr = by_sender_idx.upper_bound( itr->sender ) )
+      heads.push( itr );
+
+   vector<const pending_transaction_entry*> result;
+   result.reserve( _entries.size() );
+   while( !heads.empty() )
+   {
+      auto itr = heads.top();
+      heads.pop();
+      result.push_back( &*itr );
+      auto next = std::next( itr );
+      if( next != by_sender_idx.end() && next->sender == itr->sender )
+         heads.push( next );
+   }
+   return result;
+}
+
+} }
@@ -72,6 +72,7 @@ const signature_type& graphene::chain::signed_transaction::sign(const private_ke
 {
    digest_type h = sig_digest( chain_id );
    signatures.push_back(key.sign_compact(h));
+   _signees.clear();
    return signatures.back();
 }
 
@@ -372,10 +373,21 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
 } FC_CAPTURE_AND_RETHROW( (ops)(sigs) ) }
 
 
+digest_type signed_transaction::signees_key( const digest_type& sig_digest )const
+{
+   digest_type::encoder enc;
+   fc::raw::pack( enc, sig_digest );
+   fc::raw::pack( enc, signatures );
+   return enc.result();
+}
+
 flat_set<public_key_type> signed_transaction::get_signature_keys( const chain_id_type& chain_id )const
 { try {
    auto d = sig_digest( chain_id );
+   if( !_signees.empty() && _signees.size() == signatures.size() && _signees_digest == signees_key( d ) )
+      return _signees;
    flat_set<public_key_type> result;
+   result.reserve( signatures.size() );
    for( const auto&  sig : signatures )
    {
       GRAPHENE_ASSERT(
@@ -386,6 +398,24 @@ flat_set<public_key_type> signed_transaction::get_signature_keys( const chain_id
    return result;
 } FC_CAPTURE_AND_RETHROW() }
 
+void signed_transaction::cache_signature_keys( const chain_id_type& chain_id )const
+{
+   auto d = sig_digest( chain_id );
+   auto key = signees_key( d );
+   if( !_signees.empty() && _signees.size() == signatures.size() && _signees_digest == key )
+      return;
+   _signees.clear();
+   flat_set<public_key_type> result;
+   result.reserve( signatures.size() );
+   for( const auto& sig : signatures )
+   {
+      if( !result.insert( fc::ecc::public_key(sig,d) ).second )
+         return;
+   }
+   _signees = std::move( result );
+   _signees_digest = key;
+}
+
 
 
 set<public_key_type> signed_transaction::get_required_signatures(
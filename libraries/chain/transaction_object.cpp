@@ -22,9 +22,30 @@
  * THE SOFTWARE.
  */
 #include <graphene/chain/transaction_object.hpp>
+#include <graphene/chain/protocol/fee_schedule.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/smart_ref_impl.hpp>
 
 namespace graphene { namespace chain {
 
+std::vector<char> pack_trx_record( const trx_object& obj )
+{
+   std::vector<char> value( 1 + fc::raw::pack_size(obj) );
+   value[0] = char(GRAPHENE_TRX_RECORD_FORMAT_VERSION);
+   fc::raw::pack( value.data() + 1, uint32_t(value.size() - 1), obj );
+   return value;
+}
+
+trx_object unpack_trx_record( const std::string& value )
+{
+   FC_ASSERT( !value.empty(), "empty transaction record" );
+   if( value[0] == '{' )
+      return fc::json::from_string(value).as<trx_object>();
+   FC_ASSERT( uint8_t(value[0]) == GRAPHENE_TRX_RECORD_FORMAT_VERSION, "unknown transaction record format ${v}", ("v", uint8_t(value[0])) );
+   return fc::raw::unpack<trx_object>( value.data() + 1, uint32_t(value.size() - 1) );
+}
+
 const object* transaction_index::create(const std::function<void (object*)>& constructor, object_id_type)
 {
    transaction_object obj;
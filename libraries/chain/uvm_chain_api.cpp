@@ -1,5 +1,6 @@
 #include <graphene/chain/protocol/asset.hpp>
 #include <graphene/chain/contract_evaluate.hpp>
+#include <graphene/chain/contract_bytecode_cache.hpp>
 #include <graphene/chain/forks.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/protocol/address.hpp>
@@ -271,7 +272,8 @@ namespace graphene {
 			auto code = get_contract_code_by_name(evaluator, contract_name);
 			if (code && (code->code.size() <= LUA_MODULE_BYTE_STREAM_BUF_SIZE))
 			{
-				return get_bytestream_from_code(L, *code);
+				return contract_bytecode_cache::instance().get_or_load(contract_name, *code,
+					[&](const uvm::blockchain::Code& c) { return get_bytestream_from_code(L, c); });
 			}
 
 			return nullptr;
@@ -284,7 +286,8 @@ namespace graphene {
 			auto code = get_contract_code_by_id(evaluator, std::string(address));
 			if (code && (code->code.size() <= LUA_MODULE_BYTE_STREAM_BUF_SIZE))
 			{
-				return get_bytestream_from_code(L, *code);
+				return contract_bytecode_cache::instance().get_or_load(std::string(address), *code,
+					[&](const uvm::blockchain::Code& c) { return get_bytestream_from_code(L, c); });
 			}
 
 			return nullptr;
@@ -1056,6 +1059,9 @@ namespace graphene {
 			if(fork_key == "MOD_CHANGE_LIST") {
 				return USE_MOD_CHANGE_LIST_HEIGHT;
 			}
+			if(fork_key == "EXACT_STRING_POOL") {
+				return USE_EXACT_STRING_POOL_FORK_HEIGHT;
+			}
 			return -1;
 		}
 
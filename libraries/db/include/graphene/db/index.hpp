@@ -33,6 +33,26 @@ namespace graphene { namespace db {
    class object_database;
    using fc::path;
 
+   FC_DECLARE_EXCEPTION( corrupted_index_file, 3070005, "corrupted object database file" );
+
+   /**
+    * Stream adapter used when saving an index, forwards to the file and feeds
+    * every byte into the checksum stored at the end of the file.
+    */
+   class checksummed_ofstream
+   {
+      public:
+         checksummed_ofstream( std::ofstream& out ):_out(out){}
+
+         void write( const char* d, size_t s ) { _out.write( d, s ); _enc.write( d, s ); }
+         void put( char c ) { write( &c, 1 ); }
+         fc::sha256 checksum() { return _enc.result(); }
+
+      private:
+         std::ofstream&       _out;
+         fc::sha256::encoder  _enc;
+   };
+
    /**
     * @class index_observer
     * @brief used to get callbacks when objects change
@@ -95,6 +115,16 @@ namespace graphene { namespace db {
           */
          virtual void open( const fc::path& db ) = 0;
          virtual void save( const fc::path& db ) = 0;
+         /**
+          *  Loads the objects of a file like open() without telling the secondary
+          *  indexes, so that several indexes may be read at once on different threads.
+          *  notify_loaded() must follow on a single thread.
+          */
+         virtual void read_file( const fc::path& db ) = 0;
+         /** passes the objects of the last read_file() to the secondary indexes */
+         virtual void notify_loaded() = 0;
+         /** drops every object and resets the next id, without undo state or observers */
+         virtual void clear_objects() = 0;
 
 
 
@@ -223,45 +253,144 @@ namespace graphene { namespace db {
             return fc::sha256::hash(desc);
          }
 
+         /** version written by save(), the file ends with the object count and a sha256 of everything before it */
+         fc::sha256 get_file_version()const
+         {
+            std::string desc = "1.0-checksum";
+            return fc::sha256::hash(desc);
+         }
+
          virtual void open( const path& db )override
+         {
+            read_file( db );
+            notify_loaded();
+         }
+
+         virtual void read_file( const path& db )override
          { 
+            _loaded.clear();
             if( !fc::exists( db ) ) return;
             fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
             fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
-            fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
+            const char* data = (const char*)mr.get_address();
+            fc::datastream<const char*> ds( data, mr.get_size() );
             fc::sha256 open_ver;
 
             fc::raw::unpack(ds, _next_id);
             fc::raw::unpack(ds, open_ver);
-            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+            if( open_ver == get_object_version() )
+            {
+               // legacy file without checksum, read until the data runs out
+               try {
+                  vector<char> tmp;
+                  while( true ) 
+                  {
+                     fc::raw::unpack( ds, tmp );
+                     _loaded.push_back( &DerivedIndex::insert( fc::raw::unpack<object_type>( tmp ) ) );
+                  }
+               } catch ( const fc::exception&  ){}
+               return;
+            }
+            FC_ASSERT( open_ver == get_file_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+
+            const size_t trailer_size = sizeof(uint64_t) + sizeof(fc::sha256);
+            if( mr.get_size() < ds.tellp() + trailer_size )
+               FC_THROW_EXCEPTION( corrupted_index_file, "truncated file ${f}", ("f",db) );
+            const size_t end = mr.get_size() - trailer_size;
+            fc::datastream<const char*> trailer( data + end, trailer_size );
+            uint64_t count;
+            fc::sha256 checksum;
+            fc::raw::unpack( trailer, count );
+            fc::raw::unpack( trailer, checksum );
+            fc::sha256::encoder enc;
+            for( size_t pos = 0; pos < end; pos += std::min<size_t>( end - pos, 1 << 30 ) )
+               enc.write( data + pos, std::min<size_t>( end - pos, 1 << 30 ) );
+            if( enc.result() != checksum )
+               FC_THROW_EXCEPTION( corrupted_index_file, "checksum mismatch in ${f}", ("f",db) );
+
+            uint64_t loaded = 0;
             try {
-               vector<char> tmp;
-               while( true ) 
+               while( ds.tellp() < end )
                {
-                  fc::raw::unpack( ds, tmp );
-                  load( tmp );
+                  fc::unsigned_int size;
+                  fc::raw::unpack( ds, size );
+                  FC_ASSERT( size.value <= end - ds.tellp() );
+                  fc::datastream<const char*> obj_ds( data + ds.tellp(), size.value );
+                  object_type obj;
+                  fc::raw::unpack( obj_ds, obj );
+                  ds.skip( size.value );
+                  _loaded.push_back( &DerivedIndex::insert( std::move(obj) ) );
+                  ++loaded;
                }
-            } catch ( const fc::exception&  ){}
+            } catch ( const fc::exception& e ) {
+               FC_THROW_EXCEPTION( corrupted_index_file, "failed to load ${f}: ${e}", ("f",db)("e",e.to_detail_string()) );
+            }
+            if( loaded != count )
+               FC_THROW_EXCEPTION( corrupted_index_file, "${f} holds ${l} objects, expected ${c}", ("f",db)("l",loaded)("c",count) );
          }
 
+         /**
+          * Objects are packed straight into the file, no per object buffer, and
+          * the file is written next to the old one and renamed once complete.
+          */
          virtual void save( const path& db ) override 
          {
-            std::ofstream out( db.generic_string(), 
-                               std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
-            FC_ASSERT( out );
-            auto ver  = get_object_version();
-            fc::raw::pack( out, _next_id );
-            fc::raw::pack( out, ver );
-            this->inspect_all_objects( [&]( const object& o ) {
-                auto vec = fc::raw::pack( static_cast<const object_type&>(o) );
-                auto packed_vec = fc::raw::pack( vec );
-                out.write( packed_vec.data(), packed_vec.size() );
-            });
+            const path tmp_path = db.generic_string() + ".tmp";
+            {
+               std::ofstream out( tmp_path.generic_string(), 
+                                  std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+               FC_ASSERT( out );
+               checksummed_ofstream stream( out );
+               auto ver  = get_file_version();
+               fc::raw::pack( stream, _next_id );
+               fc::raw::pack( stream, ver );
+               uint64_t count = 0;
+               this->inspect_all_objects( [&]( const object& o ) {
+                   const auto& obj = static_cast<const object_type&>(o);
+                   fc::raw::pack( stream, fc::unsigned_int( fc::raw::pack_size( obj ) ) );
+                   fc::raw::pack( stream, obj );
+                   ++count;
+               });
+               fc::raw::pack( stream, count );
+               auto checksum = stream.checksum();
+               fc::raw::pack( out, checksum );
+               out.flush();
+               FC_ASSERT( out, "failed to write ${f}", ("f",tmp_path) );
+            }
+            fc::rename( tmp_path, db );
+         }
+
+         virtual void notify_loaded()override
+         {
+            for( const object* obj : _loaded )
+               for( const auto& item : _sindex )
+                  item->object_inserted( *obj );
+            _loaded.clear();
+            _loaded.shrink_to_fit();
+         }
+
+         virtual void clear_objects()override
+         {
+            notify_loaded();
+            vector<const object*> objects;
+            this->inspect_all_objects( [&]( const object& o ) { objects.push_back( &o ); } );
+            for( const object* obj : objects )
+            {
+               for( const auto& item : _sindex )
+                  item->object_removed( *obj );
+               DerivedIndex::remove( *obj );
+            }
+            _next_id = object_id_type( object_type::space_id, object_type::type_id, 0 );
          }
 
          virtual const object&  load( const std::vector<char>& data )override
          {
-            const auto& result = DerivedIndex::insert( fc::raw::unpack<object_type>( data ) );
+            return load( fc::raw::unpack<object_type>( data ) );
+         }
+
+         const object&  load( object_type&& obj )
+         {
+            const auto& result = DerivedIndex::insert( std::move(obj) );
             for( const auto& item : _sindex )
                item->object_inserted( result );
             return result;
@@ -320,7 +449,8 @@ namespace graphene { namespace db {
          }
 
       private:
-         object_id_type _next_id;
+         object_id_type          _next_id;
+         vector<const object*>   _loaded; ///< read by read_file(), not yet passed to the secondary indexes
    };
 
 } } // graphene::db
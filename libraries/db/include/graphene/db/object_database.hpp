@@ -27,8 +27,10 @@
 #include <graphene/db/undo_database.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/thread/thread.hpp>
 
 #include <map>
+#include <functional>
 
 namespace graphene { namespace db {
 
@@ -43,13 +45,19 @@ namespace graphene { namespace db {
          ~object_database();
 
          void reset_indexes() { _index.clear(); _index.resize(255); }
+         /** empties every index but keeps the indexes, their observers and secondary indexes */
+         void clear_objects();
 
          void open(const fc::path& data_dir );
+         /** opens @p data_dir with the index files of a snapshot written by save_snapshot() */
+         void open(const fc::path& data_dir, const fc::path& snapshot_dir );
 
          /**
           * Saves the complete state of the object_database to disk, this could take a while
           */
          void flush();
+         /** saves the complete state to @p snapshot_dir, the files in data_dir are left alone */
+         void save_snapshot(const fc::path& snapshot_dir );
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
@@ -165,10 +173,18 @@ namespace graphene { namespace db {
          void save_undo( const object& obj );
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
+         void init_index_file_threads();
+         /**
+          * runs action on every index and its file below @p dir, spread over the index file threads.
+          * The calling thread blocks until all are done.
+          */
+         void for_each_index_file( const fc::path& dir, const std::function<void(index&, const fc::path&)>& action );
 
          fc::path                                                  _data_dir;
          vector< vector< unique_ptr<index> > >                     _index;
+         vector< unique_ptr<fc::thread> >                          _index_file_threads;
 		 leveldb::DB* db = nullptr;;
+		 const leveldb::FilterPolicy* filter_policy = nullptr;
 		 leveldb::Status open_status;
    };
 
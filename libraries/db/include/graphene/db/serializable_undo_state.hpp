@@ -8,6 +8,12 @@
 #include <leveldb/db.h>
 #include <map>
 #include <set>
+
+/**
+ * Version tag written as the first byte of every fc::raw encoded undo state
+ * in undo_storage. Legacy entries were written as JSON and always start with '{'.
+ */
+#define GRAPHENE_UNDO_STATE_FORMAT_VERSION 1
 using namespace graphene::chain;
 namespace graphene {
 	namespace db {
@@ -36,6 +42,29 @@ namespace graphene {
 			undo_state_id_type undo_id()const;
 		};
 
+		/**
+		 * Binary counterpart of serializable_obj, holds the fc::raw packed object
+		 * instead of its variant so that no JSON round trip is needed.
+		 */
+		struct packed_obj
+		{
+			uint8_t s = 0;
+			uint8_t t = 0;
+			std::vector<char> data;
+			packed_obj() {}
+			packed_obj(const object& obj);
+			unique_ptr<object>  to_object() const;
+		};
+
+		struct packed_undo_state
+		{
+			std::map<object_id_type, packed_obj>     old_values;
+			std::map<object_id_type, object_id_type> old_index_next_ids;
+			std::set<object_id_type>                 new_ids;
+			std::map<object_id_type, packed_obj>     removed;
+			undo_state_id_type undo_id()const;
+		};
+
 
 		//struct by_undo {};
 		//struct by_object_id {};
@@ -53,3 +82,5 @@ namespace graphene {
 }
 FC_REFLECT(graphene::db::serializable_obj, (s)(t)(obj))
 FC_REFLECT(graphene::db::serializable_undo_state, (old_values)(old_index_next_ids)(new_ids)(removed))
+FC_REFLECT(graphene::db::packed_obj, (s)(t)(data))
+FC_REFLECT(graphene::db::packed_undo_state, (old_values)(old_index_next_ids)(new_ids)(removed))
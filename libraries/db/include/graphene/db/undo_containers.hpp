@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/object.hpp>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @class undo_arena
+    *  @brief bump allocator for the objects an undo session clones
+    *
+    *  Memory is only given back when the arena is cleared or destroyed, the objects
+    *  placed in it must be destroyed by their owner before that.  A merged session
+    *  hands its blocks to the parent session with splice(), so objects moved into
+    *  the parent stay where they are.
+    */
+   class undo_arena
+   {
+      public:
+         undo_arena() {}
+         undo_arena( const undo_arena& ) = delete;
+         undo_arena& operator=( const undo_arena& ) = delete;
+
+         void* allocate( size_t size )
+         {
+            size = (size + alignment - 1) & ~(alignment - 1);
+            if( size > _left )
+               add_block( size );
+            auto result = _top;
+            _top += size;
+            _left -= size;
+            return result;
+         }
+
+         /** takes over the blocks of @p other, which is left empty */
+         void splice( undo_arena& other )
+         {
+            if( other._blocks.empty() )
+               return;
+            _blocks.reserve( _blocks.size() + other._blocks.size() );
+            for( auto& block : other._blocks )
+               _blocks.push_back( std::move( block ) );
+            // keep bumping in whichever current block has more room
+            if( other._left > _left )
+            {
+               _top = other._top;
+               _left = other._left;
+            }
+            _next_block_size = std::max<size_t>( _next_block_size, other._next_block_size );
+            other._blocks.clear();
+            other._top = nullptr;
+            other._left = 0;
+            other._next_block_size = first_block_size;
+         }
+
+         void swap( undo_arena& other )
+         {
+            std::swap( _blocks, other._blocks );
+            std::swap( _top, other._top );
+            std::swap( _left, other._left );
+            std::swap( _next_block_size, other._next_block_size );
+         }
+
+         void clear()
+         {
+            _blocks.clear();
+            _top = nullptr;
+            _left = 0;
+            _next_block_size = first_block_size;
+         }
+
+      private:
+         // most sessions are a single transaction touching a few objects, blocks grow for the bigger ones
+         enum : size_t {
+            first_block_size = 2048,
+            max_block_size = 64 * 1024,
+            alignment = 16
+         };
+
+         void add_block( size_t size )
+         {
+            auto block_size = std::max<size_t>( size, _next_block_size );
+            _blocks.emplace_back( new char[block_size] );
+            _top = _blocks.back().get();
+            _left = block_size;
+            _next_block_size = std::min<size_t>( _next_block_size * 2, max_block_size );
+         }
+
+         std::vector<std::unique_ptr<char[]>> _blocks;
+         char*  _top = nullptr;
+         size_t _left = 0;
+         size_t _next_block_size = first_block_size;
+   };
+
+   /**
+    *  Deletes heap objects and only destroys the ones placed in an undo_arena.
+    *  Objects read back from the undo storage are on the heap.
+    */
+   struct undo_object_deleter
+   {
+      undo_object_deleter( bool in_arena = false ) : in_arena( in_arena ) {}
+      undo_object_deleter( const std::default_delete<object>& ) {}
+
+      void operator()( object* obj )const
+      {
+         if( in_arena )
+            obj->~object();
+         else
+            delete obj;
+      }
+
+      bool in_arena = false;
+   };
+   typedef std::unique_ptr<object, undo_object_deleter> undo_object_ptr;
+
+   inline object_id_type undo_entry_id( const object_id_type& id ) { return id; }
+   template<typename T>
+   inline object_id_type undo_entry_id( const std::pair<object_id_type, T>& entry ) { return entry.first; }
+
+   /**
+    *  @class object_id_table
+    *  @brief the bookkeeping of an undo_state: entries keyed by object id in a flat vector
+    *
+    *  Lookups go through an open addressing index once the table outgrows a linear scan.
+    *  Entries are kept in the order they were added and sorted by id only when the table
+    *  is iterated, so undo, notifications and serialization still see them in id order.
+    *  entries() gives them unsorted where the order does not matter.
+    *
+    *  Entry is object_id_type for a set or std::pair<object_id_type, T> for a map.
+    */
+   template<typename Entry>
+   class object_id_table
+   {
+      public:
+         typedef typename std::vector<Entry>::iterator       iterator;
+         typedef typename std::vector<Entry>::const_iterator const_iterator;
+
+         size_t size()const  { return _entries.size(); }
+         bool   empty()const { return _entries.empty(); }
+
+         Entry* find( object_id_type id )
+         {
+            auto pos = position( id );
+            return pos < _entries.size() ? &_entries[pos] : nullptr;
+         }
+         const Entry* find( object_id_type id )const
+         {
+            auto pos = position( id );
+            return pos < _entries.size() ? &_entries[pos] : nullptr;
+         }
+         size_t count( object_id_type id )const { return position( id ) < _entries.size() ? 1 : 0; }
+
+         /** adds @p entry unless its id is already there; returns the entry kept and whether it was added */
+         std::pair<Entry*, bool> insert( Entry&& entry )
+         {
+            auto id = undo_entry_id( entry );
+            auto pos = position( id );
+            if( pos < _entries.size() )
+               return std::make_pair( &_entries[pos], false );
+            if( !_entries.empty() && id < undo_entry_id( _entries.back() ) )
+               _sorted = false;
+            _entries.push_back( std::move( entry ) );
+            if( !_slots.empty() )
+               index_entry( _entries.size() - 1 );
+            else if( _entries.size() > linear_scan_limit )
+               rebuild_index();
+            return std::make_pair( &_entries.back(), true );
+         }
+         std::pair<Entry*, bool> insert( const Entry& entry ) { return insert( Entry( entry ) ); }
+
+         template<typename T = Entry>
+         typename T::second_type& operator[]( object_id_type id )
+         {
+            return insert( Entry( id, typename T::second_type() ) ).first->second;
+         }
+
+         bool erase( object_id_type id )
+         {
+            auto pos = position( id );
+            if( pos >= _entries.size() )
+               return false;
+            if( !_slots.empty() )
+               unindex( id );
+            if( pos + 1 != _entries.size() )
+            {
+               // the last entry fills the gap
+               if( !_slots.empty() )
+                  _slots[slot_of( undo_entry_id( _entries.back() ) )] = uint32_t( pos + 1 );
+               _entries[pos] = std::move( _entries.back() );
+               _sorted = false;
+            }
+            _entries.pop_back();
+            return true;
+         }
+
+         void clear()
+         {
+            _entries.clear();
+            _slots.clear();
+            _sorted = true;
+         }
+
+         void reserve( size_t n ) { _entries.reserve( n ); }
+
+         void swap( object_id_table& other )
+         {
+            std::swap( _entries, other._entries );
+            std::swap( _slots, other._slots );
+            std::swap( _sorted, other._sorted );
+         }
+
+         /** entries in no particular order */
+         std::vector<Entry>&       entries()       { return _entries; }
+         const std::vector<Entry>& entries()const  { return _entries; }
+
+         /** ordered by id */
+         iterator       begin()       { sort(); return _entries.begin(); }
+         iterator       end()         { return _entries.end(); }
+         const_iterator begin()const  { sort(); return _entries.begin(); }
+         const_iterator end()const    { return _entries.end(); }
+
+      private:
+         enum : size_t { linear_scan_limit = 8 };
+
+         static size_t hash( object_id_type id )
+         {
+            return size_t( (id.number * 0x9E3779B97F4A7C15ull) >> 32 );
+         }
+
+         size_t position( object_id_type id )const
+         {
+            if( _slots.empty() )
+            {
+               for( size_t i = 0; i < _entries.size(); ++i )
+                  if( undo_entry_id( _entries[i] ) == id )
+                     return i;
+               return _entries.size();
+            }
+            auto mask = _slots.size() - 1;
+            for( auto s = hash( id ) & mask; _slots[s] != 0; s = (s + 1) & mask )
+               if( undo_entry_id( _entries[_slots[s] - 1] ) == id )
+                  return _slots[s] - 1;
+            return _entries.size();
+         }
+
+         // slot of an id that is in the index
+         size_t slot_of( object_id_type id )const
+         {
+            auto mask = _slots.size() - 1;
+            auto s = hash( id ) & mask;
+            while( undo_entry_id( _entries[_slots[s] - 1] ) != id )
+               s = (s + 1) & mask;
+            return s;
+         }
+
+         void index_entry( size_t pos )
+         {
+            if( (_entries.size()) * 2 > _slots.size() )
+            {
+               rebuild_index();
+               return;
+            }
+            auto mask = _slots.size() - 1;
+            auto s = hash( undo_entry_id( _entries[pos] ) ) & mask;
+            while( _slots[s] != 0 )
+               s = (s + 1) & mask;
+            _slots[s] = uint32_t( pos + 1 );
+         }
+
+         // backward shift deletion keeps every probe sequence free of holes
+         void unindex( object_id_type id )
+         {
+            auto mask = _slots.size() - 1;
+            auto hole = slot_of( id );
+            auto s = hole;
+            while( true )
+            {
+               s = (s + 1) & mask;
+               if( _slots[s] == 0 )
+                  break;
+               auto home = hash( undo_entry_id( _entries[_slots[s] - 1] ) ) & mask;
+               // move the entry back unless its home lies cyclically in (hole, s]
+               if( (s > hole) ? (home <= hole || home > s) : (home <= hole && home > s) )
+               {
+                  _slots[hole] = _slots[s];
+                  hole = s;
+               }
+            }
+            _slots[hole] = 0;
+         }
+
+         void rebuild_index()const
+         {
+            size_t capacity = 16;
+            while( capacity < _entries.size() * 2 )
+               capacity *= 2;
+            _slots.assign( capacity, 0 );
+            auto mask = capacity - 1;
+            for( size_t pos = 0; pos < _entries.size(); ++pos )
+            {
+               auto s = hash( undo_entry_id( _entries[pos] ) ) & mask;
+               while( _slots[s] != 0 )
+                  s = (s + 1) & mask;
+               _slots[s] = uint32_t( pos + 1 );
+            }
+         }
+
+         void sort()const
+         {
+            if( _sorted )
+               return;
+            std::sort( _entries.begin(), _entries.end(), []( const Entry& a, const Entry& b ) {
+               return undo_entry_id( a ) < undo_entry_id( b );
+            } );
+            _sorted = true;
+            if( !_slots.empty() )
+               rebuild_index();
+         }
+
+         // mutable so that iterating a const table can sort it first
+         mutable std::vector<Entry>    _entries;
+         mutable std::vector<uint32_t> _slots; // entry position + 1, 0 when free
+         mutable bool                  _sorted = true;
+   };
+
+} } // graphene::db
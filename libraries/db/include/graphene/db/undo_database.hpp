@@ -24,6 +24,7 @@
 #pragma once
 #include <fc/crypto/ripemd160.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/undo_containers.hpp>
 #include <deque>
 #include <fc/exception/exception.hpp>
 #include <fstream>
@@ -44,13 +45,22 @@ namespace graphene {
 		struct undo_state
 		{
 			undo_state() {}
-			map<object_id_type, unique_ptr<object> > old_values;
-			map<object_id_type, object_id_type>      old_index_next_ids;
-			std::set<object_id_type>                 new_ids;
-			map<object_id_type, unique_ptr<object> > removed;
+			// declared first so that the objects in the tables are destroyed before their memory
+			undo_arena                                              arena;
+			object_id_table<std::pair<object_id_type, undo_object_ptr>> old_values;
+			map<object_id_type, object_id_type>                     old_index_next_ids;
+			object_id_table<object_id_type>                         new_ids;
+			object_id_table<std::pair<object_id_type, undo_object_ptr>> removed;
+			/** copy of @p obj placed in the arena */
+			undo_object_ptr clone_object(const object& obj);
+			bool empty()const;
+			void swap(undo_state& other);
 			serializable_undo_state get_serializable_undo_state() const;
+			packed_undo_state get_packed_undo_state() const;
 			undo_state(const serializable_undo_state& sta);
+			undo_state(const packed_undo_state& sta);
 			undo_state& operator=(const serializable_undo_state& sta);
+			undo_state& operator=(const packed_undo_state& sta);
 			undo_state& operator=(const undo_state& sta);
 			void reset();
 		};
@@ -63,16 +73,28 @@ namespace graphene {
 			void close();
 			~undo_storage() { close(); };
 			bool store(const undo_state_id_type & _id, const serializable_undo_state& b);
+			bool store(const undo_state_id_type & _id, const packed_undo_state& b);
 			undo_state_id_type store_undo_state(const undo_state& b);
 			bool remove(const undo_state_id_type& id);
 			bool get_state(const undo_state_id_type& id,undo_state& state) const ;
 			bool                   contains(const undo_state_id_type& id)const;
 			block_id_type          fetch_block_id(uint32_t block_num)const;
 			optional<serializable_undo_state> fetch_optional(const undo_state_id_type& id)const;
+			optional<packed_undo_state> fetch_packed_optional(const undo_state_id_type& id)const;
+			/**
+			 * Rewrites every legacy JSON encoded state in place with the fc::raw format,
+			 * keeping the key so that ids saved in the stack file stay valid.
+			 * Records the format version once done; later calls skip the scan.
+			 * @return the number of migrated entries
+			 */
+			uint32_t migrate_legacy_states();
 			optional<serializable_undo_state> fetch_by_number(uint32_t block_num)const;
 			optional<serializable_undo_state> last()const;
 			optional<undo_state_id_type> last_id()const;
 		private:
+			bool read(const undo_state_id_type& id, string& out)const;
+			static std::vector<char> pack_state(const packed_undo_state& state);
+			static packed_undo_state unpack_state(const string& value);
 			leveldb::DB* db = NULL;;
 			leveldb::Status open_status;
 		};
@@ -174,6 +196,10 @@ namespace graphene {
 
 			void save_to_file(const fc::string& path);
 			void from_file(const fc::string& path);
+			/** writes every undo state, oldest first, to @p file without touching the stack or the storage */
+			void save_snapshot(const fc::path& file)const;
+			/** replaces the storage and stack files under @p path with the states of a snapshot, to be read by from_file() */
+			static void restore_snapshot(const fc::path& file, const fc::string& path);
 			void reset();
 			void remove_storage();
 		private:
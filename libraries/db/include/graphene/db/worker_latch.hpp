@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <fc/thread/scoped_lock.hpp>
+
+#include <condition_variable>
+#include <mutex>
+
+namespace graphene { namespace db {
+
+   /**
+    * Counts the tasks handed to worker threads. The chain thread blocks on it instead of waiting
+    * on their futures: waiting on a future yields the fiber, and other tasks of the chain thread could then
+    * change the database in the middle of a block, a transaction or a load.
+    */
+   class worker_latch
+   {
+      public:
+         explicit worker_latch( size_t count ) : _remaining( count ) {}
+
+         void count_down()
+         {
+            fc::scoped_lock<std::mutex> lock( _mutex );
+            if( --_remaining == 0 )
+               _done.notify_one();
+         }
+
+         void wait()
+         {
+            std::unique_lock<std::mutex> lock( _mutex );
+            _done.wait( lock, [this]() { return _remaining == 0; } );
+         }
+
+      private:
+         std::mutex              _mutex;
+         std::condition_variable _done;
+         size_t                  _remaining;
+   };
+
+} } // graphene::db
@@ -22,11 +22,18 @@
  * THE SOFTWARE.
  */
 #include <graphene/db/object_database.hpp>
+#include <graphene/db/worker_latch.hpp>
 
 #include <fc/io/raw.hpp>
 #include <fc/container/flat.hpp>
 #include <fc/uint128.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/thread/scoped_lock.hpp>
 #include <leveldb/db.h>
+#include <leveldb/filter_policy.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
 namespace graphene { namespace db {
 
 object_database::object_database()
@@ -43,6 +50,9 @@ void object_database::initialize_leveldb()
 {
 	leveldb::Options options;
 	options.create_if_missing = true;
+	if (filter_policy == nullptr)
+		filter_policy = leveldb::NewBloomFilterPolicy(10);
+	options.filter_policy = filter_policy;
 	open_status = leveldb::DB::Open(options, (get_data_dir() / "transactions").string(), &db);
 	if (!open_status.ok())
 	{
@@ -58,6 +68,9 @@ void object_database::destruct_leveldb()
 	if (db != nullptr)
 		delete db;
 	db = nullptr;
+	if (filter_policy != nullptr)
+		delete filter_policy;
+	filter_policy = nullptr;
 }
 
 void object_database::reinitialize_leveldb()
@@ -72,6 +85,14 @@ void object_database::close()
 {
 }
 
+void object_database::clear_objects()
+{
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            idx->clear_objects();
+}
+
 const object* object_database::find_object( object_id_type id )const
 {
    return get_index(id.space(),id.type()).find( id );
@@ -98,20 +119,82 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
    return *idx;
 }
 
+void object_database::init_index_file_threads()
+{
+   if( !_index_file_threads.empty() )
+      return;
+   const uint32_t count = std::max( std::thread::hardware_concurrency(), 1u );
+   for( uint32_t i = 0; i < count; ++i )
+      _index_file_threads.emplace_back( new fc::thread( "object_database_" + fc::to_string(i) ) );
+}
+
+void object_database::for_each_index_file( const fc::path& dir, const std::function<void(index&, const fc::path&)>& action )
+{
+   vector< std::pair<index*, fc::path> > files;
+   for( uint32_t space = 0; space < _index.size(); ++space )
+      for( uint32_t type = 0; type  < _index[space].size(); ++type )
+         if( _index[space][type] )
+            files.emplace_back( _index[space][type].get(), dir / fc::to_string(space)/fc::to_string(type) );
+   if( files.empty() )
+      return;
+
+   init_index_file_threads();
+   const size_t thread_count = std::min( _index_file_threads.size(), files.size() );
+   std::atomic<size_t> next_file( 0 );
+   std::atomic<bool> failed( false );
+   std::mutex error_mutex;
+   std::shared_ptr<fc::exception> error;
+   worker_latch done( thread_count );
+   for( size_t i = 0; i < thread_count; ++i )
+   {
+      // workers pull the next file so that one huge index does not hold back the others
+      _index_file_threads[i]->async( [&]() {
+         for( size_t j = next_file++; j < files.size() && !failed; j = next_file++ )
+         {
+            try {
+               action( *files[j].first, files[j].second );
+            } catch( const fc::exception& e ) {
+               fc::scoped_lock<std::mutex> lock( error_mutex );
+               if( !error )
+                  error = e.dynamic_copy_exception();
+               failed = true;
+            } catch( const std::exception& e ) {
+               fc::scoped_lock<std::mutex> lock( error_mutex );
+               if( !error )
+                  error = std::make_shared<fc::exception>( FC_LOG_MESSAGE( error, "${f}: ${what}", ("f",files[j].second)("what",e.what()) ) );
+               failed = true;
+            } catch( ... ) {
+               fc::scoped_lock<std::mutex> lock( error_mutex );
+               if( !error )
+                  error = std::make_shared<fc::unhandled_exception>( FC_LOG_MESSAGE( error, "${f}: unknown exception", ("f",files[j].second) ), std::current_exception() );
+               failed = true;
+            }
+         }
+         done.count_down();
+      }, "for_each_index_file" );
+   }
+   // blocks the thread instead of yielding, nothing else may touch the indexes while they are read or written
+   done.wait();
+   if( error )
+      error->dynamic_rethrow_exception();
+}
+
 void object_database::flush()
 {
 //   ilog("Save object_database in ${d}", ("d", _data_dir));
 	if ("" == _data_dir){
 		return;
 	}
+   save_snapshot( _data_dir / "object_database" );
+}
+
+void object_database::save_snapshot(const fc::path& snapshot_dir)
+{
    for( uint32_t space = 0; space < _index.size(); ++space )
-   {
-      fc::create_directories( _data_dir / "object_database" / fc::to_string(space) );
-      const auto types = _index[space].size();
-      for( uint32_t type = 0; type  <  types; ++type )
-         if( _index[space][type] )
-            _index[space][type]->save( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
-   }
+      fc::create_directories( snapshot_dir / fc::to_string(space) );
+   for_each_index_file( snapshot_dir, []( index& idx, const fc::path& file ) {
+      idx.save( file );
+   });
 }
 
 void object_database::wipe(const fc::path& data_dir)
@@ -123,16 +206,25 @@ void object_database::wipe(const fc::path& data_dir)
 }
 
 void object_database::open(const fc::path& data_dir)
+{
+   open( data_dir, data_dir / "object_database" );
+}
+
+void object_database::open(const fc::path& data_dir, const fc::path& snapshot_dir)
 { try {
-   ilog("Opening object database from ${d} ...", ("d", data_dir));
+   ilog("Opening object database from ${d} ...", ("d", snapshot_dir));
    _data_dir = data_dir;
-   for( uint32_t space = 0; space < _index.size(); ++space )
-      for( uint32_t type = 0; type  < _index[space].size(); ++type )
-         if( _index[space][type] )
-            _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
+   for_each_index_file( snapshot_dir, []( index& idx, const fc::path& file ) {
+      idx.read_file( file );
+   });
+   // secondary indexes may look at other indexes or shared state, they hear of the objects on this thread only
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            idx->notify_loaded();
    ilog( "Done opening object database." );
 
-} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+} FC_CAPTURE_AND_RETHROW( (data_dir)(snapshot_dir) ) }
 
 
 void object_database::pop_undo()
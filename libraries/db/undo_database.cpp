@@ -24,6 +24,8 @@
 #include <graphene/db/object_database.hpp>
 #include <graphene/db/undo_database.hpp>
 #include <fc/reflect/variant.hpp>
+#include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
 #include <iostream>
 
 #include <graphene/chain/protocol/types.hpp>
@@ -61,6 +63,7 @@
 #include <iostream>
 #include <leveldb/db.h>
 #include <leveldb/cache.h>
+#include <leveldb/write_batch.h>
 #include <fc/smart_ref_impl.hpp>
 #define STACK_FILE_NAME  "stack"
 #define STORAGE_FILE_NAME "storage"
@@ -144,11 +147,10 @@ void undo_database::on_modify( const object& obj )
 
 
    auto& state = back.back();
-   if( state.new_ids.find(obj.id) != state.new_ids.end() )
+   if( state.new_ids.count(obj.id) )
       return;
-   auto itr =  state.old_values.find(obj.id);
-   if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   if( state.old_values.count(obj.id) ) return;
+   state.old_values.insert( std::make_pair( obj.id, state.clone_object(obj) ) );
 }
 void undo_database::on_remove( const object& obj )
 {
@@ -156,19 +158,17 @@ void undo_database::on_remove( const object& obj )
 
 
    undo_state& state = back.back();
-   if( state.new_ids.count(obj.id) )
-   {
-      state.new_ids.erase(obj.id);
+   if( state.new_ids.erase(obj.id) )
       return;
-   }
-   if( state.old_values.count(obj.id) )
+   auto old_value = state.old_values.find(obj.id);
+   if( old_value )
    {
-      state.removed[obj.id] = std::move(state.old_values[obj.id]);
+      state.removed.insert( std::make_pair( obj.id, std::move(old_value->second) ) );
       state.old_values.erase(obj.id);
       return;
    }
    if( state.removed.count(obj.id) ) return;
-   state.removed[obj.id] = obj.clone();
+   state.removed.insert( std::make_pair( obj.id, state.clone_object(obj) ) );
 }
 
 void undo_database::undo()
@@ -223,6 +223,8 @@ void undo_database::merge()
 
    auto& state = back.back();
    auto& prev_state = back[back.size() - 2];
+   if( prev_state.empty() )
+      prev_state.swap( state ); // the composition with a nop state is the other state
 
    //auto& state = back.;
    //undo_state sta;
@@ -272,27 +274,30 @@ void undo_database::merge()
 
    // We can only be outside type A/AB (the nop path) if B is not nop, so it suffices to iterate through B's three containers.
 
+   // the child's clones are moved, not copied, so the parent takes over the arena they live in
+   prev_state.arena.splice( state.arena );
+
    // *+upd
-   for( auto& obj : state.old_values )
+   for( auto& obj : state.old_values.entries() )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.count(obj.first) )
       {
          // new+upd -> new, type A
          continue;
       }
-      if( prev_state.old_values.find(obj.second->id) != prev_state.old_values.end() )
+      if( prev_state.old_values.count(obj.first) )
       {
          // upd(was=X) + upd(was=Y) -> upd(was=X), type A
          continue;
       }
       // del+upd -> N/A
-      assert( prev_state.removed.find(obj.second->id) == prev_state.removed.end() );
+      assert( !prev_state.removed.count(obj.first) );
       // nop+upd(was=Y) -> upd(was=Y), type B
-      prev_state.old_values[obj.second->id] = std::move(obj.second);
+      prev_state.old_values.insert( std::make_pair( obj.first, std::move(obj.second) ) );
    }
 
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
-   for( auto id : state.new_ids )
+   for( auto id : state.new_ids.entries() )
       prev_state.new_ids.insert(id);
 
    // old_index_next_ids can only be updated, iterate over *+upd cases
@@ -313,26 +318,25 @@ void undo_database::merge()
    }
 
    // *+del
-   for( auto& obj : state.removed )
+   for( auto& obj : state.removed.entries() )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.erase(obj.first) )
       {
          // new + del -> nop (type C)
-         prev_state.new_ids.erase(obj.second->id);
          continue;
       }
-      auto it = prev_state.old_values.find(obj.second->id);
-      if( it != prev_state.old_values.end() )
+      auto old_value = prev_state.old_values.find(obj.first);
+      if( old_value )
       {
          // upd(was=X) + del(was=Y) -> del(was=X)
-         prev_state.removed[obj.second->id] = std::move(it->second);
-         prev_state.old_values.erase(obj.second->id);
+         prev_state.removed.insert( std::make_pair( obj.first, std::move(old_value->second) ) );
+         prev_state.old_values.erase(obj.first);
          continue;
       }
       // del + del -> N/A
-      assert( prev_state.removed.find( obj.second->id ) == prev_state.removed.end() );
+      assert( !prev_state.removed.count(obj.first) );
       // nop + del(was=Y) -> del(was=Y)
-      prev_state.removed[obj.second->id] = std::move(obj.second);
+      prev_state.removed.insert( std::make_pair( obj.first, std::move(obj.second) ) );
    }
    back.pop_back();
    if (_stack.size() > 0&&back.size()<=5)
@@ -440,6 +444,47 @@ const undo_state& undo_database::head()const
 	state_storage->close();
 }
 
+ void undo_database::save_snapshot(const fc::path& file)const
+ {
+	 std::vector<packed_undo_state> states;
+	 states.reserve(size());
+	 for (const auto& id : _stack)
+	 {
+		 auto sta = state_storage->fetch_packed_optional(id);
+		 FC_ASSERT(sta.valid(), "undo state ${id} missing from storage", ("id", id));
+		 states.push_back(std::move(*sta));
+	 }
+	 for (const auto& sta : back)
+		 states.push_back(sta.get_packed_undo_state());
+	 auto data = fc::raw::pack(states);
+	 std::ofstream out(file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	 out.write(data.data(), data.size());
+	 out.close();
+	 FC_ASSERT(out.good(), "failed to write ${f}", ("f", file));
+ }
+
+ void undo_database::restore_snapshot(const fc::path& file, const fc::string& path)
+ {
+	 std::string data;
+	 fc::read_file_contents(file, data);
+	 auto states = fc::raw::unpack<std::vector<packed_undo_state>>(std::vector<char>(data.begin(), data.end()));
+	 boost::filesystem::remove_all(path + STORAGE_FILE_NAME);
+	 boost::filesystem::remove_all(path + STACK_FILE_NAME);
+	 if (states.empty())
+		 return;
+	 undo_storage storage;
+	 storage.open(path + STORAGE_FILE_NAME);
+	 std::deque<undo_state_id_type> stack;
+	 for (const auto& sta : states)
+	 {
+		 auto id = sta.undo_id();
+		 FC_ASSERT(storage.store(id, sta), "store state failed");
+		 stack.push_back(id);
+	 }
+	 storage.close();
+	 fc::json::save_to_file(stack, path + STACK_FILE_NAME);
+ }
+
  void undo_database::reset()
  {
      _stack.clear();
@@ -460,6 +505,9 @@ const undo_state& undo_database::head()const
 	 std::cout << "open in from file" << std::endl;
 	 state_storage->open(path + STORAGE_FILE_NAME);
 	 storage_path = path;
+	 auto migrated = state_storage->migrate_legacy_states();
+	 if (migrated > 0)
+		 ilog("migrated ${n} undo states to binary format", ("n", migrated));
 	 if (!fc::exists(path+STACK_FILE_NAME))
 		 return;
      try {
@@ -489,7 +537,7 @@ inline serializable_undo_state undo_state::get_serializable_undo_state() const
         res.old_values[i->first] = serializable_obj(*(i->second));
     }
     res.old_index_next_ids = old_index_next_ids;
-    res.new_ids = new_ids;
+    res.new_ids.insert(new_ids.begin(), new_ids.end());
     for (auto i = removed.begin(); i != removed.end(); i++)
     {
         res.removed[i->first] = serializable_obj(*(i->second));
@@ -497,30 +545,70 @@ inline serializable_undo_state undo_state::get_serializable_undo_state() const
 	return res;
 }
 
+packed_undo_state undo_state::get_packed_undo_state() const
+{
+	packed_undo_state res;
+	for (auto i = old_values.begin(); i != old_values.end(); i++)
+	{
+		res.old_values[i->first] = packed_obj(*(i->second));
+	}
+	res.old_index_next_ids = old_index_next_ids;
+	res.new_ids.insert(new_ids.begin(), new_ids.end());
+	for (auto i = removed.begin(); i != removed.end(); i++)
+	{
+		res.removed[i->first] = packed_obj(*(i->second));
+	}
+	return res;
+}
+
 undo_state_id_type serializable_undo_state::undo_id()const
 {
 	auto data=fc::raw::pack(*this);
 	return fc::ripemd160::hash(data.data(), (uint32_t)data.size());
 }
+undo_state_id_type packed_undo_state::undo_id()const
+{
+	auto data = fc::raw::pack(*this);
+	return fc::ripemd160::hash(data.data(), (uint32_t)data.size());
+}
 void undo_state::reset()
 {
 	old_values.clear();
 	old_index_next_ids.clear();
 	new_ids.clear();
 	removed.clear();
+	arena.clear();
+}
+undo_object_ptr undo_state::clone_object(const object& obj)
+{
+	auto memory = arena.allocate(obj.clone_size());
+	return undo_object_ptr(obj.clone_into(memory), undo_object_deleter(true));
+}
+bool undo_state::empty()const
+{
+	return old_values.empty() && old_index_next_ids.empty() && new_ids.empty() && removed.empty();
+}
+void undo_state::swap(undo_state& other)
+{
+	arena.swap(other.arena);
+	old_values.swap(other.old_values);
+	old_index_next_ids.swap(other.old_index_next_ids);
+	new_ids.swap(other.new_ids);
+	removed.swap(other.removed);
 }
 undo_state& undo_state::operator=(const undo_state& sta)
 {
 	reset();
 	for (auto i = sta.old_values.begin(); i != sta.old_values.end(); i++)
 	{
-		old_values[i->first] = i->second->clone();
+		old_values[i->first] = clone_object(*i->second);
 	}
 	old_index_next_ids = sta.old_index_next_ids;
-	new_ids = sta.new_ids;
+	for (auto id : sta.new_ids)
+		new_ids.insert(id);
 	for (auto i = sta.removed.begin(); i != sta.removed.end(); i++)
 	{
-		removed[i->first] = i->second->clone();
+		removed[i->first] = clone_object(*i->second);
 	}
 
 	return *this;
@@ -533,7 +621,25 @@ undo_state& undo_state::operator=(const serializable_undo_state& sta)
 		old_values[i->first] = i->second.to_object();
 	}
 	old_index_next_ids = sta.old_index_next_ids;
-	new_ids = sta.new_ids;
+	for (auto id : sta.new_ids)
+		new_ids.insert(id);
+	for (auto i = sta.removed.begin(); i != sta.removed.end(); i++)
+	{
+		removed[i->first] = i->second.to_object();
+	}
+
+	return *this;
+}
+undo_state& undo_state::operator=(const packed_undo_state& sta)
+{
+	reset();
+	for (auto i = sta.old_values.begin(); i != sta.old_values.end(); i++)
+	{
+		old_values[i->first] = i->second.to_object();
+	}
+	old_index_next_ids = sta.old_index_next_ids;
+	for (auto id : sta.new_ids)
+		new_ids.insert(id);
 	for (auto i = sta.removed.begin(); i != sta.removed.end(); i++)
 	{
 		removed[i->first] = i->second.to_object();
@@ -541,6 +647,10 @@ undo_state& undo_state::operator=(const serializable_undo_state& sta)
 
 	return *this;
 }
+undo_state::undo_state(const packed_undo_state & sta)
+{
+	*this = sta;
+}
 undo_state::undo_state(const serializable_undo_state & sta)
 {
     for (auto i = sta.old_values.begin(); i != sta.old_values.end(); i++)
@@ -548,7 +658,8 @@ undo_state::undo_state(const serializable_undo_state & sta)
         old_values[i->first] = i->second.to_object();
     }
     old_index_next_ids = sta.old_index_next_ids;
-    new_ids = sta.new_ids;
+    for (auto id : sta.new_ids)
+        new_ids.insert(id);
     for (auto i = sta.removed.begin(); i != sta.removed.end(); i++)
     {
         removed[i->first] = i->second.to_object();
@@ -565,12 +676,26 @@ std::unique_ptr<object> create_obj_unique_ptr(const variant& var)
     std::unique_ptr<object> res = make_unique<T>(var.as<T>());
     return res;
 }
+template <typename T>
+std::unique_ptr<object> create_obj_unique_ptr(const std::vector<char>& data)
+{
+    std::unique_ptr<T> res = make_unique<T>();
+    fc::raw::unpack(data, *res);
+    return std::move(res);
+}
 inline db::serializable_obj::serializable_obj(const object & obj) :obj(obj.to_variant())
 {
     s = obj.id.space();
     t = obj.id.type();
 }
-inline std::unique_ptr<object> to_protocol_object(uint8_t t,const variant& var)
+db::packed_obj::packed_obj(const object & obj) :data(obj.pack())
+{
+    s = obj.id.space();
+    t = obj.id.type();
+}
+// var is either the variant of a legacy serializable_obj or the fc::raw bytes of a packed_obj
+template <typename Source>
+inline std::unique_ptr<object> to_protocol_object(uint8_t t,const Source& var)
 {
     switch (t)
     {
@@ -685,7 +810,8 @@ inline std::unique_ptr<object> to_protocol_object(uint8_t t,const variant& var)
 	FC_CAPTURE_AND_THROW(deserialize_object_failed, (var));
     return NULL;
 }
-inline std::unique_ptr<object> to_implementation_object(uint8_t t, const variant& var)
+template <typename Source>
+inline std::unique_ptr<object> to_implementation_object(uint8_t t, const Source& var)
 {
     switch (t)
     {
@@ -763,6 +889,18 @@ std::unique_ptr<object> db::serializable_obj::to_object() const
         throw;
     }
 }
+std::unique_ptr<object> db::packed_obj::to_object() const
+{
+    switch (s)
+    {
+    case chain::protocol_ids:
+        return to_protocol_object(t, data);
+    case  chain::implementation_ids:
+        return  to_implementation_object(t, data);
+    default:
+        FC_CAPTURE_AND_THROW(deserialize_object_failed, (s)(t));
+    }
+}
 serializable_undo_state::serializable_undo_state(const serializable_undo_state & sta) 
 {
     this->new_ids = sta.new_ids;
@@ -813,15 +951,26 @@ void undo_storage::flush()
 
 bool undo_storage::get_state(const undo_state_id_type& id, undo_state& state)const 
 {
-	auto res=fetch_optional(id);
-	if (!res.valid())
+	string out;
+	if (!read(id, out))
 		return false;
-	state = *res;
-	return true;
+	try
+	{
+		if (out[0] == '{')
+			state = fc::json::from_string(out).as<serializable_undo_state>();
+		else
+			state = unpack_state(out);
+		return true;
+	}
+	catch (const fc::exception& e)
+	{
+		elog("decode undo state ${key} failed: ${e}", ("key", id.str())("e", e.to_detail_string()));
+	}
+	return false;
 }
 undo_state_id_type undo_storage::store_undo_state(const undo_state& b)
 {
-	auto obj = b.get_serializable_undo_state();
+	auto obj = b.get_packed_undo_state();
 	auto id = obj.undo_id();
 	FC_ASSERT(store(id, obj),"store state failed");
 	return id;
@@ -850,6 +999,89 @@ bool undo_storage::store(const undo_state_id_type & _id, const serializable_undo
 	} FC_CAPTURE_AND_RETHROW((_id)(b))
 }
 
+bool undo_storage::store(const undo_state_id_type & _id, const packed_undo_state& b)
+{
+	try {
+		FC_ASSERT(db, "undo_storage closed");
+		auto value = pack_state(b);
+		leveldb::WriteOptions write_options;
+		leveldb::Status sta = db->Put(write_options, _id.str(), leveldb::Slice(value.data(), value.size()));
+		if (!sta.ok())
+		{
+			elog("Put error: ${error}", ("error", (_id.str() + ":" + sta.ToString()).c_str()));
+			FC_ASSERT(false, "Put Data to undo_storage failed");
+			return false;
+		}
+		return true;
+	} FC_CAPTURE_AND_RETHROW((_id))
+}
+
+bool undo_storage::read(const undo_state_id_type& id, string& out)const
+{
+	FC_ASSERT(db, "undo_storage closed");
+	leveldb::ReadOptions read_options;
+	leveldb::Status sta = db->Get(read_options, id.str(), &out);
+	if (!sta.ok())
+	{
+		elog("read error: ${key}", ("key", id.str().c_str()));
+		return false;
+	}
+	return !out.empty();
+}
+
+std::vector<char> undo_storage::pack_state(const packed_undo_state& state)
+{
+	// one version byte followed by the fc::raw encoded state
+	std::vector<char> value(1 + fc::raw::pack_size(state));
+	value[0] = char(GRAPHENE_UNDO_STATE_FORMAT_VERSION);
+	fc::raw::pack(value.data() + 1, uint32_t(value.size() - 1), state);
+	return value;
+}
+
+packed_undo_state undo_storage::unpack_state(const string& value)
+{
+	FC_ASSERT(value.size() > 1 && uint8_t(value[0]) == GRAPHENE_UNDO_STATE_FORMAT_VERSION,
+		"unknown undo state format ${v}", ("v", value.empty() ? 0 : uint8_t(value[0])));
+	return fc::raw::unpack<packed_undo_state>(value.data() + 1, uint32_t(value.size() - 1));
+}
+
+// state keys are hex ids, so this can never collide with one
+static const char* const undo_storage_format_key = "#format_version";
+
+uint32_t undo_storage::migrate_legacy_states()
+{
+	try {
+		FC_ASSERT(db, "undo_storage closed");
+		string format;
+		leveldb::Status found = db->Get(leveldb::ReadOptions(), undo_storage_format_key, &format);
+		if (found.ok() && format.size() == 1 && uint8_t(format[0]) >= GRAPHENE_UNDO_STATE_FORMAT_VERSION)
+			return 0;
+		FC_ASSERT(found.ok() || found.IsNotFound(), "read undo_storage format failed: ${s}", ("s", found.ToString()));
+		leveldb::WriteBatch batch;
+		uint32_t count = 0;
+		std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+		for (it->SeekToFirst(); it->Valid(); it->Next())
+		{
+			auto value = it->value();
+			if (value.size() == 0 || value[0] != '{')
+				continue;
+			undo_state sta(fc::json::from_string(value.ToString()).as<serializable_undo_state>());
+			auto data = pack_state(sta.get_packed_undo_state());
+			batch.Put(it->key(), leveldb::Slice(data.data(), data.size()));
+			++count;
+		}
+		FC_ASSERT(it->status().ok(), "iterate undo_storage failed: ${s}", ("s", it->status().ToString()));
+		// written with the migrated states so a crash midway leaves the marker unset
+		const char version = char(GRAPHENE_UNDO_STATE_FORMAT_VERSION);
+		batch.Put(undo_storage_format_key, leveldb::Slice(&version, 1));
+		leveldb::WriteOptions write_options;
+		write_options.sync = true;
+		leveldb::Status sta = db->Write(write_options, &batch);
+		FC_ASSERT(sta.ok(), "migrate undo_storage failed: ${s}", ("s", sta.ToString()));
+		return count;
+	} FC_CAPTURE_AND_RETHROW()
+}
+
 bool undo_storage::remove(const undo_state_id_type& id)
 {
 	try {
@@ -884,6 +1116,8 @@ optional<serializable_undo_state> undo_storage::fetch_optional(const undo_state_
 			elog("read error: ${key}", ("key", id.str().c_str()));
 			FC_ASSERT(false, "fetch_optional Data from undo_storage failed");
 		}
+		if (!out.empty() && out[0] != '{')
+			return undo_state(unpack_state(out)).get_serializable_undo_state();
 		serializable_undo_state state = fc::json::from_string(out).as<serializable_undo_state>();
 		return state;
 	}
@@ -895,6 +1129,22 @@ optional<serializable_undo_state> undo_storage::fetch_optional(const undo_state_
 	}
 	return optional<serializable_undo_state>();
 }
+optional<packed_undo_state> undo_storage::fetch_packed_optional(const undo_state_id_type& id)const
+{
+	try
+	{
+		string out;
+		if (!read(id, out))
+			return optional<packed_undo_state>();
+		if (out[0] == '{')
+			return undo_state(fc::json::from_string(out).as<serializable_undo_state>()).get_packed_undo_state();
+		return unpack_state(out);
+	}
+	catch (const fc::exception&)
+	{
+	}
+	return optional<packed_undo_state>();
+}
 
 }
 
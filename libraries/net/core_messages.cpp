@@ -46,5 +46,14 @@ namespace graphene { namespace net {
   const core_message_type_enum get_current_connections_request_message::type = core_message_type_enum::get_current_connections_request_message_type;
   const core_message_type_enum get_current_connections_reply_message::type   = core_message_type_enum::get_current_connections_reply_message_type;
 
+  block_id_type block_message::id_of_packed( const message& packed_block_message )
+  {
+    FC_ASSERT( packed_block_message.msg_type == block_message::type );
+    block_id_type id;
+    FC_ASSERT( packed_block_message.data.size() >= sizeof(id) );
+    memcpy( id._hash, packed_block_message.data.data() + packed_block_message.data.size() - sizeof(id), sizeof(id) );
+    return id;
+  }
+
 } } // graphene::net
 
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <graphene/net/config.hpp>
+#include <graphene/net/message.hpp>
 #include <graphene/chain/protocol/block.hpp>
 
 #include <fc/crypto/ripemd160.hpp>
@@ -109,10 +110,16 @@ namespace graphene { namespace net {
       block_message(){}
       block_message(const signed_block& blk )
       :block(blk),block_id(blk.id()){}
+      /** for callers that already know the id, saves hashing the header again */
+      block_message(const signed_block& blk, const block_id_type& id )
+      :block(blk),block_id(id){}
 
       signed_block    block;
       block_id_type   block_id;
 
+      /** reads block_id from the packed message without unpacking the block,
+       *  it is the last field so it sits at the end of the message data */
+      static block_id_type id_of_packed( const message& packed_block_message );
    };
 
   struct item_ids_inventory_message
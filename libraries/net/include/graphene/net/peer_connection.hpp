@@ -68,7 +68,7 @@ namespace graphene { namespace net
       virtual void on_message(peer_connection* originating_peer,
                               const message& received_message) = 0;
       virtual void on_connection_closed(peer_connection* originating_peer) = 0;
-      virtual message get_message_for_item(const item_id& item) = 0;
+      virtual std::shared_ptr<const message> get_message_for_item(const item_id& item) = 0;
     };
 
     class peer_connection;
@@ -123,7 +123,7 @@ namespace graphene { namespace net
           enqueue_time(enqueue_time)
         {}
 
-        virtual message get_message(peer_connection_delegate* node) = 0;
+        virtual std::shared_ptr<const message> get_message(peer_connection_delegate* node) = 0;
         /** returns roughly the number of bytes of memory the message is consuming while
          * it is sitting on the queue
          */
@@ -136,16 +136,16 @@ namespace graphene { namespace net
        */
       struct real_queued_message : queued_message
       {
-        message        message_to_send;
+        std::shared_ptr<message> message_to_send;
         size_t         message_send_time_field_offset;
 
         real_queued_message(message message_to_send,
                             size_t message_send_time_field_offset = (size_t)-1) :
-          message_to_send(std::move(message_to_send)),
+          message_to_send(std::make_shared<message>(std::move(message_to_send))),
           message_send_time_field_offset(message_send_time_field_offset)
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        std::shared_ptr<const message> get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -161,7 +161,7 @@ namespace graphene { namespace net
           item_to_send(std::move(item_to_send))
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        std::shared_ptr<const message> get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
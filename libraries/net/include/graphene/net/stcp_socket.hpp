@@ -50,6 +50,14 @@ class stcp_socket : public virtual fc::iostream
     virtual size_t   writesome( const char* buffer, size_t len );
     virtual size_t   writesome( const std::shared_ptr<const char>& buf, size_t len, size_t offset );
 
+    typedef std::pair<const char*, size_t> write_part;
+    /**
+     *  Encrypts and writes the concatenation of parts, zero padded to a multiple of 16 bytes,
+     *  straight from the callers' buffers instead of first copying them into one padded buffer.
+     *  Returns the number of bytes written including the padding.
+     */
+    size_t           write_gathered( const std::vector<write_part>& parts );
+
     virtual void     flush();
     virtual void     close();
 
@@ -58,6 +66,8 @@ class stcp_socket : public virtual fc::iostream
     fc::sha512       get_shared_secret() const { return _shared_secret; }
   private:
     void do_key_exchange();
+    void encode_to_write_buffer( const char* plaintext, size_t len );
+    void write_buffered();
 
     fc::sha512           _shared_secret;
     fc::ecc::private_key _priv_key;
@@ -68,6 +78,7 @@ class stcp_socket : public virtual fc::iostream
     fc::aes_decoder      _recv_aes;
     std::shared_ptr<char> _read_buffer;
     std::shared_ptr<char> _write_buffer;
+    size_t               _write_buffer_len; // ciphertext waiting in _write_buffer, only used by write_gathered
 #ifndef NDEBUG
     bool _read_buffer_in_use;
     bool _write_buffer_in_use;
@@ -255,15 +255,12 @@ namespace graphene { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
         if( message_to_send.size > MAX_MESSAGE_SIZE )
            elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
-        _sock.write(padded_message.get(), size_with_padding);
+        //the socket pads the message we send to a multiple of 16 bytes, and encrypts the header
+        //and body where they are, so large messages like blocks aren't copied for every peer
+        size_t size_with_padding = _sock.write_gathered({ stcp_socket::write_part((const char*)&message_to_send, sizeof(message_header)),
+                                                          stcp_socket::write_part(message_to_send.data.data(), message_to_send.size) });
         _sock.flush();
         _bytes_sent += size_with_padding;
         _last_message_sent_time = fc::time_point::now();
@@ -38,8 +38,9 @@ namespace graphene { namespace net {
 
 stcp_socket::stcp_socket()
 //:_buf_len(0)
+   : _write_buffer_len(0)
 #ifndef NDEBUG
-   : _read_buffer_in_use(false),
+   , _read_buffer_in_use(false),
      _write_buffer_in_use(false)
 #endif
 {
@@ -126,6 +127,8 @@ bool stcp_socket::eof()const
   return _sock.eof();
 }
 
+static const std::size_t write_buffer_length = 4096;
+
 size_t stcp_socket::writesome( const char* buffer, size_t len )
 { try {
     assert( len > 0 && (len % 16) == 0 );
@@ -141,7 +144,6 @@ size_t stcp_socket::writesome( const char* buffer, size_t len )
     } buffer_in_use_checker(_write_buffer_in_use);
 #endif
 
-    const std::size_t write_buffer_length = 4096;
     if (!_write_buffer)
       _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
     len = std::min<size_t>(write_buffer_length, len);
@@ -163,6 +165,77 @@ size_t stcp_socket::writesome( const std::shared_ptr<const char>& buf, size_t le
   return writesome(buf.get() + offset, len);
 }
 
+void stcp_socket::encode_to_write_buffer( const char* plaintext, size_t len )
+{
+  assert( len % 16 == 0 && len <= write_buffer_length );
+  if( _write_buffer_len + len > write_buffer_length )
+    write_buffered();
+  uint32_t ciphertext_len = _send_aes.encode( plaintext, (uint32_t)len, _write_buffer.get() + _write_buffer_len );
+  assert(ciphertext_len == len);
+  _write_buffer_len += ciphertext_len;
+}
+
+void stcp_socket::write_buffered()
+{
+  if( _write_buffer_len )
+    _sock.write( _write_buffer, _write_buffer_len );
+  _write_buffer_len = 0;
+}
+
+size_t stcp_socket::write_gathered( const std::vector<write_part>& parts )
+{ try {
+#ifndef NDEBUG
+    struct check_buffer_in_use {
+      bool& _buffer_in_use;
+      check_buffer_in_use(bool& buffer_in_use) : _buffer_in_use(buffer_in_use) { assert(!_buffer_in_use); _buffer_in_use = true; }
+      ~check_buffer_in_use() { assert(_buffer_in_use); _buffer_in_use = false; }
+    } buffer_in_use_checker(_write_buffer_in_use);
+#endif
+    if (!_write_buffer)
+      _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
+    _write_buffer_len = 0;
+
+    // aes works on 16 byte blocks, so only the bytes of a block that straddles two parts
+    // (and the padded last block) get staged here, everything else is encoded in place
+    char   straddling_block[16];
+    size_t straddling_len = 0;
+    size_t total_len = 0;
+    for( const write_part& part : parts )
+    {
+      const char* data = part.first;
+      size_t remaining = part.second;
+      total_len += remaining;
+      if( straddling_len )
+      {
+        size_t fill = std::min<size_t>(sizeof(straddling_block) - straddling_len, remaining);
+        memcpy(straddling_block + straddling_len, data, fill);
+        straddling_len += fill;
+        data += fill;
+        remaining -= fill;
+        if( straddling_len < sizeof(straddling_block) )
+          continue;
+        encode_to_write_buffer(straddling_block, sizeof(straddling_block));
+        straddling_len = 0;
+      }
+      while( remaining >= sizeof(straddling_block) )
+      {
+        size_t chunk = std::min<size_t>(write_buffer_length, remaining & ~(size_t)15);
+        encode_to_write_buffer(data, chunk);
+        data += chunk;
+        remaining -= chunk;
+      }
+      memcpy(straddling_block, data, remaining);
+      straddling_len = remaining;
+    }
+    if( straddling_len )
+    {
+      memset(straddling_block + straddling_len, 0, sizeof(straddling_block) - straddling_len);
+      encode_to_write_buffer(straddling_block, sizeof(straddling_block));
+    }
+    write_buffered();
+    return 16 * ((total_len + 15) / 16);
+} FC_RETHROW_EXCEPTIONS( warn, "", ("parts",parts.size()) ) }
+
 void stcp_socket::flush()
 {
   _sock.flush();
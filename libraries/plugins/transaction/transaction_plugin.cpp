@@ -33,6 +33,7 @@
 
 #include <fc/smart_ref_impl.hpp>
 #include <fc/thread/thread.hpp>
+#include <leveldb/write_batch.h>
 #include <iostream>
 namespace graphene { namespace transaction {
 
@@ -60,8 +61,10 @@ class transaction_plugin_impl
 	  transaction_plugin& _self;
       flat_set<address> _tracked_addresses;
       bool _partial_operations = false;
+      /** fsync the transactions db after every block instead of leaving the flush to LevelDB */
+      bool _sync_commit = false;
       /** add one history record, then check and remove the earliest history record */
-      void add_transaction_history( const signed_transaction& trx );
+      void add_transaction_history( const signed_transaction& trx, const transaction_id_type& trx_id, uint32_t block_num );
 
 };
 
@@ -71,34 +74,50 @@ transaction_plugin_impl::~transaction_plugin_impl(){}
 void transaction_plugin_impl::erase_transaction_records(const vector<signed_transaction>& trxs)
 {
 	const auto& db = database();
-	for (auto tx : trxs)
-	{
-		leveldb::WriteOptions write_options;
-		db.get_levelDB()->Delete(write_options, tx.id().str());
-	}
+	if (trxs.empty())
+		return;
+	leveldb::WriteBatch batch;
+	for (const auto& tx : trxs)
+		batch.Delete(tx.id().str());
+	leveldb::WriteOptions write_options;
+	write_options.sync = _sync_commit;
+	leveldb::Status sta = db.get_levelDB()->Write(write_options, &batch);
+	if (!sta.ok())
+		elog("Delete error: ${error}", ("error", sta.ToString().c_str()));
 }
 
 void transaction_plugin_impl::update_transaction_record( const signed_block& b )
 {
    graphene::chain::database& db = database();
-   for (auto trx : b.transactions) {
-	   leveldb::WriteOptions write_options;
+   if (b.transactions.empty())
+	   return;
+   const uint32_t block_num = b.block_num();
+   vector<transaction_id_type> trx_ids;
+   trx_ids.reserve(b.transactions.size());
+   leveldb::WriteBatch batch;
+   for (const auto& trx : b.transactions) {
 	   trx_object obj;
 	   obj.trx = trx;
 	   obj.trx_id = trx.id();
-	   obj.block_num = b.block_num();
-	   leveldb::Status sta = db.get_levelDB()->Put(write_options, obj.trx_id.str(), fc::json::to_string(obj));
-	   if (!sta.ok())
-	   {
-		   elog("Put error: ${error}", ("error", (trx.id().str() + ":" + sta.ToString()).c_str()));
-		   FC_ASSERT(false, "Put Data to transaction failed");
-		   return;
-	   }
-	   add_transaction_history(trx);
-   }   
+	   obj.block_num = block_num;
+	   auto value = pack_trx_record(obj);
+	   batch.Put(obj.trx_id.str(), leveldb::Slice(value.data(), value.size()));
+	   trx_ids.push_back(obj.trx_id);
+   }
+   leveldb::WriteOptions write_options;
+   write_options.sync = _sync_commit;
+   leveldb::Status sta = db.get_levelDB()->Write(write_options, &batch);
+   if (!sta.ok())
+   {
+	   elog("Put error: ${error}", ("error", (fc::to_string(block_num) + ":" + sta.ToString()).c_str()));
+	   FC_ASSERT(false, "Put Data to transaction failed");
+	   return;
+   }
+   for (size_t i = 0; i < trx_ids.size(); ++i)
+	   add_transaction_history(b.transactions[i], trx_ids[i], block_num);
 }
 
-void transaction_plugin_impl::add_transaction_history(const signed_transaction& trx)
+void transaction_plugin_impl::add_transaction_history(const signed_transaction& trx, const transaction_id_type& trx_id, uint32_t block_num)
 {
 	graphene::chain::database& db = database();
 	if (_tracked_addresses.size() == 0)
@@ -110,7 +129,7 @@ void transaction_plugin_impl::add_transaction_history(const signed_transaction&
 	{
 		addresses.insert(address(sig));
 	}
-	auto res=db.get_contract_invoke_result(trx.id());
+	auto res=db.get_contract_invoke_result(trx_id);
 	for (const auto& it : res)
 	{
 		for (const auto& deposit_it : it.deposit_to_address)
@@ -141,10 +160,6 @@ void transaction_plugin_impl::add_transaction_history(const signed_transaction&
 		}
 		
 	}
-	auto trx_op = db.fetch_trx(trx.id());
-	if (!trx_op.valid())
-		return;
-
 	for (auto addr : addresses)
 	{
 		auto iter = _tracked_addresses.find(addr);
@@ -152,8 +167,8 @@ void transaction_plugin_impl::add_transaction_history(const signed_transaction&
 			continue;
 		db.create<history_transaction_object>([&](history_transaction_object& obj) {
 			obj.addr = addr;
-			obj.trx_id = trx_op->trx_id;
-			obj.block_num = trx_op->block_num;
+			obj.trx_id = trx_id;
+			obj.block_num = block_num;
 		});
 	}
 }
@@ -180,7 +195,9 @@ void transaction_plugin::plugin_set_program_options(
    )
 {
    cli.add_options()
-         ("track-address", boost::program_options::value<std::vector<std::string>>()->composing()->multitoken(), "address to track history for (may specify multiple times)");
+         ("track-address", boost::program_options::value<std::vector<std::string>>()->composing()->multitoken(), "address to track history for (may specify multiple times)")
+         ("transaction-record-sync", boost::program_options::value<bool>()->default_value(false), "Sync the transaction records of every block to disk before continuing (false lets LevelDB flush asynchronously)")
+         ;
    cfg.add(cli);
 }
 
@@ -191,6 +208,9 @@ void transaction_plugin::plugin_initialize(const boost::program_options::variabl
    database().add_index <primary_index<trx_index         > >();
    database().add_index <primary_index<history_transaction_index > >();
    LOAD_VALUE_SET(options, "track-address", my->_tracked_addresses, graphene::chain::address);
+   if (options.count("transaction-record-sync")) {
+       my->_sync_commit = options["transaction-record-sync"].as<bool>();
+   }
 }
 
 void transaction_plugin::plugin_startup()
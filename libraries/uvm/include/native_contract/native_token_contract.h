@@ -4,6 +4,13 @@
 
 namespace uvm {
 	namespace contract {
+		// transfer arguments, parsed once from "toAddress,amount"
+		struct token_transfer_args
+		{
+			std::string to_address;
+			int64_t amount = 0;
+		};
+
 		// this is native contract for token
 		class token_native_contract : public uvm::contract::abstract_native_contract_impl
 		{
@@ -31,6 +38,9 @@ namespace uvm {
 			int64_t get_storage_supply();
 			int64_t get_storage_precision();
 			int64_t get_balance_of_user(const std::string& owner_addr) const;
+			// a zero balance clears the user's entry
+			void set_balance_of_user(const std::string& owner_addr, int64_t balance);
+			token_transfer_args parse_transfer_args(const std::string& api_arg) const;
 			cbor::CborMapValue get_allowed_of_user(const std::string& from_addr) const;
 			std::string get_from_address();
 
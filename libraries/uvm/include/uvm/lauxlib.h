@@ -113,6 +113,7 @@ LUALIB_API int(luaL_loadbufferx_with_check)(lua_State *L, const char *buff, size
 LUALIB_API int (luaL_loadstring)(lua_State *L, const char *s);
 
 LUALIB_API lua_State *(luaL_newstate)(void);
+LUALIB_API lua_State *(luaL_newstate_in_gc_state)(vmgc::GcState *gc_state);
 
 LUALIB_API lua_Integer(luaL_len) (lua_State *L, int idx);
 
@@ -404,15 +404,26 @@ namespace uvm_types {
 	{
 		const static vmgc::gc_type type = LUA_TLNGSTR;
 		int tt_ = LUA_TLNGSTR;
-		std::string value;
+		std::string value; // final once the string is handed out, the cached hashes below rely on it
 		lu_byte extra = 0;
+		lu_byte interned = 0; // the only GcString with these contents in the state's string pool
+		mutable lu_byte hash_cached = 0;
+		mutable unsigned int cached_hash = 0;
+		// identity of the string as a table key, worked out by ltable.cpp on first use as one
+		mutable lu_byte table_key_kind = 0;
+		mutable unsigned int table_key_hash = 0;
+		mutable lua_Integer table_key_id = 0;
 
 		inline GcString() : tt_(LUA_TLNGSTR){ }
 
 		virtual ~GcString() {}
 
 		inline unsigned int hash() const {
-			return luaS_hash(value.data(), value.size(), 1);
+			if (!hash_cached) {
+				cached_hash = luaS_hash(value.data(), value.size(), 1);
+				hash_cached = 1;
+			}
+			return cached_hash;
 		}
 	};
 	struct GcUserdata : vmgc::GcObject
@@ -476,10 +487,24 @@ namespace uvm_types {
 	struct GcTable : vmgc::GcObject
 	{
 		typedef TValue GcTableItemType;
+		// entry of the hash part. keys are identified by their string form, so 5 and "5" are the same key
+		// and the key inserted first is the one kept. key_kind/key_id hold that identity (see ltable.cpp)
+		struct Node
+		{
+			TValue key;
+			GcTableItemType value;
+			unsigned int key_hash;
+			lu_byte key_kind;
+			lua_Integer key_id; // the integer, the lightuserdata pointer or the string length
+		};
 		const static vmgc::gc_type type = LUA_TTABLE;
 		int tt_ = LUA_TTABLE;
-		std::map<TValue, GcTableItemType, table_sort_comparator> entries; // must use map, not unordered_map
-		std::map<std::string, TValue> keys;
+		std::vector<Node> nodes; // hash part in insertion order, entries are never removed
+		std::vector<unsigned int> node_slots; // open addressing index into nodes (position + 1, 0 for free), size is 0 or a power of 2
+		// nodes positions in table_sort_comparator order, so next() stays deterministic whatever the hashes are.
+		// sorted lazily, nodes from sorted_nodes.size() on are not in it yet
+		std::vector<unsigned int> sorted_nodes;
+		size_t last_next_pos = 0; // position in sorted_nodes of the last key next() returned
 		std::vector<GcTableItemType> array;
 		GcTable* metatable;
 		lu_byte flags; // flag to mask meta methods
@@ -504,6 +529,7 @@ namespace uvm_types {
 		std::vector<int> lineinfos;  /* map from opcodes to source lines (debug information) */
 		std::vector<LocVar> locvars;  /* information about local variables (debug information) */
 		std::vector<Upvaldesc> upvalues;  /* upvalue information */
+		std::vector<lu_byte> straight_runs;  /* per pc, length of the straight-line run starting there (see lvm.cpp) */
 		struct GcLClosure *cache;  /* last-created closure with this prototype */
 		GcString  *source;  /* used for debug information */
 
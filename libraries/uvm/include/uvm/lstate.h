@@ -217,6 +217,7 @@ struct lua_State : vmgc::GcObject {
 	std::map<std::string, std::list<uint32_t> >* breakpoints; // contract_address => list of line_number
 	std::stack<contract_info_stack_entry>* using_contract_id_stack;
 	bool next_delegate_call_flag = false;
+	bool disable_straight_runs = false; // step every instruction on its own instead of whole straight-line runs (see lvm.cpp), the result is the same
 	OpCode call_op_msg;
 	uint32_t ci_depth;
     
@@ -269,6 +270,11 @@ LUAI_FUNC CallInfo *luaE_extendCI(lua_State *L);
 LUAI_FUNC void luaE_freeCI(lua_State *L);
 LUAI_FUNC void luaE_shrinkCI(lua_State *L);
 
+/* builds the state in the arena of gc_state, which must be new or gc_reset, and leaves it owned by the caller */
+LUA_API lua_State *lua_newstate_in_gc_state(lua_Alloc f, void *ud, vmgc::GcState *gc_state);
+/* closes L like lua_close but hands back its gc state reset instead of deleting it */
+LUA_API vmgc::GcState *lua_close_keep_gc_state(lua_State *L);
+
 
 #endif
 
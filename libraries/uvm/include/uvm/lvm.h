@@ -100,10 +100,16 @@ namespace uvm {
 			int64_t insts_limit;
 			bool has_insts_limit;
 			bool use_last_return;
+			bool use_step_log;
+			bool use_straight_runs; // see executeStraightRun
 			CallInfo *ci;
 			uvm_types::GcLClosure *cl;
 			TValue *k;
 			StkId base;
+			// run lengths of cl's proto and its first instruction, straight_runs is nullptr when runs are not taken
+			const lu_byte *straight_runs;
+			const Instruction *straight_runs_code;
+			ptrdiff_t straight_runs_count;
 			std::stack<contract_info_stack_entry> using_contract_id_stack;
 
 			void step_out(lua_State *L);
@@ -112,6 +118,10 @@ namespace uvm {
 			// execute to next ci called, return whether has next ci to execute
 			bool executeToNextCi(lua_State* L);
 			bool executeToNextOp(lua_State* L);
+			// execute the straight-line run of at least two instructions starting at pc, return false to take the single step path
+			bool executeStraightRun(lua_State* L, int left);
+			// called whenever cl changes
+			void load_straight_runs();
 			void enter_newframe(lua_State* L);
 			void prepare_newframe(lua_State* L);
 
@@ -447,6 +447,9 @@ jsondiff::JsonValue uvm_storage_value_to_json(UvmStorageValue value);
 
 UvmStorageValue cbor_to_uvm_storage_value(lua_State *L, cbor::CborObject* cbor_value);
 cbor::CborObjectP uvm_storage_value_to_cbor(UvmStorageValue value);
+// same result as uvm_storage_value_to_cbor(cbor_to_uvm_storage_value(L, cbor_value)) without a lua state,
+// returns nullptr for arrays, maps and other values that need one
+cbor::CborObjectP uvm_storage_scalar_cbor(cbor::CborObject* cbor_value);
 
 typedef std::unordered_map<std::string, UvmStorageChangeItem> ContractChangesMap;
 
@@ -13,6 +13,10 @@
 #include <string>
 #include <unordered_map>
 #include <set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
 
 #include <uvm/lua.h>
 #include <uvm/lhashmap.h>
@@ -41,6 +45,9 @@
 
 #define LUA_STATE_DEBUGGER_INFO	"lua_state_debugger_info"
 
+// idle lua states UvmStatePool keeps for each of use_contract true/false
+#define UVM_STATE_POOL_MAX_IDLE_STATES 4
+
 
 /**
 * in lua_State scope, share some values, after close lua_State, you must release these shared values
@@ -93,6 +100,39 @@ namespace uvm
 				int64_t* gas_ref_or_new();
 			};
 
+            /**
+            * idle lua states reused by UvmStateScope instead of building a new state and gc arena every time.
+            * a released state is torn down like close_lua_state and its arena is wiped on the caller, a state is
+            * built again in the arena on the builder thread, so acquire hands out a state that is the same as
+            * create_lua_state(use_contract) and the rebuild stays off the apply path
+            */
+            class UvmStatePool
+            {
+            private:
+                std::mutex _mutex;
+                std::condition_variable _changed;
+                // all indexed by use_contract
+                std::vector<lua_State*> _idle_states[2];
+                std::vector<vmgc::GcState*> _pending_gc_states[2]; // wiped arenas waiting for the builder
+                size_t _building[2];
+                size_t _max_idle_states;
+                std::unique_ptr<std::thread> _builder;
+                bool _stopping;
+
+                void build_pending_states();
+                size_t pooled_count(bool use_contract) const; // call with _mutex held
+            public:
+                UvmStatePool(size_t max_idle_states = UVM_STATE_POOL_MAX_IDLE_STATES);
+                ~UvmStatePool();
+
+                lua_State *acquire(bool use_contract);
+                void release(lua_State *L, bool use_contract);
+                size_t idle_count(bool use_contract); // including the states still being rebuilt
+                void clear();
+
+                static UvmStatePool &instance();
+            };
+
             class UvmStateScope
             {
             private:
@@ -302,11 +342,14 @@ namespace uvm
 
 			};
 
-            lua_State *create_lua_state(bool use_contract = true);
+            // gc_state: empty arena to build the state in, the state gets a new one when nullptr
+            lua_State *create_lua_state(bool use_contract = true, vmgc::GcState *gc_state = nullptr);
 
             bool commit_storage_changes(lua_State *L);
 
             void close_lua_state(lua_State *L);
+            // frees what L's state values and outside object pools own, before L is closed
+            void release_lua_state_resources(lua_State *L);
 
             /**
             * share some values in L
@@ -0,0 +1,39 @@
+#pragma once
+#include <simplechain/simplechain.h>
+#include <fc/variant.hpp>
+
+namespace simplechain {
+
+	// one scripted contract invoke
+	struct benchmark_invoke {
+		std::string api;
+		std::string arg;
+		asset_id_t deposit_asset_id = 0;
+		share_type deposit_amount = 0;
+	};
+
+	// a contract and the invokes run against it on a fresh chain.
+	// setup invokes prepare the contract state and are not measured
+	struct benchmark_workload {
+		std::string name;
+		std::string native_contract_key; // empty for lua contracts
+		std::string contract_filepath; // gpc file of the lua contract
+		gas_count_type gas_limit = 50000;
+		std::vector<benchmark_invoke> setup;
+		std::vector<benchmark_invoke> invokes;
+	};
+
+	// native token/exchange/uniswap contracts and the test lua contracts,
+	// each measured over invokes_count invokes
+	std::vector<benchmark_workload> default_benchmark_workloads(const std::string& contracts_dir, size_t invokes_count);
+
+	// runs the workloads and returns their report: per workload the invokes count, failures,
+	// instructions, gas, vmgc allocations, execution and storage commit time (microseconds)
+	// and the derived per second and per invoke rates.
+	// the workloads use fixed callers and tx times, so everything but the timings is deterministic
+	fc::variant run_contract_benchmark(const std::vector<benchmark_workload>& workloads);
+
+	// times count_storage_gas over invokes_count native token transfers against converting every
+	// storage value through a lua state first, and reports whether both count the same gas
+	fc::variant run_storage_gas_benchmark(size_t invokes_count);
+}
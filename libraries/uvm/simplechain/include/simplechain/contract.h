@@ -57,6 +57,14 @@ namespace simplechain {
 
 	class blockchain;
 
+	// vm counters of one contract execution, not part of the chain state
+	struct contract_exec_stats
+	{
+		int64_t instructions_executed = 0;
+		uint64_t gc_malloc_count = 0;
+		uint64_t gc_free_count = 0;
+	};
+
 	struct contract_invoke_result : public evaluate_result
 	{
 		std::string api_result;
@@ -71,6 +79,7 @@ namespace simplechain {
 		std::string error;
 		gas_count_type gas_used = 0;
 		address invoker;
+		contract_exec_stats exec_stats;
 		void reset();
 		void set_failed();
 
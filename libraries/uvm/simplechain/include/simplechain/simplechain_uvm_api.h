@@ -173,6 +173,7 @@ namespace simplechain {
 		virtual bool use_cbor_diff(lua_State* L) const override;
 
 		virtual std::string pubkey_to_address_string(const fc::ecc::public_key& pub) const override;
+		virtual std::string get_signature_address(lua_State *L, const char * hash, const char * v, const char * r, const char * s) override;
 
 		virtual bool use_gas_log(lua_State* L) const override;
 		virtual bool use_step_log(lua_State* L) const override;
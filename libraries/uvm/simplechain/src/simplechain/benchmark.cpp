@@ -0,0 +1,261 @@
+#include <simplechain/benchmark.h>
+#include <simplechain/native_contract.h>
+#include <fc/variant_object.hpp>
+#include <cbor_diff/cbor_diff.h>
+#include <uvm/uvm_lib.h>
+#include <uvm/uvm_lutil.h>
+
+namespace simplechain {
+	using namespace std;
+
+	// fixed times keep contract addresses and tx hashes the same on every run
+	static const fc::time_point_sec benchmark_start_time(1536033055);
+	static const asset_id_t benchmark_second_asset_id = 1;
+	static const std::string benchmark_second_asset_symbol = "BENCH";
+
+	static std::string benchmark_address(const std::string& name) {
+		return std::string(SIMPLECHAIN_ADDRESS_PREFIX) + name;
+	}
+
+	static benchmark_invoke make_invoke(const std::string& api, const std::string& arg,
+		asset_id_t deposit_asset_id = 0, share_type deposit_amount = 0) {
+		benchmark_invoke invoke;
+		invoke.api = api;
+		invoke.arg = arg;
+		invoke.deposit_asset_id = deposit_asset_id;
+		invoke.deposit_amount = deposit_amount;
+		return invoke;
+	}
+
+	// transfers spread over receivers so the storage keeps growing like on a real chain
+	static const size_t benchmark_receivers_count = 100;
+
+	static benchmark_workload native_token_transfer_workload(size_t invokes_count) {
+		benchmark_workload workload;
+		workload.name = "native_token_transfer";
+		workload.native_contract_key = "token";
+		workload.setup.push_back(make_invoke("init_token", "test,TEST,100000000000,10"));
+		for (size_t i = 0; i < invokes_count; i++) {
+			const auto& receiver = benchmark_address("receiver" + std::to_string(i % benchmark_receivers_count));
+			workload.invokes.push_back(make_invoke("transfer", receiver + "," + std::to_string(i % 1000 + 1)));
+		}
+		return workload;
+	}
+
+	std::vector<benchmark_workload> default_benchmark_workloads(const std::string& contracts_dir, size_t invokes_count) {
+		std::vector<benchmark_workload> workloads;
+		const auto& caller_addr = benchmark_address("caller1");
+		workloads.push_back(native_token_transfer_workload(invokes_count));
+		{
+			benchmark_workload workload;
+			workload.name = "native_exchange_deposit";
+			workload.native_contract_key = "exchange";
+			workload.setup.push_back(make_invoke("init_config", caller_addr));
+			for (size_t i = 0; i < invokes_count; i++) {
+				workload.invokes.push_back(make_invoke("on_deposit_asset", "", 0, i % 1000 + 1));
+			}
+			workloads.push_back(workload);
+		}
+		{
+			benchmark_workload workload;
+			workload.name = "native_uniswap_deposit";
+			workload.native_contract_key = "uniswap";
+			workload.setup.push_back(make_invoke("init_config", std::string(SIMPLECHAIN_CORE_ASSET_SYMBOL) + "," + benchmark_second_asset_symbol + ",1,1,0.003,bench,BLP"));
+			for (size_t i = 0; i < invokes_count; i++) {
+				auto asset_id = (i % 2 == 0) ? 0 : benchmark_second_asset_id;
+				workload.invokes.push_back(make_invoke("on_deposit_asset", "", asset_id, i % 1000 + 1));
+			}
+			workloads.push_back(workload);
+		}
+		{
+			benchmark_workload workload;
+			workload.name = "lua_token_transfer";
+			workload.contract_filepath = contracts_dir + "/token.gpc";
+			workload.setup.push_back(make_invoke("init_token", "test,TEST,100000000000,100"));
+			for (size_t i = 0; i < invokes_count; i++) {
+				const auto& receiver = benchmark_address("receiver" + std::to_string(i % benchmark_receivers_count));
+				workload.invokes.push_back(make_invoke("transfer", receiver + "," + std::to_string(i % 1000 + 1)));
+			}
+			workloads.push_back(workload);
+		}
+		{
+			// every invoke builds and dumps 10000 tables, so it runs fewer times
+			benchmark_workload workload;
+			workload.name = "lua_many_objects";
+			workload.contract_filepath = contracts_dir + "/test_many_objects.lua.gpc";
+			workload.gas_limit = 100000000;
+			size_t count = std::max<size_t>(1, invokes_count / 100);
+			for (size_t i = 0; i < count; i++) {
+				workload.invokes.push_back(make_invoke("hello", std::to_string(i)));
+			}
+			workloads.push_back(workload);
+		}
+		return workloads;
+	}
+
+	static std::shared_ptr<transaction> make_benchmark_tx(const operation& op, uint32_t seq) {
+		auto tx = std::make_shared<transaction>();
+		tx->operations.push_back(op);
+		tx->tx_time = benchmark_start_time + seq;
+		return tx;
+	}
+
+	static contract_invoke_operation make_invoke_op(const benchmark_workload& workload, const std::string& caller_addr,
+		const std::string& contract_addr, const benchmark_invoke& invoke) {
+		fc::variants args;
+		args.push_back(fc::variant(invoke.arg));
+		auto op = operations_helper::invoke_contract(caller_addr, contract_addr, invoke.api, args,
+			workload.gas_limit, 10, invoke.deposit_asset_id, invoke.deposit_amount);
+		op.op_time = benchmark_start_time;
+		return op;
+	}
+
+	// deploys the workload contract on a fresh chain and runs the setup invokes, returns the contract address
+	static std::string setup_workload(std::shared_ptr<blockchain> chain, const benchmark_workload& workload, uint32_t& seq) {
+		const auto& caller_addr = benchmark_address("caller1");
+
+		asset second_asset;
+		second_asset.asset_id = benchmark_second_asset_id;
+		second_asset.symbol = benchmark_second_asset_symbol;
+		second_asset.precision = SIMPLECHAIN_CORE_ASSET_PRECISION;
+		chain->add_asset(second_asset);
+		chain->apply_transaction(make_benchmark_tx(operations_helper::mint(caller_addr, 0, 1000000000000L), seq++));
+		chain->apply_transaction(make_benchmark_tx(operations_helper::mint(caller_addr, benchmark_second_asset_id, 1000000000000L), seq++));
+
+		std::string contract_addr;
+		if (!workload.native_contract_key.empty()) {
+			auto op = operations_helper::create_native_contract(caller_addr, workload.native_contract_key);
+			op.op_time = benchmark_start_time;
+			contract_addr = op.calculate_contract_id();
+			chain->apply_transaction(make_benchmark_tx(op, seq++));
+		}
+		else {
+			auto op = operations_helper::create_contract_from_file(caller_addr, workload.contract_filepath, workload.gas_limit);
+			op.op_time = benchmark_start_time;
+			contract_addr = op.calculate_contract_id();
+			chain->apply_transaction(make_benchmark_tx(op, seq++));
+		}
+		FC_ASSERT(chain->get_contract_by_address(contract_addr), "benchmark contract ${name} not created", ("name", workload.name));
+		for (const auto& invoke : workload.setup) {
+			chain->apply_transaction(make_benchmark_tx(make_invoke_op(workload, caller_addr, contract_addr, invoke), seq++));
+		}
+		return contract_addr;
+	}
+
+	static fc::mutable_variant_object run_workload(const benchmark_workload& workload) {
+		auto chain = std::make_shared<simplechain::blockchain>();
+		const auto& caller_addr = benchmark_address("caller1");
+		uint32_t seq = 0;
+		const auto& contract_addr = setup_workload(chain, workload, seq);
+
+		uint64_t failed_count = 0;
+		int64_t instructions = 0;
+		uint64_t gas = 0;
+		uint64_t gc_mallocs = 0;
+		uint64_t gc_frees = 0;
+		int64_t exec_us = 0;
+		int64_t commit_us = 0;
+		for (const auto& invoke : workload.invokes) {
+			auto tx = make_benchmark_tx(make_invoke_op(workload, caller_addr, contract_addr, invoke), seq++);
+			auto exec_start = fc::time_point::now();
+			auto result = std::static_pointer_cast<contract_invoke_result>(chain->evaluate_transaction(tx));
+			auto commit_start = fc::time_point::now();
+			result->apply_pendings(chain.get(), tx->tx_hash());
+			auto commit_end = fc::time_point::now();
+
+			exec_us += (commit_start - exec_start).count();
+			commit_us += (commit_end - commit_start).count();
+			if (!result->exec_succeed)
+				failed_count++;
+			instructions += result->exec_stats.instructions_executed;
+			gas += result->gas_used;
+			gc_mallocs += result->exec_stats.gc_malloc_count;
+			gc_frees += result->exec_stats.gc_free_count;
+		}
+
+		auto invokes_count = workload.invokes.size();
+		fc::mutable_variant_object report;
+		report["name"] = workload.name;
+		report["contract"] = workload.native_contract_key.empty() ? workload.contract_filepath : workload.native_contract_key;
+		report["invokes"] = invokes_count;
+		report["failed"] = failed_count;
+		report["instructions"] = instructions;
+		report["gas"] = gas;
+		report["gc_mallocs"] = gc_mallocs;
+		report["gc_frees"] = gc_frees;
+		report["exec_us"] = exec_us;
+		report["commit_us"] = commit_us;
+		report["instructions_per_second"] = exec_us > 0 ? (uint64_t)(instructions * 1000000.0 / exec_us) : 0;
+		report["gas_per_second"] = exec_us > 0 ? (uint64_t)(gas * 1000000.0 / exec_us) : 0;
+		report["gc_mallocs_per_invoke"] = invokes_count > 0 ? gc_mallocs / invokes_count : 0;
+		report["commit_us_per_invoke"] = invokes_count > 0 ? commit_us / (int64_t) invokes_count : 0;
+		return report;
+	}
+
+	fc::variant run_contract_benchmark(const std::vector<benchmark_workload>& workloads) {
+		fc::variants reports;
+		for (const auto& workload : workloads) {
+			reports.push_back(run_workload(workload));
+		}
+		fc::mutable_variant_object result;
+		result["workloads"] = reports;
+		return result;
+	}
+
+	// storage gas as counted before scalars skipped the lua state: every value goes through a lua storage value
+	static int64_t count_storage_gas_through_lua_state(const contract_invoke_result& result) {
+		cbor_diff::CborDiff differ;
+		int64_t storage_gas = 0;
+		uvm::lua::lib::UvmStateScope scope;
+		for (const auto& contract_changes : result.storage_changes) {
+			cbor::CborMapValue nested_changes;
+			for (const auto& change : contract_changes.second) {
+				auto cbor_storage_before = uvm_storage_value_to_cbor(StorageDataType::create_lua_storage_from_storage_data(scope.L(), change.second.before));
+				auto cbor_storage_after = uvm_storage_value_to_cbor(StorageDataType::create_lua_storage_from_storage_data(scope.L(), change.second.after));
+				auto change_cbor_diff = *(differ.diff(cbor_storage_before, cbor_storage_after));
+				nested_changes[change.first] = std::make_shared<cbor::CborObject>(change_cbor_diff.value());
+			}
+			auto nested_changes_cbor = cbor::CborObject::create_map(nested_changes);
+			const auto& changes_parsed_to_array = uvm::util::nested_cbor_object_to_array(nested_changes_cbor.get());
+			storage_gas += cbor_diff::cbor_encode(changes_parsed_to_array).size() * 10;
+		}
+		return storage_gas;
+	}
+
+	fc::variant run_storage_gas_benchmark(size_t invokes_count) {
+		auto chain = std::make_shared<simplechain::blockchain>();
+		const auto& workload = native_token_transfer_workload(invokes_count);
+		const auto& caller_addr = benchmark_address("caller1");
+		uint32_t seq = 0;
+		const auto& contract_addr = setup_workload(chain, workload, seq);
+
+		std::vector<std::shared_ptr<contract_invoke_result>> results;
+		for (const auto& invoke : workload.invokes) {
+			auto tx = make_benchmark_tx(make_invoke_op(workload, caller_addr, contract_addr, invoke), seq++);
+			auto result = std::static_pointer_cast<contract_invoke_result>(chain->evaluate_transaction(tx));
+			result->apply_pendings(chain.get(), tx->tx_hash());
+			results.push_back(result);
+		}
+
+		int64_t direct_gas = 0;
+		auto direct_start = fc::time_point::now();
+		for (const auto& result : results) {
+			direct_gas += result->count_storage_gas();
+		}
+		auto lua_state_start = fc::time_point::now();
+		int64_t lua_state_gas = 0;
+		for (const auto& result : results) {
+			lua_state_gas += count_storage_gas_through_lua_state(*result);
+		}
+		auto lua_state_end = fc::time_point::now();
+
+		fc::mutable_variant_object report;
+		report["name"] = workload.name;
+		report["invokes"] = results.size();
+		report["storage_gas"] = direct_gas;
+		report["same_gas"] = direct_gas == lua_state_gas;
+		report["direct_us"] = (lua_state_start - direct_start).count();
+		report["lua_state_us"] = (lua_state_end - lua_state_start).count();
+		return report;
+	}
+}
@@ -73,6 +73,7 @@ namespace simplechain {
 		events.clear();
 		new_contracts.clear();
 		exec_succeed = true;
+		exec_stats = contract_exec_stats();
 	}
 
 	void contract_invoke_result::set_failed()
@@ -161,16 +162,28 @@ namespace simplechain {
 		chain->set_tx_receipt(tx_id, *tx_receipt);
 	}
 
+	// the storage value as the lua vm sees it, scalars (all native token storages) skip the lua state
+	static cbor::CborObjectP storage_data_to_vm_cbor(std::shared_ptr<uvm::lua::lib::UvmStateScope>& scope, const StorageDataType& storage)
+	{
+		auto cbor_value = cbor_diff::cbor_decode(storage.storage_data);
+		auto scalar = uvm_storage_scalar_cbor(cbor_value.get());
+		if (scalar)
+			return scalar;
+		if (!scope)
+			scope = std::make_shared<uvm::lua::lib::UvmStateScope>();
+		return uvm_storage_value_to_cbor(cbor_to_uvm_storage_value(scope->L(), cbor_value.get()));
+	}
+
 	int64_t contract_invoke_result::count_storage_gas() const {
 		cbor_diff::CborDiff differ;
 		int64_t storage_gas = 0;
-		uvm::lua::lib::UvmStateScope scope;
+		std::shared_ptr<uvm::lua::lib::UvmStateScope> scope; // only created for table values
 		for (auto all_con_chg_iter = storage_changes.begin(); all_con_chg_iter != storage_changes.end(); ++all_con_chg_iter)
 		{
 			// commit change to evaluator
 			contract_storage_changes_type contract_storage_change;
 			std::string contract_id = all_con_chg_iter->first;
-			auto contract_change = all_con_chg_iter->second;
+			const auto& contract_change = all_con_chg_iter->second;
 			cbor::CborMapValue nested_changes;
 			jsondiff::JsonObject json_nested_changes;
 
@@ -181,10 +194,10 @@ namespace simplechain {
 				StorageDataChangeType storage_change;
 				// storage_op from before and after to diff
 				auto storage_after = con_chg_iter->second.after;
-				auto cbor_storage_before = uvm_storage_value_to_cbor(StorageDataType::create_lua_storage_from_storage_data(scope.L(), con_chg_iter->second.before));
-				auto cbor_storage_after = uvm_storage_value_to_cbor(StorageDataType::create_lua_storage_from_storage_data(scope.L(), con_chg_iter->second.after));
-				con_chg_iter->second.cbor_diff = *(differ.diff(cbor_storage_before, cbor_storage_after));
-				auto cbor_diff_value = std::make_shared<cbor::CborObject>(con_chg_iter->second.cbor_diff.value());
+				auto cbor_storage_before = storage_data_to_vm_cbor(scope, con_chg_iter->second.before);
+				auto cbor_storage_after = storage_data_to_vm_cbor(scope, con_chg_iter->second.after);
+				auto change_cbor_diff = *(differ.diff(cbor_storage_before, cbor_storage_after));
+				auto cbor_diff_value = std::make_shared<cbor::CborObject>(change_cbor_diff.value());
 				const auto& cbor_diff_chars = cbor_diff::cbor_encode(cbor_diff_value);
 				storage_change.storage_diff.storage_data = cbor_diff_chars;
 				storage_change.after = storage_after;
@@ -293,6 +293,10 @@ namespace simplechain {
 
 					gas_used = invoke_contract_result.gas_used;
 				}
+				auto* L = engine->scope()->L();
+				invoke_contract_result.exec_stats.instructions_executed = uvm::lua::lib::get_lua_state_instructions_executed_count(L);
+				invoke_contract_result.exec_stats.gc_malloc_count = L->gc_state->malloc_count();
+				invoke_contract_result.exec_stats.gc_free_count = L->gc_state->free_count();
 				invoke_contract_result.validate();
 			}
 			catch (fc::exception &e)
@@ -6,6 +6,8 @@
 #include <cbor_diff/cbor_diff.h>
 #include <cbor_diff/cbor_diff_tests.h>
 #include <simplechain/native_contract_tests.h>
+#include <simplechain/benchmark.h>
+#include <fc/io/json.hpp>
 
 using namespace simplechain;
 #ifndef RUN_BOOST_TESTS
@@ -16,6 +18,15 @@ int main(int argc, char** argv) {
 	// cbor_diff::test_cbor_json();
 	// test_token_native_contract();
 	try {
+		// simplechain --bench [invokes_count] [contracts_dir], prints the report json to stdout
+		if (argc >= 2 && std::string(argv[1]) == "--bench") {
+			size_t invokes_count = argc >= 3 ? std::stoul(argv[2]) : 1000;
+			std::string contracts_dir = argc >= 4 ? argv[3] : "../test/test_contracts";
+			fc::mutable_variant_object report(run_contract_benchmark(default_benchmark_workloads(contracts_dir, invokes_count)).get_object());
+			report["storage_gas"] = run_storage_gas_benchmark(invokes_count);
+			std::cout << fc::json::to_pretty_string(report) << std::endl;
+			return 0;
+		}
 		auto chain = std::make_shared<simplechain::blockchain>();
 
 		if (argc == 2) {
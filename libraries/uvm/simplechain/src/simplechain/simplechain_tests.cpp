@@ -116,7 +116,9 @@ void test2()
 		//BOOST_CHECK(false);
 	}
 
+#ifdef _MSC_VER
 	_CrtDumpMemoryLeaks();
+#endif
 }
 
 //BOOST_AUTO_TEST_SUITE_END()
@@ -1024,6 +1024,20 @@ namespace simplechain {
 				return prefix + fc::to_base58(bin_addr.data, sizeof(bin_addr));
 			}
 
+			std::string SimpleChainUvmChainApi::get_signature_address(lua_State *L, const char * hash, const char * v, const char * r, const char * s) {
+				try {
+					fc::ecc::compact_signature com_sig;
+					std::string sig = std::string(v) + r + s;
+					fc::from_hex(sig, (char *)com_sig.data, com_sig.size());
+					std::string shash(hash);
+					fc::sha256 ori_hash(shash);
+					return pubkey_to_address_string(fc::ecc::public_key(com_sig, ori_hash, false));
+				}
+				catch (...) {
+					return "";
+				}
+			}
+
 			bool SimpleChainUvmChainApi::use_gas_log(lua_State* L) const {
 				const auto& txid = get_transaction_id_without_gas(L);
 				return false;
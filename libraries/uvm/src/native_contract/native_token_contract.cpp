@@ -3,6 +3,7 @@
 #include <jsondiff/jsondiff.h>
 #include <cbor_diff/cbor_diff.h>
 #include <uvm/uvm_lutil.h>
+#include <unordered_map>
 
 namespace uvm {
 	namespace contract {
@@ -92,6 +93,14 @@ namespace uvm {
 			return user_balance_cbor->force_as_int();
 		}
 
+		void token_native_contract::set_balance_of_user(const std::string& owner_addr, int64_t balance)
+		{
+			if (balance > 0)
+				current_fast_map_set("users", owner_addr, CborObject::from_int(balance));
+			else
+				current_fast_map_set("users", owner_addr, CborObject::create_null());
+		}
+
 		cbor::CborMapValue token_native_contract::get_allowed_of_user(const std::string& from_addr) const {
 			auto user_allowed = current_fast_map_get("allowed", from_addr);
 			if (!user_allowed->is_map()) {
@@ -247,41 +256,43 @@ namespace uvm {
 			return;
 		}
 
-		void token_native_contract::transfer_api(const std::string& api_name, const std::string& api_arg)
+		// arg format: toAddress,amount(with precision, integer), anything after a second ',' is ignored
+		token_transfer_args token_native_contract::parse_transfer_args(const std::string& api_arg) const
 		{
-			if (get_storage_state() != common_state_of_token_contract)
-				throw_error("this token contract state doesn't allow transfer");
-			std::vector<std::string> parsed_args;
-			boost::split(parsed_args, api_arg, [](char c) {return c == ','; });
-			if (parsed_args.size() < 2)
+			auto to_end = api_arg.find(',');
+			if (to_end == std::string::npos)
 				throw_error("argument format error, need format: toAddress,amount(with precision, integer)");
-			std::string to_address = parsed_args[0];
-			boost::trim(to_address);
-			std::string amount_str = parsed_args[1];
+			auto amount_end = api_arg.find(',', to_end + 1);
+			token_transfer_args args;
+			args.to_address = api_arg.substr(0, to_end);
+			boost::trim(args.to_address);
+			std::string amount_str = api_arg.substr(to_end + 1, amount_end == std::string::npos ? std::string::npos : amount_end - to_end - 1);
 			boost::trim(amount_str);
 			if (!is_integral(amount_str))
 				throw_error("argument format error, amount must be positive integer");
-			int64_t amount = std::stoll(amount_str);
-			if (amount <= 0)
+			args.amount = std::stoll(amount_str);
+			if (args.amount <= 0)
 				throw_error("argument format error, amount must be positive integer");
+			return args;
+		}
+
+		void token_native_contract::transfer_api(const std::string& api_name, const std::string& api_arg)
+		{
+			if (get_storage_state() != common_state_of_token_contract)
+				throw_error("this token contract state doesn't allow transfer");
+			const auto& args = parse_transfer_args(api_arg);
 
 			std::string from_addr = get_from_address();
 			auto from_user_balance = get_balance_of_user(from_addr);
-			if (from_user_balance < amount)
+			if (from_user_balance < args.amount)
 				throw_error("you have not enoungh amount to transfer out");
-			auto from_addr_remain = from_user_balance - amount;
-			if (from_addr_remain > 0) {
-				current_fast_map_set("users", from_addr, CborObject::from_int(from_addr_remain));
-			}
-			else {
-				current_fast_map_set("users", from_addr, CborObject::create_null());
-			}
-			auto to_amount = get_balance_of_user(to_address);
-			current_fast_map_set("users", to_address, CborObject::from_int(to_amount + amount));
+			set_balance_of_user(from_addr, from_user_balance - args.amount);
+			auto to_amount = get_balance_of_user(args.to_address);
+			set_balance_of_user(args.to_address, to_amount + args.amount);
 			jsondiff::JsonObject event_arg;
 			event_arg["from"] = from_addr;
-			event_arg["to"] = to_address;
-			event_arg["amount"] = amount;
+			event_arg["to"] = args.to_address;
+			event_arg["amount"] = args.amount;
 			emit_event("Transfer", uvm::util::json_ordered_dumps(event_arg));
 			return;
 		}
@@ -370,25 +381,34 @@ namespace uvm {
 			return;
 		}
 
-		void token_native_contract::invoke(const std::string& api_name, const std::string& api_arg) {
-			std::map<std::string, std::function<void(const std::string&, const std::string&)>> apis = {
-				{"init", std::bind(&token_native_contract::init_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"init_token", std::bind(&token_native_contract::init_token_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"transfer", std::bind(&token_native_contract::transfer_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"transferFrom", std::bind(&token_native_contract::transfer_from_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"balanceOf", std::bind(&token_native_contract::balance_of_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"approve", std::bind(&token_native_contract::approve_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"approvedBalanceFrom", std::bind(&token_native_contract::approved_balance_from_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"allApprovedFromUser", std::bind(&token_native_contract::all_approved_from_user_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"state", std::bind(&token_native_contract::state_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"supply", std::bind(&token_native_contract::supply_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"precision", std::bind(&token_native_contract::precision_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"tokenName", std::bind(&token_native_contract::token_name_api, this, std::placeholders::_1, std::placeholders::_2)},
-				{"tokenSymbol", std::bind(&token_native_contract::token_symbol_api, this, std::placeholders::_1, std::placeholders::_2)},
+		typedef void (token_native_contract::*token_api_handler)(const std::string&, const std::string&);
+
+		// built once, invoke runs for every token transfer
+		static const std::unordered_map<std::string, token_api_handler>& token_api_handlers() {
+			static const std::unordered_map<std::string, token_api_handler> handlers = {
+				{"init", &token_native_contract::init_api},
+				{"init_token", &token_native_contract::init_token_api},
+				{"transfer", &token_native_contract::transfer_api},
+				{"transferFrom", &token_native_contract::transfer_from_api},
+				{"balanceOf", &token_native_contract::balance_of_api},
+				{"approve", &token_native_contract::approve_api},
+				{"approvedBalanceFrom", &token_native_contract::approved_balance_from_api},
+				{"allApprovedFromUser", &token_native_contract::all_approved_from_user_api},
+				{"state", &token_native_contract::state_api},
+				{"supply", &token_native_contract::supply_api},
+				{"precision", &token_native_contract::precision_api},
+				{"tokenName", &token_native_contract::token_name_api},
+				{"tokenSymbol", &token_native_contract::token_symbol_api},
 			};
-			if (apis.find(api_name) != apis.end())
+			return handlers;
+		}
+
+		void token_native_contract::invoke(const std::string& api_name, const std::string& api_arg) {
+			const auto& apis = token_api_handlers();
+			auto found = apis.find(api_name);
+			if (found != apis.end())
 			{
-				apis[api_name](api_name, api_arg);
+				(this->*(found->second))(api_name, api_arg);
 				set_invoke_result_caller();
 				add_gas(gas_count_for_api_invoke(api_name));
 				return;
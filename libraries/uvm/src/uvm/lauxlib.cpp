@@ -2206,6 +2206,10 @@ LUA_API int lua_execute_contract_api(lua_State *L, const char *contract_name,
 	const char *api_name, cbor::CborArrayValue& args, std::string *result_json_string)
 {
 	try {
+		auto exact_string_pool_fork_height = global_uvm_chain_api->get_fork_height(L, "EXACT_STRING_POOL");
+		L->gc_state->set_exact_string_pool(exact_string_pool_fork_height >= 0
+			&& global_uvm_chain_api->get_header_block_num_without_gas(L) >= exact_string_pool_fork_height);
+
 		auto contract_address = uvm::lua::lib::malloc_managed_string(L, CONTRACT_ID_MAX_LENGTH + 1);
         if (!contract_address)
 		    return LUA_ERRRUN;
@@ -3235,6 +3239,12 @@ LUALIB_API lua_State *luaL_newstate(void) {
     return L;
 }
 
+LUALIB_API lua_State *luaL_newstate_in_gc_state(vmgc::GcState *gc_state) {
+	lua_State *L = lua_newstate_in_gc_state(l_alloc, nullptr, gc_state);
+	if (L) lua_atpanic(L, &panic);
+	return L;
+}
+
 
 LUALIB_API void luaL_checkversion_(lua_State *L, lua_Number ver, size_t sz) {
     const lua_Number *v = lua_version(L);
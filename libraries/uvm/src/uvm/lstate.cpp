@@ -233,9 +233,8 @@ static void preinit_thread(lua_State *L) {
 }
 
 
-static void close_state(lua_State *L) {
+static void close_state(lua_State *L, bool keep_gc_state) {
     luaF_close(L, L->stack);  /* close all upvalues for this thread */
-    luaC_freeallobjects(L);  /* collect all objects */
     if (L->version)  /* closing a fully built state? */
         luai_userstateclose(L);
     freestack(L);
@@ -245,20 +244,25 @@ static void close_state(lua_State *L) {
 	if (L->using_contract_id_stack) {
 		delete L->using_contract_id_stack;
 	}
-	if (L->gc_state) {
-		delete L->gc_state;
-		// L->ud = nullptr;
+	auto gc_state = L->gc_state; /* L itself lives in the arena of its gc state */
+	if (gc_state) {
+		if (keep_gc_state) {
+			gc_state->gc_reset();
+		}
+		else {
+			luaC_freeallobjects(L);  /* collect all objects */
+			delete gc_state;
+		}
 	}
     // (*g->frealloc)(L->ud, fromstate(L), sizeof(LG), 0);  /* free main block */
 }
 
-LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
+static lua_State *newstate(lua_Alloc f, void *ud, vmgc::GcState *gc_state, bool keep_gc_state) {
     int i;
     lua_State *L;
-	auto gc_state = new vmgc::GcState(LUA_MALLOC_TOTAL_SIZE);
-	if (!gc_state) return nullptr;
     LG *l = lua_cast(LG *, (*f)(ud ? ud : gc_state, nullptr, LUA_TTHREAD, sizeof(LG)));
     if (l == nullptr) return nullptr;
+	memset((void*)l, 0x0, sizeof(LG)); /* the arena may have held an earlier state */
     L = &l->l.l;
     L->gc_state = gc_state;
     memset(L->compile_error, 0x0, LUA_COMPILE_ERROR_MAX_LENGTH);
@@ -301,19 +305,39 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
     for (i = 0; i < LUA_NUMTAGS; i++) L->mt[i] = nullptr;
     if (luaD_rawrunprotected(L, f_luaopen, nullptr) != LUA_OK) {
         /* memory allocation error: free partial state */
-        close_state(L);
+		delete L->contract_table_addresses;
+        close_state(L, keep_gc_state);
         L = nullptr;
     }
     return L;
 }
 
+LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
+	auto gc_state = new vmgc::GcState(LUA_MALLOC_TOTAL_SIZE);
+	if (!gc_state) return nullptr;
+	return newstate(f, ud, gc_state, false);
+}
+
+LUA_API lua_State *lua_newstate_in_gc_state(lua_Alloc f, void *ud, vmgc::GcState *gc_state) {
+	return newstate(f, ud, gc_state, true);
+}
+
 
 LUA_API void lua_close(lua_State *L) {
     uvm::lua::lib::close_lua_state_values(L);
 	delete L->contract_table_addresses;
 	L->contract_table_addresses = nullptr;
     lua_lock(L);
-    close_state(L);
+    close_state(L, false);
+}
+
+LUA_API vmgc::GcState *lua_close_keep_gc_state(lua_State *L) {
+	uvm::lua::lib::close_lua_state_values(L);
+	delete L->contract_table_addresses;
+	L->contract_table_addresses = nullptr;
+	auto gc_state = L->gc_state;
+	close_state(L, true);
+	return gc_state;
 }
 
 static size_t align8(size_t s) {
@@ -39,7 +39,8 @@ int luaS_eqlngstr(uvm_types::GcString *a, uvm_types::GcString *b) {
 	size_t len = a->value.size();
     lua_assert(a->tt == LUA_TLNGSTR && b->tt == LUA_TLNGSTR);
     return (a == b) ||  /* same instance or... */
-        ((len == b->value.size()) &&  /* equal length and ... */
+        (!(a->interned && b->interned) &&  /* not two pooled strings, which are unique by contents, and ... */
+        (len == b->value.size()) &&  /* equal length and ... */
         (memcmp(getstr(a), getstr(b), len) == 0));  /* equal contents */
 }
 
@@ -16,17 +16,17 @@
 ** Non-negative integer keys are all miners to be kept in the array
 ** part. The actual size of the array is the largest 'n' such that
 ** more than half the slots between 1 and n are in use.
-** Hash uses a mix of chained scatter table with Brent's variation.
-** A main invariant of these tables is that, if an element is not
-** in its main position (i.e. the 'original' position that its hash gives
-** to it), then the colliding element is in its own main position.
-** Hence even when the load factor reaches 100%, performance remains good.
+** The hash part keeps its nodes in insertion order in a flat vector,
+** found through an open addressing (linear probing) index of their
+** positions. 'next' walks the nodes in key order instead, sorted on
+** demand, so traversals never depend on the hash values.
 */
 
 #include <math.h>
 #include <limits.h>
 
-#include <map>
+#include <algorithm>
+#include <string.h>
 #include <vector>
 
 #include <uvm/lua.h>
@@ -59,6 +59,9 @@
 */
 #define MAXHBITS	(MAXABITS - 1)
 
+/* largest hash part size hint luaH_resize reserves room for */
+#define MAXHINTSIZE	1024u
+
 /*
 ** returns the index for 'key' if 'key' is an appropriate key to live in
 ** the array part of the table, 0 otherwise.
@@ -72,159 +75,311 @@ static unsigned int arrayindex(const TValue *key) {
     return 0;  /* 'key' did not match some condition */
 }
 
-static std::string lua_value_to_str(const TValue *key)
-{
-	if (ttisstring(key))
-	{
-		return std::string(svalue(key));
+/*
+** Keys of the hash part are identified by their string form: 5 and "5" are the
+** same key, and so are a lightuserdata and "$lightuserdata@<address>". Strings
+** only count up to their first '\0'. A key is normalized to that identity once
+** (once per string object for strings) and then compared without building any
+** string.
+*/
+enum table_key_kind : lu_byte {
+	TABLE_KEY_INTEGER = 1,
+	TABLE_KEY_STRING,
+	TABLE_KEY_LIGHTUSERDATA
+};
+
+struct table_key {
+	lu_byte kind;
+	lua_Integer id;  /* the integer, the lightuserdata pointer or the string length */
+	const char *str;  /* string content for TABLE_KEY_STRING */
+	unsigned int hash;
+};
+
+static const char LIGHTUSERDATA_KEY_PREFIX[] = "$lightuserdata@";
+
+static unsigned int hash_integer_key(lua_Integer i) {
+	lua_Unsigned h = l_castS2U(i) * 0x9E3779B97F4A7C15ull;
+	return lua_cast(unsigned int, h >> 32);
+}
+
+/* is s the std::to_string of an integer? */
+static bool canonical_integer(const char *s, size_t len, lua_Integer *out) {
+	size_t pos = 0;
+	bool neg = false;
+	if (len > 0 && s[0] == '-') {
+		neg = true;
+		pos = 1;
 	}
-	else if (ttisinteger(key))
-	{
-		return std::to_string((lua_Integer)nvalue(key));
+	if (pos >= len || len - pos > 19)
+		return false;
+	if (s[pos] == '0') {  /* no leading zeros, and "-0" is not one */
+		if (len == 1) {
+			*out = 0;
+			return true;
+		}
+		return false;
 	}
-	else if (ttisnumber(key))
-	{
-		return std::to_string(nvalue(key));
+	const lua_Unsigned limit = neg ? l_castS2U(LUA_MAXINTEGER) + 1 : l_castS2U(LUA_MAXINTEGER);
+	lua_Unsigned v = 0;
+	for (; pos < len; pos++) {
+		if (s[pos] < '0' || s[pos] > '9')
+			return false;
+		lua_Unsigned d = lua_cast(lua_Unsigned, s[pos] - '0');
+		if (v > (limit - d) / 10)
+			return false;
+		v = v * 10 + d;
 	}
-	else
-		return "";
+	*out = neg ? l_castU2S(0u - v) : l_castU2S(v);
+	return true;
 }
 
+static void set_integer_key(table_key *k, lua_Integer i) {
+	k->kind = TABLE_KEY_INTEGER;
+	k->id = i;
+	k->str = nullptr;
+	k->hash = hash_integer_key(i);
+}
 
-static bool val_to_table_key(const TValue* key, std::string& out) {
-	if (ttisnil(key)) {
-		return false;
+static void set_lightuserdata_key(table_key *k, intptr_t p) {
+	k->kind = TABLE_KEY_LIGHTUSERDATA;
+	k->id = lua_cast(lua_Integer, p);
+	k->str = nullptr;
+	k->hash = hash_integer_key(k->id) ^ 0x5bd1e995u;
+}
+
+static void set_string_key(table_key *k, const char *str) {
+	/* hash and length in one pass, up to the first '\0' */
+	unsigned int h = 2166136261u;
+	size_t len = 0;
+	for (; str[len] != '\0'; len++)
+		h = (h ^ cast_byte(str[len])) * 16777619u;
+	lua_Integer i;
+	if ((str[0] == '-' || (str[0] >= '0' && str[0] <= '9')) && canonical_integer(str, len, &i)) {
+		set_integer_key(k, i);
+		return;
 	}
-	else if (ttisfloat(key)) {
-		lua_Integer k;
-		if (luaV_tointeger(key, &k, 0)) {
-			out = std::to_string(k);
-			return true;
-		}
-		else {
-			return false;
-		}
+	const size_t prefix_len = sizeof(LIGHTUSERDATA_KEY_PREFIX) - 1;
+	if (str[0] == '$' && len > prefix_len && memcmp(str, LIGHTUSERDATA_KEY_PREFIX, prefix_len) == 0
+		&& canonical_integer(str + prefix_len, len - prefix_len, &i) && lua_cast(lua_Integer, lua_cast(intptr_t, i)) == i) {
+		set_lightuserdata_key(k, lua_cast(intptr_t, i));
+		return;
+	}
+	k->kind = TABLE_KEY_STRING;
+	k->id = lua_cast(lua_Integer, len);
+	k->str = str;
+	k->hash = h;
+}
+
+/* the identity is cached in the string, which is worked out once per (pooled) string */
+static void set_gcstring_key(table_key *k, const uvm_types::GcString *s) {
+	if (!s->table_key_kind) {
+		table_key computed;
+		set_string_key(&computed, getstr(s));
+		s->table_key_kind = computed.kind;
+		s->table_key_id = computed.id;
+		s->table_key_hash = computed.hash;
 	}
-	else if (ttisinteger(key)) {
+	k->kind = s->table_key_kind;
+	k->id = s->table_key_id;
+	k->str = k->kind == TABLE_KEY_STRING ? getstr(s) : nullptr;
+	k->hash = s->table_key_hash;
+}
+
+/* normalizes a key; false for keys the hash part can't hold (nil, NaN and other floats, other types) */
+static bool to_table_key(const TValue *key, table_key *out) {
+	if (ttisinteger(key)) {
+		set_integer_key(out, ivalue(key));
+		return true;
+	}
+	else if (ttisfloat(key)) {
 		lua_Integer k;
-		if (luaV_tointeger(key, &k, 0)) {
-			out = std::to_string(k);
-			return true;
-		}
-		else {
+		if (!luaV_tointeger(key, &k, 0))
 			return false;
-		}
+		set_integer_key(out, k);
+		return true;
 	}
 	else if (ttisstring(key)) {
-		out = getstr(gco2ts(key->value_.gco));
+		set_gcstring_key(out, tsvalue(key));
 		return true;
 	}
 	else if (ttislightuserdata(key)) {
-		out = std::string("$lightuserdata@") + std::to_string(intptr_t(key->value_.p));
+		set_lightuserdata_key(out, intptr_t(key->value_.p));
 		return true;
 	}
-	else {
+	return false;
+}
+
+static bool node_has_key(const uvm_types::GcTable::Node& n, const table_key& k) {
+	if (n.key_hash != k.hash || n.key_kind != k.kind || n.key_id != k.id)
 		return false;
-	}
+	if (k.kind != TABLE_KEY_STRING)
+		return true;
+	const char *node_str = getstr(tsvalue(&n.key));
+	return node_str == k.str || memcmp(node_str, k.str, lua_cast(size_t, k.id)) == 0;
 }
 
+/* position of the node with key k in t->nodes, or -1 */
+static int find_node(const uvm_types::GcTable *t, const table_key& k) {
+	if (t->node_slots.empty())
+		return -1;
+	size_t mask = t->node_slots.size() - 1;
+	for (size_t i = k.hash & mask; ; i = (i + 1) & mask) {
+		unsigned int slot = t->node_slots[i];
+		if (slot == 0)
+			return -1;
+		if (node_has_key(t->nodes[slot - 1], k))
+			return lua_cast(int, slot - 1);
+	}
+}
 
-static bool findindex_of_sorted_table(lua_State *L, uvm_types::GcTable *t, StkId key, unsigned int* array_index, std::string* map_key, bool* is_map_key) {
-	unsigned int i = arrayindex(key);
-	/*if (i == 0 && ttisnil(key)) {
-		*array_index = 0;
-		*is_map_key = false;
-		return true;
-	}*/
-	if (i != 0 && i <= t->array.size())  /* is 'key' inside array part? */
-	{
-		*array_index = i;
-		*is_map_key = false;
-		return true;  /* yes; that's the index */
+/*
+** integer keys are the usual keys beyond the array part (sparse ids, block numbers),
+** so they are looked up without building a table_key
+*/
+static int find_integer_node(const uvm_types::GcTable *t, lua_Integer key) {
+	if (t->node_slots.empty())
+		return -1;
+	size_t mask = t->node_slots.size() - 1;
+	for (size_t i = hash_integer_key(key) & mask; ; i = (i + 1) & mask) {
+		unsigned int slot = t->node_slots[i];
+		if (slot == 0)
+			return -1;
+		const uvm_types::GcTable::Node& n = t->nodes[slot - 1];
+		if (n.key_id == key && n.key_kind == TABLE_KEY_INTEGER)
+			return lua_cast(int, slot - 1);
 	}
-	else {
-		std::string key_str;
-		if (!val_to_table_key(key, key_str)) {
-			return false;
-		}
-		auto key_it = t->keys.find(key_str);
-		if (key_it == t->keys.end())
-			return false;
-		*map_key = key_str;
-		*is_map_key = true;
-		return true;
+}
+
+static void place_node(uvm_types::GcTable *t, unsigned int pos) {
+	size_t mask = t->node_slots.size() - 1;
+	size_t i = t->nodes[pos].key_hash & mask;
+	while (t->node_slots[i] != 0)
+		i = (i + 1) & mask;
+	t->node_slots[i] = pos + 1;
+}
+
+/* grows the index to hold count nodes at most 3/4 full */
+static void reserve_nodes(uvm_types::GcTable *t, size_t count) {
+	if (count * 4 <= t->node_slots.size() * 3)
+		return;
+	size_t new_size = t->node_slots.empty() ? 4 : t->node_slots.size() * 2;
+	while (count * 4 > new_size * 3)
+		new_size *= 2;
+	t->node_slots.assign(new_size, 0);
+	for (unsigned int i = 0; i < t->nodes.size(); i++)
+		place_node(t, i);
+}
+
+static TValue *insert_node(lua_State *L, uvm_types::GcTable *t, const TValue *key, const table_key& k) {
+	if (t->nodes.size() >= MAXASIZE)
+		luaG_runerror(L, "table overflow");
+	reserve_nodes(t, t->nodes.size() + 1);
+	uvm_types::GcTable::Node n;
+	n.key = *key;
+	n.value = *luaO_nilobject;
+	n.key_hash = k.hash;
+	n.key_kind = k.kind;
+	n.key_id = k.id;
+	t->nodes.push_back(n);
+	place_node(t, lua_cast(unsigned int, t->nodes.size() - 1));
+	return &t->nodes.back().value;
+}
+
+static const TValue *get_node_value(const uvm_types::GcTable *t, const table_key& k) {
+	int pos = find_node(t, k);
+	return pos < 0 ? luaO_nilobject : &t->nodes[pos].value;
+}
+
+struct node_sort_comparator {
+	const uvm_types::GcTable *t;
+	bool operator()(unsigned int x, unsigned int y) const {
+		const TValue *kx = &t->nodes[x].key;
+		const TValue *ky = &t->nodes[y].key;
+		if (ttisinteger(kx) && ttisinteger(ky))  /* what table_sort_comparator ends up doing for them */
+			return ivalue(kx) < ivalue(ky);
+		return uvm_types::table_sort_comparator()(*kx, *ky);
 	}
+};
+
+/* brings sorted_nodes up to date with the nodes inserted since it was last used */
+static void sort_nodes(uvm_types::GcTable *t) {
+	size_t sorted_count = t->sorted_nodes.size();
+	if (sorted_count == t->nodes.size())
+		return;
+	for (size_t i = sorted_count; i < t->nodes.size(); i++)
+		t->sorted_nodes.push_back(lua_cast(unsigned int, i));
+	node_sort_comparator cmp{ t };
+	std::sort(t->sorted_nodes.begin() + sorted_count, t->sorted_nodes.end(), cmp);
+	std::inplace_merge(t->sorted_nodes.begin(), t->sorted_nodes.begin() + sorted_count, t->sorted_nodes.end(), cmp);
 }
 
-static const char* NOT_FOUND_KEY = "$NOT_FOUND$";
+/* position in sorted_nodes of the node at node_pos */
+static size_t sorted_position(uvm_types::GcTable *t, unsigned int node_pos) {
+	sort_nodes(t);
+	/* traversals ask for the key they were just given */
+	if (t->last_next_pos < t->sorted_nodes.size() && t->sorted_nodes[t->last_next_pos] == node_pos)
+		return t->last_next_pos;
+	node_sort_comparator cmp{ t };
+	return std::lower_bound(t->sorted_nodes.begin(), t->sorted_nodes.end(), node_pos, cmp) - t->sorted_nodes.begin();
+}
 
 
 int luaH_next(lua_State *L, uvm_types::GcTable *t, StkId key) {
-	unsigned int array_index;
-	std::string map_key;
-	bool is_map_key;
-	bool use_first_map_key = false;
-	// array_index is index of key1-based0 means not found
-    bool found_key = findindex_of_sorted_table(L, t, key, &array_index, &map_key, &is_map_key);  /* find original element */
 	if (nullptr == t) {
 		return 0;
 	}
-	if (ttisnil(key)) {
-		array_index = 0;
-		is_map_key = false;
+	unsigned int array_index = 0;  /* array position to go on from */
+	size_t sorted_pos = 0;  /* sorted_nodes position to go on from */
+	if (!ttisnil(key)) {
+		unsigned int i = arrayindex(key);
+		if (i != 0 && i <= t->array.size()) {  /* is 'key' inside array part? */
+			array_index = i;
+		}
+		else {
+			table_key k;
+			int node_pos = to_table_key(key, &k) ? find_node(t, k) : -1;
+			if (node_pos < 0)
+				return 0;
+			sorted_pos = sorted_position(t, lua_cast(unsigned int, node_pos)) + 1;
+			array_index = lua_cast(unsigned int, t->array.size());
+		}
 	}
 	auto array_part_size = t->array.size();
-	if (!is_map_key) {
-		// key in array part
-		for (auto i = array_index; i < array_part_size; i++) {
-			if (!ttisnil(&t->array[i])) {  /* a non-nil value? */
-				setivalue(key, i + 1);
-				setobj2s(L, key + 1, &t->array[i]);
-				return 1;
-			}
+	for (auto i = array_index; i < array_part_size; i++) {
+		if (!ttisnil(&t->array[i])) {  /* a non-nil value? */
+			setivalue(key, i + 1);
+			setobj2s(L, key + 1, &t->array[i]);
+			return 1;
 		}
-		use_first_map_key = true;
 	}
 	// key in map part
-	auto item_value_it = t->entries.begin();
-	if (!use_first_map_key) {
-		auto it = t->keys.find(map_key);
-		if (it == t->keys.end()) {
-			return 0;
-		}
-		const auto& item_key = it->second;
-		item_value_it = t->entries.find(item_key);
-		if (item_value_it != t->entries.end())
-			item_value_it++;
-	}
-	do {
-		if (item_value_it == t->entries.end())
-			return 0;
-		if (ttisnil(&item_value_it->second))
-		{
-			item_value_it++;
+	sort_nodes(t);
+	for (; sorted_pos < t->sorted_nodes.size(); sorted_pos++) {
+		const auto& item = t->nodes[t->sorted_nodes[sorted_pos]];
+		if (ttisnil(&item.value))
 			continue;
-		}
-		if (ttisinteger(&item_value_it->first)) {
-			setobj2s(L, key, &item_value_it->first);
-			setobj2s(L, key + 1, &item_value_it->second);
+		t->last_next_pos = sorted_pos;
+		if (ttisinteger(&item.key)) {
+			setobj2s(L, key, &item.key);
+			setobj2s(L, key + 1, &item.value);
 			return 1;
 		}
-
-		std::string item_key_str;
-		if (!val_to_table_key(&item_value_it->first, item_key_str)) {
-			item_value_it++;
-			continue;
+		// other keys are given back as their string form
+		uvm_types::GcString *s;
+		if (ttisstring(&item.key)) {
+			s = luaS_new(L, getstr(tsvalue(&item.key)));
+		}
+		else {
+			std::string item_key_str = std::string(LIGHTUSERDATA_KEY_PREFIX) + std::to_string(intptr_t(item.key.value_.p));
+			s = luaS_new(L, item_key_str.c_str());
 		}
-		auto s = luaS_new(L, item_key_str.c_str());
 		if (!s) {
 			return 0;
 		}
 		setsvalue(L, key, s);
-		setobj2s(L, key + 1, &item_value_it->second);
+		setobj2s(L, key + 1, &item.value);
 		return 1;
-	} while (true);
-	
+	}
 	return 0;
 }
 
@@ -242,11 +397,16 @@ void luaH_resize(lua_State *L, uvm_types::GcTable *t, unsigned int nasize,
 	else {
 		t->array.resize(nasize);
 	}
+	/* size hint of a table constructor; bytecode can claim anything, so only modest hints are taken */
+	if (nhsize > t->nodes.size() && nhsize <= MAXHINTSIZE) {
+		reserve_nodes(t, nhsize);
+		t->nodes.reserve(nhsize);
+	}
 }
 
 
 void luaH_resizearray(lua_State *L, uvm_types::GcTable *t, unsigned int nasize) {
-	int nsize = t->entries.size();
+	int nsize = t->nodes.size();
     luaH_resize(L, t, nasize, nsize);
 }
 
@@ -302,17 +462,12 @@ TValue *luaH_newkey(lua_State *L, uvm_types::GcTable *t, const TValue *key, bool
 		t->array.push_back(*luaO_nilobject);
 		return &t->array[k-1];
 	}
-	TValue key_obj(*key);
-	std::string key_str;
-	if (!val_to_table_key(key, key_str)) {
+	table_key hash_key;
+	if (!to_table_key(key, &hash_key)) {
 		luaG_runerror(L, "invalid table key type");
 		return nullptr;
 	}
-	
-	t->entries[key_obj] = *luaO_nilobject;
-	t->keys[key_str] = key_obj;
-	auto it = t->entries.find(key_obj);
-	return &it->second;
+	return insert_node(L, t, key, hash_key);
 }
 
 
@@ -323,15 +478,8 @@ const TValue *luaH_getint(uvm_types::GcTable *t, lua_Integer key) {
     if (l_castS2U(key) - 1 < t->array.size())
         return &t->array[key - 1];
     else {
-		const auto& key_str = std::to_string(key);
-		auto key_obj_it = t->keys.find(key_str);
-		if (key_obj_it == t->keys.end())
-			return luaO_nilobject;
-		const auto& key_obj = key_obj_it->second;
-		auto val_it = t->entries.find(key_obj);
-		if(val_it == t->entries.end())
-			return luaO_nilobject;
-		return &val_it->second;
+		int pos = find_integer_node(t, key);
+		return pos < 0 ? luaO_nilobject : &t->nodes[pos].value;
     }
 }
 
@@ -340,15 +488,9 @@ const TValue *luaH_getint(uvm_types::GcTable *t, lua_Integer key) {
 ** search function for short strings
 */
 const TValue *luaH_getshortstr(uvm_types::GcTable *t, uvm_types::GcString *key) {
-	std::string key_str = key->value;
-	auto key_obj_it = t->keys.find(key_str);
-	if (key_obj_it == t->keys.end())
-		return luaO_nilobject;
-	const auto& key_obj = key_obj_it->second;
-	auto val_it = t->entries.find(key_obj);
-	if (val_it == t->entries.end())
-		return luaO_nilobject;
-	return &val_it->second;
+	table_key k;
+	set_gcstring_key(&k, key);
+	return get_node_value(t, k);
 }
 
 
@@ -357,18 +499,11 @@ const TValue *luaH_getshortstr(uvm_types::GcTable *t, uvm_types::GcString *key)
 ** which may be in array part, nor for floats with integral values.)
 */
 static const TValue *getgeneric(uvm_types::GcTable *t, const TValue *key) {
-	std::string key_str;
-	if (!val_to_table_key(key, key_str)) {
+	table_key k;
+	if (!to_table_key(key, &k)) {
 		return luaO_nilobject;
 	}
-	auto key_obj_it = t->keys.find(key_str);
-	if (key_obj_it == t->keys.end())
-		return luaO_nilobject;
-	const auto& key_obj = key_obj_it->second;
-	auto val_it = t->entries.find(key_obj);
-	if (val_it == t->entries.end())
-		return luaO_nilobject;
-	return &val_it->second;
+	return get_node_value(t, k);
 }
 
 
@@ -417,14 +552,22 @@ TValue *luaH_set(lua_State *L, uvm_types::GcTable *t, const TValue *key, bool al
 
 
 void luaH_setint(lua_State *L, uvm_types::GcTable *t, lua_Integer key, TValue *value) {
-    const TValue *p = luaH_getint(t, key);
     TValue *cell;
-    if (p != luaO_nilobject)
-        cell = lua_cast(TValue *, p);
+    int pos;
+    if (l_castS2U(key) - 1 < t->array.size())
+        cell = &t->array[key - 1];
+    else if ((pos = find_integer_node(t, key)) >= 0)
+        cell = &t->nodes[pos].value;
+    else if (l_castS2U(key) == t->array.size() + 1) {  /* next array slot, as luaH_newkey does */
+        t->array.push_back(*luaO_nilobject);
+        cell = &t->array.back();
+    }
     else {
         TValue k;
         setivalue(&k, key);
-        cell = luaH_newkey(L, t, &k);
+        table_key hash_key;
+        set_integer_key(&hash_key, key);
+        cell = insert_node(L, t, &k, hash_key);
     }
     setobj2t(L, cell, value);
 }
@@ -471,7 +614,7 @@ int luaH_getn(uvm_types::GcTable *t) {
         return i;
     }
     /* else must find a boundary in hash part */
-    else if (t->entries.empty())  /* hash part is empty? */
+    else if (t->nodes.empty())  /* hash part is empty? */
         return j;  /* that is easy... */
     else return unbound_search(t, j);
 }
@@ -818,6 +818,83 @@ void luaV_finishOp(lua_State *L) {
 #define vmbreak		break
 
 
+/*
+** Straight-line runs: consecutive instructions that can't call out, raise
+** errors or leave the frame, ending at the first one that changes the pc.
+** A run is charged to the instruction counter at once and executed in one
+** go; with computed goto every handler dispatches the next instruction
+** itself. Runs are only taken when the whole run fits under the
+** instruction limit, so gas totals and the point where the limit is hit
+** are the same as when stepping one instruction at a time.
+*/
+#if !defined(UVM_NO_THREADED_DISPATCH) && defined(__GNUC__)
+#define UVM_THREADED_DISPATCH
+#endif
+
+#define STRAIGHT_RUN_MAX	255
+
+#if defined(UVM_THREADED_DISPATCH)
+#define straightdispatch(o)	goto *straight_jumptable[o];
+#define straightcase(l)	L_##l:
+#define straightdefault	L_STRAIGHT_OTHER:
+#define straightbreak	{ if (--left == 0) goto straight_done; \
+	i = *(ci->u.l.savedpc++); ra = RA(i); straightdispatch(GET_OPCODE(i)) }
+#else
+#define straightdispatch(o)	switch(o)
+#define straightcase(l)	case l:
+#define straightdefault	default:
+#define straightbreak	break
+#endif
+
+static bool is_straight_op(const uvm_types::GcProto *p, Instruction i)
+{
+	switch (GET_OPCODE(i)) {
+	case UOP_MOVE:
+	case UOP_LOADK:
+	case UOP_LOADBOOL:
+	case UOP_LOADNIL:
+	case UOP_NOT:
+	case UOP_JMP:
+	case UOP_TEST:
+	case UOP_TESTSET:
+		return true;
+	case UOP_GETUPVAL:
+		return GETARG_B(i) < (int)p->upvalues.size();
+	default:
+		return false;
+	}
+}
+
+static bool ends_straight_run(Instruction i)
+{
+	switch (GET_OPCODE(i)) {
+	case UOP_JMP:
+	case UOP_TEST:
+	case UOP_TESTSET:
+		return true;
+	case UOP_LOADBOOL:
+		return GETARG_C(i) != 0;
+	default:
+		return false;
+	}
+}
+
+static void build_straight_runs(uvm_types::GcProto *p)
+{
+	auto count = p->codes.size();
+	p->straight_runs.assign(count, 0);
+	for (size_t pc = count; pc-- > 0;) {
+		Instruction i = p->codes[pc];
+		if (!is_straight_op(p, i))
+			continue;
+		if (ends_straight_run(i) || pc + 1 == count)
+			p->straight_runs[pc] = 1;
+		else
+			p->straight_runs[pc] = (lu_byte)std::min(STRAIGHT_RUN_MAX, p->straight_runs[pc + 1] + 1);
+	}
+}
+
+
 /*
 ** copy of 'luaV_gettable', but protecting call to potential metamethod
 ** (which can reallocate the stack)
@@ -1073,10 +1150,15 @@ namespace uvm {
 				L->state = lua_VMState::LVM_STATE_NONE;
 			}
 
-			bool use_step_log = global_uvm_chain_api != nullptr && global_uvm_chain_api->use_step_log(L);
-                        bool use_gas_log = global_uvm_chain_api != nullptr && global_uvm_chain_api->use_gas_log(L);
+			// most steps are not at the start of a run, only a table lookup is spent on them
+			if (straight_runs && ci) {
+				auto pc = ci->u.l.savedpc - straight_runs_code;
+				if (pc >= 0 && pc < straight_runs_count && straight_runs[pc] >= 2
+					&& executeStraightRun(L, straight_runs[pc])) {
+					return true;
+				}
+			}
 
-			
 				if (!ci || ci->u.l.savedpc == nullptr) {
 					global_uvm_chain_api->throw_exception(L, UVM_API_LVM_LIMIT_OVER_ERROR, "wrong bytecode instruction, can't find savedpc");
 					//vmbreak;
@@ -1538,6 +1620,7 @@ namespace uvm {
 
 							lua_assert(ci == L->ci);
 							cl = clLvalue(ci->func);  /* local reference to function's closure */
+							load_straight_runs();
 							k = cl->p->ks.empty() ? nullptr : cl->p->ks.data();  /* local reference to function's constant table */
 							base = ci->u.l.base;  /* local copy of function's base */
 							//return true; /* restart luaV_execute over new Lua function */
@@ -1630,6 +1713,7 @@ namespace uvm {
 							ci = L->ci;
 							lua_assert(ci == L->ci);
 							cl = clLvalue(ci->func);  /* local reference to function's closure */
+							load_straight_runs();
 							k = cl->p->ks.empty() ? nullptr : cl->p->ks.data();  /* local reference to function's constant table */
 							base = ci->u.l.base;  /* local copy of function's base */
 												  //return true; /* restart luaV_execute over new Lua function */
@@ -1668,6 +1752,7 @@ namespace uvm {
 								vmbreak;
 							lua_assert(ci == L->ci);
 							cl = clLvalue(ci->func);  /* local reference to function's closure */
+							load_straight_runs();
 							k = cl->p->ks.empty() ? nullptr : cl->p->ks.data();  /* local reference to function's constant table */
 							base = ci->u.l.base;  /* local copy of function's base */
 							//return true; /* restart luaV_execute over new Lua function */
@@ -1702,6 +1787,7 @@ namespace uvm {
 								vmbreak;
 							lua_assert(ci == L->ci);
 							cl = clLvalue(ci->func);  /* local reference to function's closure */
+							load_straight_runs();
 							k = cl->p->ks.empty() ? nullptr : cl->p->ks.data();  /* local reference to function's constant table */
 							base = ci->u.l.base;  /* local copy of function's base */
 							//return true; /* restart luaV_execute over new Lua function */
@@ -1951,6 +2037,7 @@ namespace uvm {
 
 								lua_assert(ci == L->ci);
 								cl = clLvalue(ci->func);  /* local reference to function's closure */
+								load_straight_runs();
 								k = cl->p->ks.empty() ? nullptr : cl->p->ks.data();  /* local reference to function's constant table */
 								base = ci->u.l.base;  /* local copy of function's base */
 								//return true;
@@ -1964,6 +2051,106 @@ namespace uvm {
 			return true;
 		}
 
+		bool ExecuteContext::executeStraightRun(lua_State* L, int left) {
+			if (L->force_stopping || L->allow_debug || (L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)))
+				return false;
+			if (stopped_pointer && *stopped_pointer > 0)
+				return false;
+			if (cl->nupvalues != cl->p->upvalues.size())
+				return false;
+			// near the limit the single step path finds the exact failing instruction
+			if (has_insts_limit && *insts_executed_count + left > insts_limit)
+				return false;
+			*insts_executed_count += left;
+
+			Instruction i;
+			StkId ra;
+#if defined(UVM_THREADED_DISPATCH)
+			static const void *const straight_jumptable[] = {
+				&&L_UOP_MOVE, &&L_UOP_LOADK, &&L_STRAIGHT_OTHER, &&L_UOP_LOADBOOL, &&L_UOP_LOADNIL, &&L_UOP_GETUPVAL,
+				&&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER,
+				&&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER,
+				&&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER,
+				&&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER,
+				&&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_UOP_NOT, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER,
+				&&L_UOP_JMP, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_UOP_TEST, &&L_UOP_TESTSET,
+				&&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER,
+				&&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER,
+				&&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER,
+				&&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER, &&L_STRAIGHT_OTHER,
+				&&L_STRAIGHT_OTHER
+			};
+			static_assert(sizeof(straight_jumptable) / sizeof(straight_jumptable[0]) == UNUM_OPCODES,
+				"straight_jumptable must have one entry per opcode");
+#endif
+			for (;;) {
+				i = *(ci->u.l.savedpc++);
+				ra = RA(i);
+				straightdispatch(GET_OPCODE(i)) {
+					straightcase(UOP_MOVE) {
+						setobjs2s(L, ra, RB(i));
+						straightbreak;
+					}
+					straightcase(UOP_LOADK) {
+						TValue *rb = k + GETARG_Bx(i);
+						setobj2s(L, ra, rb);
+						straightbreak;
+					}
+					straightcase(UOP_LOADBOOL) {
+						setbvalue(ra, GETARG_B(i));
+						if (GETARG_C(i)) ci->u.l.savedpc++;  /* skip next instruction (if C) */
+						straightbreak;
+					}
+					straightcase(UOP_LOADNIL) {
+						int b = GETARG_B(i);
+						do {
+							setnilvalue(ra++);
+						} while (b--);
+						straightbreak;
+					}
+					straightcase(UOP_GETUPVAL) {
+						setobj2s(L, ra, cl->upvals[GETARG_B(i)]->v);
+						straightbreak;
+					}
+					straightcase(UOP_NOT) {
+						TValue *rb = RB(i);
+						int res = l_isfalse(rb);  /* next assignment may change this value */
+						setbvalue(ra, res);
+						straightbreak;
+					}
+					straightcase(UOP_JMP) {
+						dojump(ci, i, 0);
+						straightbreak;
+					}
+					straightcase(UOP_TEST) {
+						if (GETARG_C(i) ? l_isfalse(ra) : !l_isfalse(ra))
+							ci->u.l.savedpc++;
+						else
+							donextjump(ci);
+						straightbreak;
+					}
+					straightcase(UOP_TESTSET) {
+						TValue *rb = RB(i);
+						if (GETARG_C(i) ? l_isfalse(rb) : !l_isfalse(rb))
+							ci->u.l.savedpc++;
+						else {
+							setobjs2s(L, ra, rb);
+							donextjump(ci);
+						}
+						straightbreak;
+					}
+					straightdefault {
+						lua_assert(0);  /* build_straight_runs only admits the opcodes above */
+						goto straight_done;
+					}
+				}
+				if (--left == 0)
+					break;
+			}
+		straight_done:
+			return true;
+		}
+
 		bool ExecuteContext::executeToNextCi(lua_State* L) {
 			if (L->state != lua_VMState::LVM_STATE_NONE) {
 				L->state = lua_VMState::LVM_STATE_NONE;
@@ -2030,12 +2217,31 @@ namespace uvm {
 			this->insts_executed_count = insts_executed_count;
 			this->stopped_pointer = stopped_pointer;
 			this->use_last_return = use_last_return;
+			this->use_step_log = global_uvm_chain_api != nullptr && global_uvm_chain_api->use_step_log(L);
 			this->insts_limit = insts_limit;
 			this->has_insts_limit = has_insts_limit;
 			this->k = k;
 			this->ci = ci;
 			this->base = base;
 			this->cl = cl;
+			this->use_straight_runs = !this->use_step_log && !L->disable_straight_runs;
+			load_straight_runs();
+		}
+
+		void ExecuteContext::load_straight_runs() {
+			straight_runs = nullptr;
+			straight_runs_code = nullptr;
+			straight_runs_count = 0;
+			if (!use_straight_runs)
+				return;
+			auto p = cl->p;
+			if (p->straight_runs.size() != p->codes.size())
+				build_straight_runs(p);
+			if (p->straight_runs.empty())
+				return;
+			straight_runs = p->straight_runs.data();
+			straight_runs_code = p->codes.data();
+			straight_runs_count = (ptrdiff_t)p->straight_runs.size();
 		}
 
 		std::map<std::string, TValue> ExecuteContext::view_localvars(lua_State* L) const {
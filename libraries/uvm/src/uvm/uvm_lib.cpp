@@ -98,24 +98,31 @@ namespace uvm
                 return &states_map;
             }
 
+            // UvmStatePool builds states on its own thread, so every access to states_map takes this
             static std::mutex states_map_mutex;
 
             static L_V1 create_value_map_for_lua_state(lua_State *L)
             {
                 LStatesMap *states_map = get_lua_states_value_hashmap();
+                std::lock_guard<std::mutex> lock(states_map_mutex);
                 auto it = states_map->find(L);
                 if (it == states_map->end())
                 {
-                    states_map_mutex.lock();
                     L_V1 map = std::make_shared<L_VM1>();
                     states_map->insert(std::make_pair(L, map));
-                    states_map_mutex.unlock();
                     return map;
                 }
                 else
                     return it->second;
             }
 
+            static void erase_value_map_of_lua_state(lua_State *L)
+            {
+                LStatesMap *states_map = get_lua_states_value_hashmap();
+                std::lock_guard<std::mutex> lock(states_map_mutex);
+                states_map->erase(L);
+            }
+
 			// transfer from contract to account
 			static int transfer_from_contract_to_public_account(lua_State *L)
             {
@@ -1729,9 +1736,11 @@ end
 			}
 
 
-            lua_State *create_lua_state(bool use_contract)
+            lua_State *create_lua_state(bool use_contract, vmgc::GcState *gc_state)
             {
-                lua_State *L = luaL_newstate();
+                lua_State *L = gc_state ? luaL_newstate_in_gc_state(gc_state) : luaL_newstate();
+                if (nullptr == L)
+                    return nullptr;
                 luaL_openlibs(L);
                 // run init lua code here, eg. init storage api, load some modules
 				add_global_c_function(L, "debugger", &enter_lua_debugger);
@@ -1870,6 +1879,12 @@ end
             }
 
             void close_lua_state(lua_State *L)
+            {
+                release_lua_state_resources(L);
+                lua_close(L);
+            }
+
+            void release_lua_state_resources(lua_State *L)
             {
                 //luaL_commit_storage_changes(L);
 				uvm::lua::api::global_uvm_chain_api->release_objects_in_pool(L);
@@ -1940,10 +1955,8 @@ end
                         lua_free(L, stopped_pointer);
                     }
                     
-                    states_map->erase(L);
+                    erase_value_map_of_lua_state(L);
                 }
-
-                lua_close(L);
             }
 
             /**
@@ -1952,12 +1965,12 @@ end
             void close_all_lua_state_values()
             {
                 LStatesMap *states_map = get_lua_states_value_hashmap();
+                std::lock_guard<std::mutex> lock(states_map_mutex);
                 states_map->clear();
             }
             void close_lua_state_values(lua_State *L)
             {
-                LStatesMap *states_map = get_lua_states_value_hashmap();
-                states_map->erase(L);
+                erase_value_map_of_lua_state(L);
             }
 
             UvmStateValueNode get_lua_state_value_node(lua_State *L, const char *key)
@@ -76,14 +76,174 @@ namespace uvm
 				return ref;
 			}
 
+            UvmStatePool::UvmStatePool(size_t max_idle_states)
+                : _max_idle_states(max_idle_states), _stopping(false) {
+                _building[0] = _building[1] = 0;
+            }
+
+            UvmStatePool::~UvmStatePool() {
+                if (_builder)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        _stopping = true;
+                    }
+                    _changed.notify_all();
+                    _builder->join();
+                }
+                clear();
+            }
+
+            size_t UvmStatePool::pooled_count(bool use_contract) const
+            {
+                auto i = use_contract ? 1 : 0;
+                return _idle_states[i].size() + _pending_gc_states[i].size() + _building[i];
+            }
+
+            lua_State *UvmStatePool::acquire(bool use_contract)
+            {
+                auto i = use_contract ? 1 : 0;
+                vmgc::GcState *gc_state = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    while (true)
+                    {
+                        if (!_idle_states[i].empty())
+                        {
+                            auto L = _idle_states[i].back();
+                            _idle_states[i].pop_back();
+                            return L;
+                        }
+                        // the builder has not got to it yet, building it here beats a new arena
+                        if (!_pending_gc_states[i].empty())
+                        {
+                            gc_state = _pending_gc_states[i].back();
+                            _pending_gc_states[i].pop_back();
+                            break;
+                        }
+                        if (0 == _building[i])
+                            break;
+                        _changed.wait(lock);
+                    }
+                }
+                if (nullptr != gc_state)
+                {
+                    auto L = create_lua_state(use_contract, gc_state);
+                    if (nullptr != L)
+                        return L;
+                    delete gc_state;
+                }
+                return create_lua_state(use_contract);
+            }
+
+            void UvmStatePool::release(lua_State *L, bool use_contract)
+            {
+                if (nullptr == L)
+                    return;
+                bool pool_full = false;
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    pool_full = pooled_count(use_contract) >= _max_idle_states;
+                }
+                if (pool_full)
+                {
+                    close_lua_state(L);
+                    return;
+                }
+                // tearing down calls the chain api, so it stays on the caller
+                release_lua_state_resources(L);
+                auto gc_state = lua_close_keep_gc_state(L);
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (pooled_count(use_contract) < _max_idle_states)
+                    {
+                        _pending_gc_states[use_contract ? 1 : 0].push_back(gc_state);
+                        if (!_builder)
+                            _builder.reset(new std::thread([this]() { build_pending_states(); }));
+                        gc_state = nullptr;
+                    }
+                }
+                if (nullptr == gc_state)
+                    _changed.notify_all();
+                else
+                    delete gc_state;
+            }
+
+            void UvmStatePool::build_pending_states()
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                while (true)
+                {
+                    if (_stopping)
+                        return;
+                    int i = !_pending_gc_states[1].empty() ? 1 : (!_pending_gc_states[0].empty() ? 0 : -1);
+                    if (i < 0)
+                    {
+                        _changed.wait(lock);
+                        continue;
+                    }
+                    auto gc_state = _pending_gc_states[i].back();
+                    _pending_gc_states[i].pop_back();
+                    ++_building[i];
+                    lock.unlock();
+                    auto L = create_lua_state(i == 1, gc_state);
+                    if (nullptr == L)
+                        delete gc_state;
+                    lock.lock();
+                    --_building[i];
+                    // counted in pooled_count while building, so this never overfills the pool
+                    if (nullptr != L)
+                        _idle_states[i].push_back(L);
+                    _changed.notify_all();
+                }
+            }
+
+            size_t UvmStatePool::idle_count(bool use_contract)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                return pooled_count(use_contract);
+            }
+
+            void UvmStatePool::clear()
+            {
+                std::vector<lua_State*> states;
+                std::vector<vmgc::GcState*> gc_states;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    for (auto &pending : _pending_gc_states)
+                    {
+                        gc_states.insert(gc_states.end(), pending.begin(), pending.end());
+                        pending.clear();
+                    }
+                    while (_building[0] + _building[1] > 0)
+                        _changed.wait(lock);
+                    for (auto &idle_states : _idle_states)
+                    {
+                        states.insert(states.end(), idle_states.begin(), idle_states.end());
+                        idle_states.clear();
+                    }
+                }
+                for (auto gc_state : gc_states)
+                    delete gc_state;
+                for (auto L : states)
+                    close_lua_state(L);
+            }
+
+            UvmStatePool &UvmStatePool::instance()
+            {
+                // never destroyed, closing states needs the chain api which may be gone at exit
+                static UvmStatePool *pool = new UvmStatePool();
+                return *pool;
+            }
+
             UvmStateScope::UvmStateScope(bool use_contract)
                 :_use_contract(use_contract) {
-                this->_L = create_lua_state(use_contract);
+                this->_L = UvmStatePool::instance().acquire(use_contract);
             }
-            UvmStateScope::UvmStateScope(const UvmStateScope &other) : _L(other._L) {}
+            UvmStateScope::UvmStateScope(const UvmStateScope &other) : _L(other._L), _use_contract(other._use_contract) {}
             UvmStateScope::~UvmStateScope() {
 				if (nullptr != _L)
-                    close_lua_state(_L);
+                    UvmStatePool::instance().release(_L, _use_contract);
             }
 
             void UvmStateScope::change_in_file(FILE *in)
@@ -342,6 +342,21 @@ cbor::CborObjectP uvm_storage_value_to_cbor(UvmStorageValue value) {
 	}
 }
 
+cbor::CborObjectP uvm_storage_scalar_cbor(cbor::CborObject* cbor_value) {
+	using namespace cbor;
+	if (cbor_value->is_null())
+		return CborObject::create_null();
+	else if (cbor_value->is_bool())
+		return CborObject::from_bool(cbor_value->as_bool());
+	else if (cbor_value->is_int() || cbor_value->is_extra_int())
+		return CborObject::from_int(cbor_value->force_as_int());
+	else if (cbor_value->is_float())
+		return CborObject::from_float64(cbor_value->as_float64());
+	else if (cbor_value->is_string())
+		return CborObject::from_string(std::string(cbor_value->as_string().c_str())); // lua strings end at the first '\0'
+	return nullptr;
+}
+
 jsondiff::JsonValue uvm_storage_value_to_json(UvmStorageValue value)
 {
 	switch (value.type)
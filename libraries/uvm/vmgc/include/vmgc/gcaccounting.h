@@ -0,0 +1,126 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <inttypes.h>
+#include <cstddef>
+
+namespace vmgc {
+
+#define GC_LEGACY_SMALL_BUFFER_SIZE 128
+#define GC_LEGACY_SMALL_LIST_COUNT (GC_LEGACY_SMALL_BUFFER_SIZE/8)
+
+	// position -> size of the buffers allocated in GcLegacyAccounting, open addressing with linear probing
+	class GcLegacyBufferTable {
+	public:
+		void insert(intptr_t pos, ptrdiff_t size);
+		// the size of the removed buffer, 0 if no buffer starts at pos
+		ptrdiff_t erase(intptr_t pos);
+		ptrdiff_t find(intptr_t pos) const;
+		void clear();
+
+	private:
+		struct Slot {
+			intptr_t pos; // 0 for an empty slot
+			ptrdiff_t size;
+		};
+		size_t slot_of(intptr_t pos) const;
+		void grow();
+
+		std::vector<Slot> _slots;
+		size_t _count = 0;
+	};
+
+	// keeps the nodes of a node based container for reuse, the replayed free lists create and drop
+	// map nodes on most allocations
+	class GcLegacyNodePool {
+	public:
+		GcLegacyNodePool() : _node_size(0) {}
+		~GcLegacyNodePool();
+		void* allocate(size_t size);
+		void deallocate(void* p, size_t size);
+
+	private:
+		GcLegacyNodePool(const GcLegacyNodePool&);
+		GcLegacyNodePool& operator=(const GcLegacyNodePool&);
+
+		size_t _node_size; // the size of the first node allocated, other sizes are not pooled
+		std::vector<void*> _free_nodes;
+	};
+
+	template <typename T>
+	struct GcLegacyNodeAllocator {
+		typedef T value_type;
+
+		explicit GcLegacyNodeAllocator(GcLegacyNodePool* pool) : pool(pool) {}
+		template <typename U>
+		GcLegacyNodeAllocator(const GcLegacyNodeAllocator<U>& other) : pool(other.pool) {}
+
+		T* allocate(size_t n) { return static_cast<T*>(pool->allocate(n * sizeof(T))); }
+		void deallocate(T* p, size_t n) { pool->deallocate(p, n * sizeof(T)); }
+
+		template <typename U>
+		bool operator==(const GcLegacyNodeAllocator<U>& other) const { return pool == other.pool; }
+		template <typename U>
+		bool operator!=(const GcLegacyNodeAllocator<U>& other) const { return pool != other.pool; }
+
+		GcLegacyNodePool* pool;
+	};
+
+	// Replays the block accounting of the first-fit buffer allocator GcState used before its size-class
+	// chunks, without any memory behind it. The heap size limit is checked against these numbers, so a
+	// contract runs out of memory at the same allocation as on older nodes; the chunk allocator rounds,
+	// pads and reuses memory differently and would move that point.
+	// Buffers are identified by their position in the replayed allocator, 0 is never a valid position.
+	class GcLegacyAccounting {
+	public:
+		explicit GcLegacyAccounting(ptrdiff_t max_size);
+
+		// the position of a new buffer of size bytes, 0 if the old allocator ran out of memory
+		intptr_t malloc_buffer(size_t size);
+		// unknown positions are ignored like the old gc_free did
+		void free_buffer(intptr_t pos);
+		// the old gc_free_array freed every element on its own, at pos + i * element_size
+		void free_array(intptr_t pos, size_t count, size_t element_size);
+		// false if interning the string needed a new pool block past the limit
+		bool intern_string(size_t sz, unsigned int hash, const char* str, size_t strsize);
+		// back to the state of a new allocator, like gc_free_all
+		void reset();
+		ptrdiff_t total_blocks_size() const { return _total_blocks_size; }
+
+	private:
+		// free buffers of one size in the old list, oldest first
+		struct BigBufferGroup {
+			intptr_t oldest;
+			std::vector<intptr_t> newer;
+		};
+		struct BigBuffer {
+			intptr_t pos; // 0 if there is none
+			ptrdiff_t size;
+		};
+
+		void insert_empty_buffer(intptr_t pos, ptrdiff_t size);
+		void insert_big_buffer(intptr_t pos, ptrdiff_t size);
+		// removes the newest buffer of the smallest size or the oldest of the biggest one
+		BigBuffer take_big_buffer(bool smallest);
+
+		ptrdiff_t _max_size;
+		ptrdiff_t _total_blocks_size;
+		intptr_t _next_block_pos;
+		GcLegacyBufferTable _buffers;
+		std::deque<intptr_t> _empty_small_buffers[GC_LEGACY_SMALL_LIST_COUNT]; // free buffers by size, oldest first
+		// the old list of bigger free buffers, sorted by size with a buffer in front of the older ones of
+		// its size. Splitting the biggest buffer is the common case, so while it is bigger than all others
+		// it is kept in _biggest_empty_buffer instead of the map
+		typedef std::map<ptrdiff_t, BigBufferGroup, std::less<ptrdiff_t>,
+			GcLegacyNodeAllocator<std::pair<const ptrdiff_t, BigBufferGroup> > > BigBufferMap;
+		GcLegacyNodePool _big_buffer_nodes; // declared before the map, which gives its nodes back on destruction
+		BigBufferMap _empty_big_buffers;
+		BigBuffer _biggest_empty_buffer;
+		std::unordered_map<unsigned int, std::string> _strpool; // hash -> contents of the last string pooled for it
+		ptrdiff_t _empty_str_buffer_size;
+	};
+}
@@ -10,7 +10,9 @@
 #include <cstring>
 #include "vmgc/exceptions.h"
 #include "vmgc/gcobject.h"
+#include "vmgc/gcaccounting.h"
 #include <map>
+#include <unordered_map>
 
 
 namespace vmgc {
@@ -25,28 +27,65 @@ namespace vmgc {
 #define DEFAULT_MAX_SMALL_BUFFER_SIZE 128  //8ı
 #define DEFAULT_SMALL_BUFFER_VECTOR_SIZE (DEFAULT_MAX_SMALL_BUFFER_SIZE/8)     
 
+// size classes: 8 byte steps up to GC_SMALL_CLASS_LIMIT, then 4 classes per power of two up to GC_MAX_CLASS_SIZE.
+// bigger buffers get a block of their own
+#define GC_SMALL_CLASS_LIMIT 512
+#define GC_SMALL_CLASS_COUNT (GC_SMALL_CLASS_LIMIT/8)
+#define GC_MAX_CLASS_SIZE (256*1024)
+#define GC_SIZE_CLASS_COUNT (GC_SMALL_CLASS_COUNT + 9*4)
+// arena blocks kept by gc_reset for the next allocations, the others go back to the system
+#define GC_MAX_SPARE_BLOCKS 16
+
 	struct GcObject;
 
-	struct GcBuffer {
-		intptr_t pos;
+	// inline header in front of every buffer handed out by GcState
+	struct GcChunkHeader {
+		uint32_t capacity;    // payload bytes of the chunk
+		uint32_t size;        // align8 of the requested size, what usedsize() accounts
+		uint32_t object_size; // sizeof each GcObject stored in the chunk, 0 for raw buffers
+		uint16_t size_class;
+		uint16_t flags;
+		int64_t legacy_pos;   // the buffer of the chunk in GcState::_legacy_accounting
+	};
+
+	struct GcBlock {
+		intptr_t start;
 		ptrdiff_t size;
-		bool isGcObj;
-		//bool isFree;
+		ptrdiff_t top; // end of the chunks carved so far
 	};
 
     class GcState {
 	private:
 		ptrdiff_t _total_malloced_blocks_size;
 		ptrdiff_t _used_size;
-		ptrdiff_t _max_gc_size;
-		std::shared_ptr<std::list<std::pair<intptr_t, ptrdiff_t> > > _malloced_blocks; // [ [start_ptr, size], ... ]
-		std::shared_ptr<std::map<intptr_t,GcBuffer>> _malloced_gcbuffers; // 
-		std::shared_ptr<std::list<std::pair<intptr_t, ptrdiff_t>>> _empty_small_buffers[DEFAULT_MAX_SMALL_BUFFER_SIZE]; //empty_size => [ [start_ptr, size], ... ]
-		std::shared_ptr<std::list<std::pair<intptr_t, ptrdiff_t>>> _empty_big_buffers; //order list, from small to big
+		uint64_t _malloc_count; // chunks handed out since the state was created
+		uint64_t _free_count;   // chunks given back by gc_free
+		std::vector<GcBlock> _blocks;      // arena blocks, chunks are carved from the last one
+		std::vector<GcBlock> _huge_blocks; // one block per buffer bigger than GC_MAX_CLASS_SIZE
+		GcChunkHeader* _free_chunks[GC_SIZE_CLASS_COUNT]; // freed chunks of each size class, linked through their payload
 		std::shared_ptr<std::list<std::pair<intptr_t, intptr_t> > > _malloced_str_blocks; // [ [start_ptr, size], ... ]
-		std::shared_ptr<std::map<unsigned int,std::pair<intptr_t, ptrdiff_t>>> _gc_strpool;
+		std::shared_ptr<std::unordered_map<unsigned int,std::vector<std::pair<intptr_t, ptrdiff_t>>>> _gc_strpool; // hash -> [string, size] in pooling order
+		// match pooled strings by their whole contents, see set_exact_string_pool
+		bool _exact_string_pool;
 		std::pair<intptr_t, ptrdiff_t>  _empty_str_buffer; // [start_ptr, size]
-		void insert_empty_buffer(std::pair<intptr_t, ptrdiff_t> &buf);
+		std::vector<intptr_t> _spare_blocks; // wiped blocks kept by gc_reset, not accounted as malloced
+		// the heap size limit is checked against the accounting of the old allocator, see GcLegacyAccounting
+		GcLegacyAccounting _legacy_accounting;
+		// [start, end) of the arena and huge blocks, sorted. gc_free only reads the header in front of
+		// a pointer inside one of them
+		std::vector<std::pair<intptr_t, intptr_t> > _chunk_ranges;
+
+		void* alloc_chunk(size_t size, size_t object_size);
+		void free_chunk(GcChunkHeader* chunk);
+		// the in use chunk p points to, nullptr for pointers GcState did not hand out or already freed
+		GcChunkHeader* owned_chunk(void* p) const;
+		void add_chunk_range(intptr_t start, ptrdiff_t size);
+		void remove_chunk_range(intptr_t start);
+		GcChunkHeader* carve_chunk(size_t size_class, size_t capacity);
+		GcChunkHeader* alloc_huge_chunk(size_t capacity);
+		void destroy_objects(GcChunkHeader* chunk);
+		void* malloc_block();
+		void keep_spare_block(intptr_t start);
 
 	public:
 		// @throws vmgc::GcException
@@ -54,14 +93,28 @@ namespace vmgc {
 		virtual ~GcState();
 
 		void* gc_malloc(size_t size, bool isGcObj=false);
+		// raw storage for count GcObjects of object_size bytes, the caller constructs them
+		void* gc_malloc_objects(size_t count, size_t object_size);
 		void gc_free(void* p);
 		void gc_free_array(void* p, size_t count, size_t element_size);
 		void* gc_realloc(void *p, size_t oldsize, size_t newsize);
 		void* gc_malloc_vector(size_t count, size_t element_size);
 		void* gc_grow_vector(void *p, size_t nelements, size_t* size, size_t element_size, size_t limit);
 		ptrdiff_t usedsize() const;
+		uint64_t malloc_count() const { return _malloc_count; }
+		uint64_t free_count() const { return _free_count; }
 		void gc_free_all();
-		void* gc_intern_strpool(size_t sz, size_t strsize, const char* str, bool* isNewStr);
+		// frees every object like gc_free_all but wipes and keeps the arena blocks for reuse.
+		// afterwards the state allocates and accounts exactly like a newly constructed one
+		void gc_reset();
+		// isUniqueStr is set to false for a new string whose contents are already pooled under another object
+		void* gc_intern_strpool(size_t sz, size_t strsize, const char* str, bool* isNewStr, bool* isUniqueStr);
+		// Before the EXACT_STRING_POOL fork the pool only kept the last string of each hash and handed it out
+		// whenever strncmp over the new string's length matched, so a colliding prefix or a string with an
+		// embedded '\0' got the pooled string back. That stays the default, the chain enables exact matching
+		// from the fork on. gc_reset goes back to the default
+		void set_exact_string_pool(bool exact) { _exact_string_pool = exact; }
+		bool exact_string_pool() const { return _exact_string_pool; }
 
 		template <typename T>
 		T* gc_new_object()
@@ -78,29 +131,23 @@ namespace vmgc {
 			return static_cast<T*>(obj_p);
 		}
 
+		// the objects share one chunk, gc_free/gc_free_array on the first one releases all of them
 		template <typename T>
 		T* gc_new_object_vector(size_t count)
 		{
 			if (count <= 0)
 				return nullptr;
 			size_t sz = sizeof(T);
-			std::vector<T*> malloced_items;
+			auto p = gc_malloc_objects(count, sz);
+			if (!p) {
+				return nullptr;
+			}
 			for (size_t i = 0; i < count; i++) {
-				auto p = gc_malloc(sz,true);
-				if (!p) {
-					for (const auto& item : malloced_items) {
-						gc_free(item);
-					}
-					return nullptr;
-				}
-				GcObject* obj_p = static_cast<GcObject*>(p);
+				GcObject* obj_p = static_cast<GcObject*>((T*)p + i);
 				new (obj_p)T();
 				obj_p->tt = T::type;
-				//_gc_objects->push_back((intptr_t)p - (intptr_t)_pstart);
-				T* t_p = static_cast<T*>(obj_p);
-				malloced_items.push_back(t_p);
 			}
-			return *(malloced_items.begin());
+			return static_cast<T*>(p);
 		}
 
 
@@ -137,7 +184,7 @@ namespace vmgc {
 			return new_p;
 		}
 
-		void fill_gc_string(GcObject* p, const char* str, size_t size);
+		void fill_gc_string(GcObject* p, const char* str, size_t size, bool interned = false);
 
 		// short string into str pool, reused
 		template <typename T>
@@ -145,16 +192,17 @@ namespace vmgc {
 		{
 			T* ts = nullptr;
 			bool isNewStr = true;
+			bool isUniqueStr = true;
 			if (size < DEFAULT_MAX_GC_SHORT_STRING_SIZE) { 
 				size_t sz = sizeof(T);
-				auto p = gc_intern_strpool(sz, size, str, &isNewStr);
+				auto p = gc_intern_strpool(sz, size, str, &isNewStr, &isUniqueStr);
 				if (!p) {
 					return nullptr;
 				}
 				GcObject* obj_p = static_cast<GcObject*>(p);
 				if (isNewStr) {
 					new (obj_p)T();
-					fill_gc_string(obj_p, str, size);
+					fill_gc_string(obj_p, str, size, isUniqueStr);
 					obj_p->tt = T::type;
 				}
 				ts = static_cast<T*>(obj_p);
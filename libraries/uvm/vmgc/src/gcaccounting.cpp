@@ -0,0 +1,269 @@
+#include "vmgc/gcaccounting.h"
+#include <algorithm>
+#include <cstring>
+
+namespace vmgc {
+#define GC_LEGACY_BLOCK_SIZE (1024*1024)
+// keeps replayed blocks apart, the old blocks came from malloc and were never adjacent
+#define GC_LEGACY_BLOCK_GAP 4096
+#define GC_LEGACY_TABLE_MIN_SLOTS 256
+
+	static size_t legacy_align8(size_t s) {
+		if ((s & 0x7) == 0)
+			return s;
+		return ((s >> 3) + 1) << 3;
+	}
+
+	size_t GcLegacyBufferTable::slot_of(intptr_t pos) const {
+		return (size_t)(((uint64_t)pos >> 3) * 0x9E3779B97F4A7C15ULL >> 20) & (_slots.size() - 1);
+	}
+
+	void GcLegacyBufferTable::grow() {
+		std::vector<Slot> old_slots(std::max<size_t>(_slots.size() * 2, GC_LEGACY_TABLE_MIN_SLOTS), Slot{ 0, 0 });
+		old_slots.swap(_slots);
+		for (const auto& slot : old_slots) {
+			if (!slot.pos)
+				continue;
+			auto i = slot_of(slot.pos);
+			while (_slots[i].pos)
+				i = (i + 1) & (_slots.size() - 1);
+			_slots[i] = slot;
+		}
+	}
+
+	void GcLegacyBufferTable::insert(intptr_t pos, ptrdiff_t size) {
+		if ((_count + 1) * 4 > _slots.size() * 3)
+			grow();
+		auto i = slot_of(pos);
+		while (_slots[i].pos && _slots[i].pos != pos)
+			i = (i + 1) & (_slots.size() - 1);
+		if (!_slots[i].pos)
+			_count++;
+		_slots[i].pos = pos;
+		_slots[i].size = size;
+	}
+
+	ptrdiff_t GcLegacyBufferTable::find(intptr_t pos) const {
+		if (_count == 0)
+			return 0;
+		for (auto i = slot_of(pos); _slots[i].pos; i = (i + 1) & (_slots.size() - 1)) {
+			if (_slots[i].pos == pos)
+				return _slots[i].size;
+		}
+		return 0;
+	}
+
+	ptrdiff_t GcLegacyBufferTable::erase(intptr_t pos) {
+		if (_count == 0)
+			return 0;
+		auto mask = _slots.size() - 1;
+		auto i = slot_of(pos);
+		while (_slots[i].pos != pos) {
+			if (!_slots[i].pos)
+				return 0;
+			i = (i + 1) & mask;
+		}
+		auto size = _slots[i].size;
+		_count--;
+		// backward shift, the following slots of the probe run move into the hole where they may
+		for (auto j = (i + 1) & mask; _slots[j].pos; j = (j + 1) & mask) {
+			auto home = slot_of(_slots[j].pos);
+			if (((j - home) & mask) >= ((j - i) & mask)) {
+				_slots[i] = _slots[j];
+				i = j;
+			}
+		}
+		_slots[i].pos = 0;
+		return size;
+	}
+
+	void GcLegacyBufferTable::clear() {
+		if (_count == 0)
+			return;
+		std::fill(_slots.begin(), _slots.end(), Slot{ 0, 0 });
+		_count = 0;
+	}
+
+	GcLegacyNodePool::~GcLegacyNodePool() {
+		for (auto p : _free_nodes)
+			::operator delete(p);
+	}
+
+	void* GcLegacyNodePool::allocate(size_t size) {
+		if (!_node_size)
+			_node_size = size;
+		if (size == _node_size && !_free_nodes.empty()) {
+			auto p = _free_nodes.back();
+			_free_nodes.pop_back();
+			return p;
+		}
+		return ::operator new(size);
+	}
+
+	void GcLegacyNodePool::deallocate(void* p, size_t size) {
+		if (size == _node_size)
+			_free_nodes.push_back(p);
+		else
+			::operator delete(p);
+	}
+
+	GcLegacyAccounting::GcLegacyAccounting(ptrdiff_t max_size)
+		: _max_size(max_size), _total_blocks_size(0), _next_block_pos(GC_LEGACY_BLOCK_GAP),
+		_empty_big_buffers(std::less<ptrdiff_t>(), BigBufferMap::allocator_type(&_big_buffer_nodes)), _empty_str_buffer_size(0) {
+		_biggest_empty_buffer.pos = 0;
+		_biggest_empty_buffer.size = 0;
+	}
+
+	void GcLegacyAccounting::insert_empty_buffer(intptr_t pos, ptrdiff_t size) {
+		if (size <= 0)
+			return;
+		if (size > GC_LEGACY_SMALL_BUFFER_SIZE || (size % 8) != 0) {
+			insert_big_buffer(pos, size);
+		}
+		else {
+			_empty_small_buffers[size / 8 - 1].push_back(pos);
+		}
+	}
+
+	void GcLegacyAccounting::insert_big_buffer(intptr_t pos, ptrdiff_t size) {
+		auto& biggest = _biggest_empty_buffer;
+		if (biggest.pos && size >= biggest.size) {
+			// the previous biggest one goes to the map, it is older than a new buffer of its size
+			BigBufferGroup group;
+			group.oldest = biggest.pos;
+			if (size == biggest.size)
+				group.newer.push_back(pos);
+			_empty_big_buffers.emplace(biggest.size, std::move(group));
+			biggest.pos = 0;
+			if (size == biggest.size)
+				return;
+		}
+		if (!biggest.pos && (_empty_big_buffers.empty() || size > _empty_big_buffers.rbegin()->first)) {
+			biggest.pos = pos;
+			biggest.size = size;
+			return;
+		}
+		auto it = _empty_big_buffers.find(size);
+		if (it != _empty_big_buffers.end()) {
+			it->second.newer.push_back(pos);
+			return;
+		}
+		BigBufferGroup group;
+		group.oldest = pos;
+		_empty_big_buffers.emplace(size, std::move(group));
+	}
+
+	GcLegacyAccounting::BigBuffer GcLegacyAccounting::take_big_buffer(bool smallest) {
+		BigBuffer result = _biggest_empty_buffer;
+		if (_empty_big_buffers.empty() || (!smallest && result.pos)) {
+			_biggest_empty_buffer.pos = 0;
+			return result;
+		}
+		auto it = smallest ? _empty_big_buffers.begin() : std::prev(_empty_big_buffers.end());
+		auto& group = it->second;
+		result.size = it->first;
+		if (group.newer.empty()) {
+			result.pos = group.oldest;
+			_empty_big_buffers.erase(it);
+		}
+		else if (smallest) {
+			result.pos = group.newer.back();
+			group.newer.pop_back();
+		}
+		else {
+			result.pos = group.oldest;
+			group.oldest = group.newer.front();
+			group.newer.erase(group.newer.begin());
+		}
+		return result;
+	}
+
+	intptr_t GcLegacyAccounting::malloc_buffer(size_t size) {
+		if (size <= 0)
+			return 0;
+		auto sz = (ptrdiff_t)legacy_align8(size);
+
+		if (sz <= GC_LEGACY_SMALL_BUFFER_SIZE) {
+			auto& buffers = _empty_small_buffers[sz / 8 - 1];
+			if (!buffers.empty()) {
+				auto pos = buffers.front();
+				buffers.pop_front();
+				_buffers.insert(pos, sz);
+				return pos;
+			}
+		}
+
+		// only the front (smallest, newest) and the back (biggest, oldest) of the list were tried
+		if (_biggest_empty_buffer.pos || !_empty_big_buffers.empty()) {
+			auto smallest_size = _empty_big_buffers.empty() ? _biggest_empty_buffer.size : _empty_big_buffers.begin()->first;
+			auto biggest_size = _biggest_empty_buffer.pos ? _biggest_empty_buffer.size : _empty_big_buffers.rbegin()->first;
+			if (sz <= biggest_size) {
+				auto buffer = take_big_buffer(sz <= smallest_size);
+				insert_empty_buffer(buffer.pos + sz, buffer.size - sz);
+				_buffers.insert(buffer.pos, sz);
+				return buffer.pos;
+			}
+		}
+
+		auto malloc_size = std::max<ptrdiff_t>(GC_LEGACY_BLOCK_SIZE, sz);
+		if (malloc_size + _total_blocks_size > _max_size)
+			return 0;
+		_total_blocks_size += malloc_size;
+		auto pos = _next_block_pos;
+		_next_block_pos += malloc_size + GC_LEGACY_BLOCK_GAP;
+		_buffers.insert(pos, sz);
+		insert_empty_buffer(pos + sz, malloc_size - sz);
+		return pos;
+	}
+
+	void GcLegacyAccounting::free_buffer(intptr_t pos) {
+		auto sz = _buffers.erase(pos);
+		insert_empty_buffer(pos, sz);
+	}
+
+	void GcLegacyAccounting::free_array(intptr_t pos, size_t count, size_t element_size) {
+		if (!pos || count <= 0)
+			return;
+		// no buffer starts inside the first one, the elements it covers need no lookup
+		auto covered = std::max<ptrdiff_t>(_buffers.find(pos), element_size);
+		free_buffer(pos);
+		for (size_t i = 1; i < count; i++) {
+			auto offset = (ptrdiff_t)(i * element_size);
+			if (offset < covered)
+				continue;
+			free_buffer(pos + offset);
+		}
+	}
+
+	bool GcLegacyAccounting::intern_string(size_t sz, unsigned int hash, const char* str, size_t strsize) {
+		// the old pool kept one string per hash and compared only up to the first '\0'
+		auto it = _strpool.find(hash);
+		if (it != _strpool.end() && strncmp(it->second.c_str(), str, strsize) == 0)
+			return true;
+		auto align8sz = (ptrdiff_t)legacy_align8(sz);
+		if (align8sz <= _empty_str_buffer_size) {
+			_empty_str_buffer_size -= align8sz;
+		}
+		else {
+			if (GC_LEGACY_BLOCK_SIZE + _total_blocks_size > _max_size)
+				return false;
+			_total_blocks_size += GC_LEGACY_BLOCK_SIZE;
+			if (align8sz < GC_LEGACY_BLOCK_SIZE)
+				_empty_str_buffer_size = GC_LEGACY_BLOCK_SIZE - align8sz;
+		}
+		_strpool[hash] = std::string(str, strsize);
+		return true;
+	}
+
+	void GcLegacyAccounting::reset() {
+		_buffers.clear();
+		for (auto& buffers : _empty_small_buffers)
+			buffers.clear();
+		_empty_big_buffers.clear();
+		_biggest_empty_buffer.pos = 0;
+		_strpool.clear();
+		_empty_str_buffer_size = 0;
+		_total_blocks_size = 0;
+	}
+
+}
@@ -8,48 +8,101 @@ namespace vmgc {
 
 //#define MAX_GC_BLOCKS_SIZE 500*1024*1024 
 
-	GcState::GcState(ptrdiff_t max_gc_size) {
-		this->_malloced_blocks = std::make_shared<std::list<std::pair<intptr_t, intptr_t> > >();
-		_total_malloced_blocks_size = 0;
-		_used_size = 0;
-		_max_gc_size = max_gc_size;
+#define GC_CHUNK_MAGIC 0xA500
+#define GC_CHUNK_MAGIC_MASK 0xFF00
+#define GC_CHUNK_IN_USE 0x01
+#define GC_CHUNK_GC_OBJECT 0x02
+#define GC_CHUNK_POOLED 0x04   // owned by the string pool, never freed one by one
+#define GC_CHUNK_HUGE 0x08     // the only chunk of its block
 
-		this->_malloced_gcbuffers = std::make_shared<std::map<intptr_t,GcBuffer>>();
+#define GC_CHUNK_HEADER_SIZE sizeof(GcChunkHeader)
+#define GC_HUGE_SIZE_CLASS 0xFFFF
 
-		for (int i = 0; i < DEFAULT_SMALL_BUFFER_VECTOR_SIZE; i++) {
-			_empty_small_buffers[i] = std::make_shared<std::list<std::pair<intptr_t, ptrdiff_t>>>();
-		}
+	static_assert(sizeof(GcChunkHeader) % 8 == 0, "gc chunk header must keep payloads 8 bytes aligned");
 
-		this->_empty_big_buffers = std::make_shared<std::list<std::pair<intptr_t, ptrdiff_t> >>();
+	static inline GcChunkHeader* chunk_of(void* p) {
+		return (GcChunkHeader*)((intptr_t)p - (intptr_t)GC_CHUNK_HEADER_SIZE);
+	}
+
+	static inline void* payload_of(GcChunkHeader* chunk) {
+		return (void*)((intptr_t)chunk + (intptr_t)GC_CHUNK_HEADER_SIZE);
+	}
+
+	// size must be align8 and > 0
+	static inline size_t size_class_of(size_t size) {
+		if (size <= GC_SMALL_CLASS_LIMIT)
+			return size / 8 - 1;
+		size_t k = 9; // 2^9 == GC_SMALL_CLASS_LIMIT
+		while ((size_t(1) << (k + 1)) <= size - 1)
+			k++;
+		size_t step = size_t(1) << (k - 2);
+		return GC_SMALL_CLASS_COUNT + (k - 9) * 4 + (size - 1 - (size_t(1) << k)) / step;
+	}
+
+	static inline size_t size_class_capacity(size_t size_class) {
+		if (size_class < GC_SMALL_CLASS_COUNT)
+			return (size_class + 1) * 8;
+		size_t m = size_class - GC_SMALL_CLASS_COUNT;
+		size_t k = 9 + m / 4;
+		return (size_t(1) << k) + (m % 4 + 1) * (size_t(1) << (k - 2));
+	}
+
+	GcState::GcState(ptrdiff_t max_gc_size) : _legacy_accounting(max_gc_size) {
+		_total_malloced_blocks_size = 0;
+		_used_size = 0;
+		_malloc_count = 0;
+		_free_count = 0;
+
+		memset(_free_chunks, 0x0, sizeof(_free_chunks));
 
 		//////////////////
 		this->_malloced_str_blocks = std::make_shared<std::list<std::pair<intptr_t, intptr_t>>>();
-		this->_gc_strpool = std::make_shared<std::map<unsigned int, std::pair<intptr_t, ptrdiff_t>>>();
+		this->_gc_strpool = std::make_shared<std::unordered_map<unsigned int, std::vector<std::pair<intptr_t, ptrdiff_t>>>>();
+		_exact_string_pool = false;
 
 		_empty_str_buffer.first = 0;
 		_empty_str_buffer.second = 0;
 	}
 
+	void GcState::destroy_objects(GcChunkHeader* chunk) {
+		if (!(chunk->flags & GC_CHUNK_GC_OBJECT) || chunk->object_size == 0)
+			return;
+		auto count = chunk->size / chunk->object_size;
+		auto p = (intptr_t)payload_of(chunk);
+		for (size_t i = 0; i < count; i++) {
+			auto gc_obj = (GcObject*)(p + i * chunk->object_size);
+			gc_obj->~GcObject();
+		}
+	}
+
 	void GcState::gc_free_all()
 	{
-		for (const auto& item : *_malloced_gcbuffers) {
-			if (item.second.isGcObj) {
-				auto gc_obj = (GcObject*)item.first;
-				gc_obj->~GcObject();
+		for (const auto& block : _blocks) {
+			auto pos = block.start;
+			while (pos < block.start + block.top) {
+				auto chunk = (GcChunkHeader*)pos;
+				if (chunk->flags & GC_CHUNK_IN_USE)
+					destroy_objects(chunk);
+				pos += GC_CHUNK_HEADER_SIZE + chunk->capacity;
 			}
+			free((void*)block.start);
 		}
-		_malloced_gcbuffers->clear();
-
-		for (int i = 0; i < DEFAULT_SMALL_BUFFER_VECTOR_SIZE; i++) {
-			_empty_small_buffers[i]->clear();
+		_blocks.clear();
+		for (const auto& block : _huge_blocks) {
+			auto chunk = (GcChunkHeader*)block.start;
+			if (chunk->flags & GC_CHUNK_IN_USE)
+				destroy_objects(chunk);
+			free((void*)block.start);
 		}
-
-		_empty_big_buffers->clear();
+		_huge_blocks.clear();
+		memset(_free_chunks, 0x0, sizeof(_free_chunks));
 
 		////////////////////////////////////
 		for (const auto& item : *_gc_strpool) {
-			auto gc_obj = (GcObject*)item.second.first;
-			gc_obj->~GcObject();
+			for (const auto& str : item.second) {
+				auto gc_obj = (GcObject*)str.first;
+				gc_obj->~GcObject();
+			}
 		}
 		_gc_strpool->clear();
 
@@ -58,21 +111,99 @@ namespace vmgc {
 
 		_used_size = 0;
 		_total_malloced_blocks_size = 0;
+		_legacy_accounting.reset();
+		_chunk_ranges.clear();
 	}
 
 
 	GcState::~GcState() {
 		gc_free_all();
 
-		for (const auto& item : (*_malloced_blocks)) {
+		for (const auto& item : (*_malloced_str_blocks)) {
 			free((void*)(item.first));
 		}
-		_malloced_blocks->clear();
+		_malloced_str_blocks->clear();
 
-		for (const auto& item : (*_malloced_str_blocks)) {
-			free((void*)(item.first));
+		for (auto start : _spare_blocks) {
+			free((void*)start);
+		}
+		_spare_blocks.clear();
+	}
+
+	void GcState::gc_reset()
+	{
+		for (const auto& block : _blocks) {
+			auto pos = block.start;
+			while (pos < block.start + block.top) {
+				auto chunk = (GcChunkHeader*)pos;
+				if (chunk->flags & GC_CHUNK_IN_USE)
+					destroy_objects(chunk);
+				pos += GC_CHUNK_HEADER_SIZE + chunk->capacity;
+			}
+			memset((void*)block.start, 0x0, block.top);
+			keep_spare_block(block.start);
+		}
+		_blocks.clear();
+		for (const auto& block : _huge_blocks) {
+			auto chunk = (GcChunkHeader*)block.start;
+			if (chunk->flags & GC_CHUNK_IN_USE)
+				destroy_objects(chunk);
+			free((void*)block.start);
+		}
+		_huge_blocks.clear();
+		memset(_free_chunks, 0x0, sizeof(_free_chunks));
+
+		for (const auto& item : *_gc_strpool) {
+			for (const auto& str : item.second) {
+				auto gc_obj = (GcObject*)str.first;
+				gc_obj->~GcObject();
+			}
+		}
+		_gc_strpool->clear();
+		for (const auto& item : *_malloced_str_blocks) {
+			auto used = item.second;
+			if (_empty_str_buffer.first >= item.first && _empty_str_buffer.first <= item.first + item.second)
+				used = _empty_str_buffer.first - item.first;
+			memset((void*)item.first, 0x0, used);
+			keep_spare_block(item.first);
 		}
 		_malloced_str_blocks->clear();
+
+		_empty_str_buffer.first = 0;
+		_empty_str_buffer.second = 0;
+
+		_used_size = 0;
+		_total_malloced_blocks_size = 0;
+		_malloc_count = 0;
+		_free_count = 0;
+		_legacy_accounting.reset();
+		_chunk_ranges.clear();
+		_exact_string_pool = false;
+	}
+
+	void GcState::keep_spare_block(intptr_t start) {
+		if (_spare_blocks.size() < GC_MAX_SPARE_BLOCKS)
+			_spare_blocks.push_back(start);
+		else
+			free((void*)start);
+	}
+
+	// a new DEFAULT_GC_BLOCK_SIZE block, wiped spare blocks are handed out before asking the system.
+	// the size limit is not checked here, _legacy_accounting decides before anything is carved
+	void* GcState::malloc_block() {
+		void* p = nullptr;
+		if (!_spare_blocks.empty()) {
+			p = (void*)_spare_blocks.back();
+			_spare_blocks.pop_back();
+		}
+		else {
+			p = malloc(DEFAULT_GC_BLOCK_SIZE);
+			if (!p) {
+				return nullptr;
+			}
+		}
+		_total_malloced_blocks_size += DEFAULT_GC_BLOCK_SIZE;
+		return p;
 	}
 
 	static size_t align8(size_t s) {
@@ -81,154 +212,188 @@ namespace vmgc {
 		return ((s >> 3) + 1) << 3;
 	}
 
-	void GcState::insert_empty_buffer(std::pair<intptr_t, ptrdiff_t> &buf) {
-		auto size = buf.second;
-		if (size > 0) {
-			if ((size > DEFAULT_MAX_SMALL_BUFFER_SIZE) || (size % 8) != 0) {
-				for (auto iter = _empty_big_buffers->begin(); iter != _empty_big_buffers->end(); iter++) {
-					if (size <= iter->second) {  //inserted
-						_empty_big_buffers->emplace(iter, buf);
-						return;
-					}
-				}
-				_empty_big_buffers->push_back(buf);
-			}
-			else {
-				_empty_small_buffers[(size / 8) - 1]->push_back(buf);
+	GcChunkHeader* GcState::carve_chunk(size_t size_class, size_t capacity) {
+		auto need = (ptrdiff_t)(GC_CHUNK_HEADER_SIZE + capacity);
+		if (_blocks.empty() || _blocks.back().size - _blocks.back().top < need) {
+			// the tail of the previous block is left unused
+			auto p = malloc_block();
+			if (!p) {
+				return nullptr;
 			}
+			GcBlock block;
+			block.start = (intptr_t)p;
+			block.size = DEFAULT_GC_BLOCK_SIZE;
+			block.top = 0;
+			_blocks.push_back(block);
+			add_chunk_range(block.start, block.size);
 		}
+		auto& block = _blocks.back();
+		auto chunk = (GcChunkHeader*)(block.start + block.top);
+		block.top += need;
+		chunk->capacity = (uint32_t)capacity;
+		chunk->size_class = (uint16_t)size_class;
+		return chunk;
 	}
 
-	void* GcState::gc_malloc(size_t size, bool isGcObj) {
-		if (size <= 0)
+	GcChunkHeader* GcState::alloc_huge_chunk(size_t capacity) {
+		auto mallocSize = (ptrdiff_t)(GC_CHUNK_HEADER_SIZE + capacity);
+		auto p = malloc(mallocSize);
+		if (!p) {
 			return nullptr;
-		size = align8(size);
+		}
+		_total_malloced_blocks_size += mallocSize;
+		GcBlock block;
+		block.start = (intptr_t)p;
+		block.size = mallocSize;
+		block.top = mallocSize;
+		_huge_blocks.push_back(block);
+		add_chunk_range(block.start, block.size);
+		auto chunk = (GcChunkHeader*)p;
+		chunk->capacity = (uint32_t)capacity;
+		chunk->size_class = GC_HUGE_SIZE_CLASS;
+		return chunk;
+	}
 
-		GcBuffer b;
-		b.isGcObj = isGcObj;
-		b.pos = 0;
-		b.size = size;
-		_used_size += size;
+	void* GcState::alloc_chunk(size_t size, size_t object_size) {
+		if (size <= 0 || size > UINT32_MAX - GC_CHUNK_HEADER_SIZE)
+			return nullptr;
+		size = align8(size);
 
-		//find _empty_small_buffers 
-		if (size <= DEFAULT_MAX_SMALL_BUFFER_SIZE) {
-			auto pbuffers = _empty_small_buffers[size/8 - 1];
-			if (!pbuffers->empty()) {  //finded
-				const auto& buf = pbuffers->front();
-				
-				b.pos = buf.first;
-				(*_malloced_gcbuffers)[buf.first] = b;
-				pbuffers->pop_front();
-				return (void*)b.pos;
+		GcChunkHeader* chunk = nullptr;
+		if (size <= GC_MAX_CLASS_SIZE) {
+			auto size_class = size_class_of(size);
+			chunk = _free_chunks[size_class];
+			if (chunk) {
+				_free_chunks[size_class] = *(GcChunkHeader**)payload_of(chunk);
 			}
-		}
-		
-		//find _empty_big_buffers  	
-		auto len = _empty_big_buffers->size();
-		if (len > 0) {
-			const auto &frontBuf = _empty_big_buffers->front();
-			if (size <= _empty_big_buffers->front().second) {
-				auto bufpos = frontBuf.first;
-				auto bufsz = frontBuf.second;
-				b.pos = bufpos;
-
-				_empty_big_buffers->pop_front();
-
-				if (size < bufsz) {
-					std::pair<intptr_t, ptrdiff_t> eb;
-					eb.first = bufpos + size;
-					eb.second = bufsz - size;
-					insert_empty_buffer(eb);
-				}
-
-				//_malloced_gcbuffers->insert(std::pair<intptr_t, GcBuffer>(frontBuf.first, b));
-				(*_malloced_gcbuffers)[bufpos] = b;
-				return (void*)b.pos;
+			else {
+				chunk = carve_chunk(size_class, size_class_capacity(size_class));
 			}
+		}
+		else {
+			chunk = alloc_huge_chunk(size);
+		}
+		if (!chunk)
+			return nullptr;
 
-			const auto &backBuf = _empty_big_buffers->back();
-			if (size <= backBuf.second) {
-				auto bufpos = backBuf.first;
-				auto bufsz = backBuf.second;
-				b.pos = bufpos;
-
-				_empty_big_buffers->pop_back();
-
-				if (size < bufsz) {
-					std::pair<intptr_t, ptrdiff_t> eb;
-					eb.first = bufpos + size;
-					eb.second = bufsz - size;
-					insert_empty_buffer(eb);
-				}
+		chunk->size = (uint32_t)size;
+		chunk->object_size = (uint32_t)object_size;
+		chunk->flags = GC_CHUNK_MAGIC | GC_CHUNK_IN_USE | (object_size > 0 ? GC_CHUNK_GC_OBJECT : 0);
+		if (chunk->size_class == GC_HUGE_SIZE_CLASS)
+			chunk->flags |= GC_CHUNK_HUGE;
+		_used_size += size;
+		_malloc_count++;
+		return payload_of(chunk);
+	}
 
-				(*_malloced_gcbuffers)[bufpos] = b;
-				return (void*)b.pos;
-			}
+	void* GcState::gc_malloc(size_t size, bool isGcObj) {
+		auto legacy_pos = _legacy_accounting.malloc_buffer(size);
+		if (!legacy_pos)
+			return nullptr;
+		auto p = alloc_chunk(size, isGcObj ? size : 0);
+		if (!p) {
+			_legacy_accounting.free_buffer(legacy_pos);
+			return nullptr;
 		}
+		chunk_of(p)->legacy_pos = legacy_pos;
+		return p;
+	}
 
-		//malloc new block
-		//check max size
-		auto mallocSize = DEFAULT_GC_BLOCK_SIZE;
-		if (size > DEFAULT_GC_BLOCK_SIZE) {
-			mallocSize = size;
-		}
-		if (mallocSize + _total_malloced_blocks_size > _max_gc_size) {
-			_used_size -= size;
+	void* GcState::gc_malloc_objects(size_t count, size_t object_size) {
+		if (count <= 0 || object_size <= 0)
 			return nullptr;
+		// the old allocator took a buffer for each object
+		std::vector<intptr_t> legacy_positions;
+		legacy_positions.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			auto legacy_pos = _legacy_accounting.malloc_buffer(object_size);
+			if (!legacy_pos)
+				break;
+			legacy_positions.push_back(legacy_pos);
 		}
-		auto p = malloc(mallocSize);
+		void* p = nullptr;
+		if (legacy_positions.size() == count)
+			p = alloc_chunk(count * object_size, object_size);
 		if (!p) {
-			_used_size -= size;
+			for (auto legacy_pos : legacy_positions)
+				_legacy_accounting.free_buffer(legacy_pos);
 			return nullptr;
 		}
-		_total_malloced_blocks_size += mallocSize;
-
-		std::pair<intptr_t, intptr_t> block;
-		block.first = (intptr_t)p;
-		block.second = mallocSize;
-		_malloced_blocks->push_back(block);
-
-		b.pos = (intptr_t)p;
-		(*_malloced_gcbuffers)[b.pos] = b;
-
-		if (size < mallocSize) {
-			//add empty buff
-			std::pair<intptr_t, ptrdiff_t> eb;
-			eb.first = (intptr_t)p + size;
-			eb.second = mallocSize - size;
-			insert_empty_buffer(eb);
-		}
-		return (void*)b.pos;
+		chunk_of(p)->legacy_pos = legacy_positions.front();
+		return p;
 	}
 
 	void GcState::gc_free(void* p) {
 		if (nullptr == p)
 			return;
-		if (_malloced_gcbuffers->find((intptr_t)p) != _malloced_gcbuffers->end()) {
-			auto buf = (*_malloced_gcbuffers)[(intptr_t)p];
-			if (buf.isGcObj) {
-				auto gc_obj = (GcObject*)p;
-				auto objtt = gc_obj->tt;
-				auto ntt = novariant(objtt);
-				gc_obj->~GcObject();
-			}
-			_malloced_gcbuffers->erase((intptr_t)p);  
+		// pointers not handed out by gc_malloc, already freed or owned by the string pool are ignored
+		auto chunk = owned_chunk(p);
+		if (!chunk)
+			return;
+		_legacy_accounting.free_buffer((intptr_t)chunk->legacy_pos);
+		free_chunk(chunk);
+	}
+
+	GcChunkHeader* GcState::owned_chunk(void* p) const {
+		auto addr = (intptr_t)p;
+		if (addr & 0x7)
+			return nullptr;
+		auto it = std::upper_bound(_chunk_ranges.begin(), _chunk_ranges.end(), std::make_pair(addr, INTPTR_MAX));
+		if (it == _chunk_ranges.begin())
+			return nullptr;
+		--it;
+		if (addr < it->first + (intptr_t)GC_CHUNK_HEADER_SIZE || addr >= it->second)
+			return nullptr;
+		auto chunk = chunk_of(p);
+		if ((chunk->flags & GC_CHUNK_MAGIC_MASK) != GC_CHUNK_MAGIC || !(chunk->flags & GC_CHUNK_IN_USE) || (chunk->flags & GC_CHUNK_POOLED))
+			return nullptr;
+		return chunk;
+	}
+
+	void GcState::add_chunk_range(intptr_t start, ptrdiff_t size) {
+		auto range = std::make_pair(start, start + size);
+		_chunk_ranges.insert(std::upper_bound(_chunk_ranges.begin(), _chunk_ranges.end(), range), range);
+	}
 
-			std::pair<intptr_t, ptrdiff_t> eb;
-			eb.first = buf.pos;
-			eb.second = buf.size;
-			insert_empty_buffer(eb);
-			_used_size -= buf.size;
+	void GcState::remove_chunk_range(intptr_t start) {
+		auto it = std::lower_bound(_chunk_ranges.begin(), _chunk_ranges.end(), std::make_pair(start, INTPTR_MIN));
+		if (it != _chunk_ranges.end() && it->first == start)
+			_chunk_ranges.erase(it);
+	}
+
+	void GcState::free_chunk(GcChunkHeader* chunk) {
+		destroy_objects(chunk);
+		_used_size -= chunk->size;
+		_free_count++;
+		chunk->flags = GC_CHUNK_MAGIC;
+
+		if (chunk->size_class == GC_HUGE_SIZE_CLASS) {
+			for (size_t i = 0; i < _huge_blocks.size(); i++) {
+				if (_huge_blocks[i].start != (intptr_t)chunk)
+					continue;
+				_total_malloced_blocks_size -= _huge_blocks[i].size;
+				_huge_blocks[i] = _huge_blocks.back();
+				_huge_blocks.pop_back();
+				remove_chunk_range((intptr_t)chunk);
+				free(chunk);
+				break;
+			}
+			return;
 		}
+		*(GcChunkHeader**)payload_of(chunk) = _free_chunks[chunk->size_class];
+		_free_chunks[chunk->size_class] = chunk;
 	}
 
 	void GcState::gc_free_array(void* p, size_t count, size_t size)
 	{
+		// arrays always live in a single chunk
 		if (!p || count <= 0)
 			return;
-		for (size_t i = 0; i < count; i++) {
-			gc_free((void*)((intptr_t)p + i * size));
-		}
+		auto chunk = owned_chunk(p);
+		if (!chunk)
+			return;
+		_legacy_accounting.free_array((intptr_t)chunk->legacy_pos, count, size);
+		free_chunk(chunk);
 	}
 
 	void* GcState::gc_realloc(void *p, size_t oldsz, size_t newsz) {
@@ -254,10 +419,23 @@ namespace vmgc {
 				//no op
 				return p;
 			}
+			auto chunk = owned_chunk(p);
+			if (chunk && !(chunk->flags & GC_CHUNK_GC_OBJECT) && align8(newsz) <= chunk->capacity) {
+				// grow in place, accounted as a new allocation replacing the old one.
+				// the old allocator always moved the buffer
+				auto legacy_pos = _legacy_accounting.malloc_buffer(newsz);
+				if (!legacy_pos)
+					return nullptr;
+				_legacy_accounting.free_buffer((intptr_t)chunk->legacy_pos);
+				chunk->legacy_pos = legacy_pos;
+				_used_size += align8(newsz) - chunk->size;
+				chunk->size = (uint32_t)align8(newsz);
+				return p;
+			}
 			newp = gc_malloc(newsz);
 			if (newp == nullptr)return nullptr;
 			//copy data
-			memcpy(newp, p, oldsz * sizeof(ptrdiff_t));
+			memcpy(newp, p, oldsz);
 			//free old 
 			gc_free(p);
 			return newp;
@@ -304,10 +482,11 @@ namespace vmgc {
 		return _used_size;
 	}
 
-	void GcState::fill_gc_string(GcObject* p, const char* str, size_t size) {
+	void GcState::fill_gc_string(GcObject* p, const char* str, size_t size, bool interned) {
 		auto sp = static_cast<uvm_types::GcString*>(p);
 		sp->value = std::string(str,size);
 		sp->tt = sp->tt_;
+		sp->interned = interned ? 1 : 0;
 	}
 
 	//ֳ֧С2^5hashڵڴֻϴʷײ
@@ -319,60 +498,79 @@ namespace vmgc {
 		return h;
 	}
 
-	void* GcState::gc_intern_strpool(size_t sz, size_t strsize, const char* str, bool* isNewStr) {
+	void* GcState::gc_intern_strpool(size_t sz, size_t strsize, const char* str, bool* isNewStr, bool* isUniqueStr) {
 		void* p = nullptr;
 		unsigned int seed = 1;
 		unsigned int h = gc_str_hash(str, strsize, seed);
+		if (!_legacy_accounting.intern_string(sz, h, str, strsize))
+			return nullptr;
 
-		auto it = _gc_strpool->find(h);
-		if (it == _gc_strpool->end()) {
-			*isNewStr = true;
+		*isNewStr = true;
+		*isUniqueStr = true;
+		auto& pooled = (*_gc_strpool)[h];
+		if (!_exact_string_pool && !pooled.empty()) {
+			// the old pool: only the last string of the hash, compared up to the new string's length and the first '\0'
+			uvm_types::GcString* last = (uvm_types::GcString*)pooled.back().first;
+			if (strncmp(last->value.c_str(), str, strsize) == 0) {
+				*isNewStr = false;
+				return (void*)pooled.back().first;
+			}
 		}
-		else {
-			*isNewStr = false;
-			p = (void *)((*_gc_strpool)[h].first);
-			uvm_types::GcString* gcstr = static_cast<uvm_types::GcString*>(p);
-			if (strncmp(gcstr->value.c_str(), str, strsize) != 0) { //ײ
-				//new it 
-				*isNewStr = true;
+		// equal strings share one pooled string in the exact pool. The old pool can pool the contents of
+		// an earlier string again, the new object is then not unique for luaS_eqlngstr
+		for (const auto& item : pooled) {
+			uvm_types::GcString* gcstr = (uvm_types::GcString*)item.first;
+			if (gcstr->value.size() == strsize && memcmp(gcstr->value.data(), str, strsize) == 0) {
+				if (_exact_string_pool) {
+					*isNewStr = false;
+					return (void*)item.first;
+				}
+				*isUniqueStr = false;
+				break;
 			}
 		}
 
 		if (*isNewStr) {
 			//add 
 			size_t align8sz = align8(sz);
+			// pooled strings carry a chunk header too so that gc_free can recognize and skip them
+			size_t chunksz = GC_CHUNK_HEADER_SIZE + align8sz;
+			GcChunkHeader* chunk = nullptr;
 
-			if (align8sz <= _empty_str_buffer.second) {
-				(*_gc_strpool)[h] = std::pair<intptr_t, ptrdiff_t>(_empty_str_buffer.first, align8sz);
-				p = (void*) _empty_str_buffer.first;
+			if ((ptrdiff_t)chunksz <= _empty_str_buffer.second) {
+				chunk = (GcChunkHeader*)_empty_str_buffer.first;
 
-				_empty_str_buffer.first = _empty_str_buffer.first + align8sz;
-				_empty_str_buffer.second = _empty_str_buffer.second - align8sz;
+				_empty_str_buffer.first = _empty_str_buffer.first + chunksz;
+				_empty_str_buffer.second = _empty_str_buffer.second - chunksz;
 
 			}
 			else {
 				//malloc new block
-				if (DEFAULT_GC_BLOCK_SIZE + _total_malloced_blocks_size > _max_gc_size) {
-					return nullptr;
-				}
-				p = malloc(DEFAULT_GC_BLOCK_SIZE);
+				p = malloc_block();
 				if (!p) {
 					return nullptr;
 				}
-				_total_malloced_blocks_size += DEFAULT_GC_BLOCK_SIZE;
 
 				std::pair<intptr_t, intptr_t> block;
 				block.first = (intptr_t)p;
 				block.second = DEFAULT_GC_BLOCK_SIZE;
 				_malloced_str_blocks->push_back(block);
 
-				(*_gc_strpool)[h] = std::pair<intptr_t, ptrdiff_t>((intptr_t)p, align8sz);
+				chunk = (GcChunkHeader*)p;
 
-				if (align8sz < DEFAULT_GC_BLOCK_SIZE) {
-					_empty_str_buffer.first = (intptr_t)p + align8sz;
-					_empty_str_buffer.second = DEFAULT_GC_BLOCK_SIZE - align8sz;
+				if (chunksz < DEFAULT_GC_BLOCK_SIZE) {
+					_empty_str_buffer.first = (intptr_t)p + chunksz;
+					_empty_str_buffer.second = DEFAULT_GC_BLOCK_SIZE - chunksz;
 				}
 			}
+			chunk->capacity = (uint32_t)align8sz;
+			chunk->size = (uint32_t)align8sz;
+			chunk->object_size = 0;
+			chunk->size_class = GC_HUGE_SIZE_CLASS;
+			chunk->flags = GC_CHUNK_MAGIC | GC_CHUNK_IN_USE | GC_CHUNK_POOLED;
+			chunk->legacy_pos = 0;
+			p = payload_of(chunk);
+			pooled.push_back(std::pair<intptr_t, ptrdiff_t>((intptr_t)p, align8sz));
 			_used_size += align8sz;
 		}
 		
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "vmgc/vmgc.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace vmgc;
+
+namespace {
+
+	// sizes of the objects a contract run allocates most: tables, closures, protos, upvalues, call infos
+	struct BenchTable : vmgc::GcObject
+	{
+		const static vmgc::gc_type type = 101;
+		char payload[120];
+	};
+
+	struct BenchClosure : vmgc::GcObject
+	{
+		const static vmgc::gc_type type = 102;
+		char payload[40];
+	};
+
+	// deterministic pseudo random sequence, no dependency on <random> engines
+	struct Lcg {
+		uint64_t state = 88172645463325252ULL;
+		uint32_t next() {
+			state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			return (uint32_t)(state >> 33);
+		}
+	};
+
+	// the calls the workload makes, on a GcState
+	struct GcStateHeap
+	{
+		typedef void* handle;
+		GcState& state;
+
+		explicit GcStateHeap(GcState& state) : state(state) {}
+		handle new_table() { return state.gc_new_object<BenchTable>(); }
+		handle new_closure() { return state.gc_new_object<BenchClosure>(); }
+		handle malloc(size_t size) { return state.gc_malloc(size); }
+		handle realloc(handle p, size_t oldsize, size_t newsize) { return state.gc_realloc(p, oldsize, newsize); }
+		handle grow_vector(handle p, size_t* size, size_t element_size) { return state.gc_grow_vector(p, *size, size, element_size, INT32_MAX); }
+		void free(handle p) { state.gc_free(p); }
+		void free_array(handle p, size_t count, size_t element_size) { state.gc_free_array(p, count, element_size); }
+		void end_call() {
+			BOOST_REQUIRE_EQUAL(state.usedsize(), 0);
+			state.gc_reset();
+		}
+	};
+
+	// the same calls on the accounting alone, which replays the old map based allocator for the heap limit.
+	// GcState makes these calls next to its own chunk allocation, so this is its share of the GcState time
+	struct LegacyAccountingHeap
+	{
+		typedef intptr_t handle;
+		GcLegacyAccounting accounting;
+
+		LegacyAccountingHeap() : accounting(DEFAULT_MAX_GC_HEAP_SIZE) {}
+		handle new_table() { return accounting.malloc_buffer(sizeof(BenchTable)); }
+		handle new_closure() { return accounting.malloc_buffer(sizeof(BenchClosure)); }
+		handle malloc(size_t size) { return accounting.malloc_buffer(size); }
+		handle realloc(handle p, size_t oldsize, size_t newsize) {
+			// growing in place or not, GcState accounts a new buffer replacing the old one
+			auto new_p = accounting.malloc_buffer(newsize);
+			if (p)
+				accounting.free_buffer(p);
+			return new_p;
+		}
+		handle grow_vector(handle p, size_t* size, size_t element_size) {
+			auto new_size = std::max<size_t>(*size * 2, GC_MINSIZEARRAY);
+			auto new_p = accounting.malloc_buffer(new_size * element_size);
+			if (p)
+				accounting.free_array(p, *size, element_size);
+			*size = new_size;
+			return new_p;
+		}
+		void free(handle p) { accounting.free_buffer(p); }
+		void free_array(handle p, size_t count, size_t element_size) { accounting.free_array(p, count, element_size); }
+		void end_call() { accounting.reset(); }
+	};
+
+	// one simulated contract call: a burst of short lived objects and buffers,
+	// a growing table array and a growing stack, then everything is released
+	template <typename Heap>
+	size_t run_contract_workload(Heap& heap, Lcg& rng, size_t objects)
+	{
+		typedef typename Heap::handle handle;
+		size_t ops = 0;
+		std::vector<handle> buffers;
+		std::vector<handle> tables;
+		std::vector<handle> closures;
+		buffers.reserve(objects);
+		tables.reserve(objects);
+		closures.reserve(objects);
+
+		size_t stack_size = 0;
+		auto stack = heap.grow_vector(handle(), &stack_size, 16);
+		handle array = handle();
+		size_t array_size = 0;
+
+		for (size_t i = 0; i < objects; i++) {
+			tables.push_back(heap.new_table());
+			closures.push_back(heap.new_closure());
+			buffers.push_back(heap.malloc(8 + rng.next() % 96));
+			ops += 3;
+			if (i % 8 == 0) {
+				auto new_size = array_size + 64;
+				array = heap.realloc(array, array_size, new_size);
+				array_size = new_size;
+				ops++;
+			}
+			if (i % 64 == 0 && stack_size < 1024) {
+				stack = heap.grow_vector(stack, &stack_size, 16);
+				ops++;
+			}
+			// call infos and temporaries die young
+			if (i % 3 == 0) {
+				auto idx = rng.next() % buffers.size();
+				heap.free(buffers[idx]);
+				buffers[idx] = buffers.back();
+				buffers.pop_back();
+				ops++;
+			}
+		}
+		for (auto p : buffers)
+			heap.free(p);
+		for (auto p : tables)
+			heap.free(p);
+		for (auto p : closures)
+			heap.free(p);
+		heap.free(array);
+		heap.free_array(stack, stack_size, 16);
+		ops += buffers.size() + tables.size() + closures.size() + 2;
+		return ops;
+	}
+
+	// nanoseconds per alloc/free op over all calls. every contract call starts on a reset heap, the size
+	// limit follows the old allocator which never merged free buffers and would run out of memory over many calls
+	template <typename Heap>
+	double run_contract_calls(Heap& heap, size_t calls, size_t objects_per_call)
+	{
+		Lcg rng;
+		size_t ops = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < calls; i++) {
+			ops += run_contract_workload(heap, rng, objects_per_call);
+			heap.end_call();
+		}
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		return (double)elapsed / ops;
+	}
+
+}
+
+BOOST_AUTO_TEST_SUITE(vmgc_bench_suite)
+
+BOOST_AUTO_TEST_CASE(gcstate_contract_workload_bench)
+{
+#ifdef NDEBUG
+	const size_t calls = 2000;
+#else
+	const size_t calls = 200;
+#endif
+	const size_t objects_per_call = 2000;
+
+	GcState state;
+	GcStateHeap state_heap(state);
+	auto state_ns = run_contract_calls(state_heap, calls, objects_per_call);
+	std::cout << "gc_state: " << state_ns << " ns/op" << std::endl;
+
+	LegacyAccountingHeap accounting_heap;
+	auto accounting_ns = run_contract_calls(accounting_heap, calls, objects_per_call);
+	std::cout << "of that the old allocator accounting: " << accounting_ns << " ns/op ("
+		<< (int)(100 * accounting_ns / state_ns) << "%)" << std::endl;
+
+	// the same allocation pattern straight on the system allocator, for reference
+	Lcg sys_rng;
+	size_t sys_ops = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < calls; i++) {
+		std::vector<void*> ptrs;
+		ptrs.reserve(objects_per_call * 3);
+		for (size_t j = 0; j < objects_per_call; j++) {
+			ptrs.push_back(malloc(sizeof(BenchTable)));
+			ptrs.push_back(malloc(sizeof(BenchClosure)));
+			ptrs.push_back(malloc(8 + sys_rng.next() % 96));
+		}
+		for (auto p : ptrs)
+			free(p);
+		sys_ops += ptrs.size() * 2;
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "malloc/free: " << (double)elapsed / sys_ops << " ns/op" << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(gcstate_accounting_test)
+{
+	GcState state;
+	auto p1 = state.gc_malloc(10);
+	auto p2 = state.gc_malloc(1000);
+	auto p3 = state.gc_malloc(2 * GC_MAX_CLASS_SIZE);
+	BOOST_CHECK_EQUAL(state.usedsize(), 16 + 1000 + 2 * GC_MAX_CLASS_SIZE);
+	state.gc_free(p2);
+	state.gc_free(p2); // double free is ignored
+	BOOST_CHECK_EQUAL(state.usedsize(), 16 + 2 * GC_MAX_CLASS_SIZE);
+	// freed chunks of the same size class are reused first
+	BOOST_CHECK(state.gc_malloc(1000) == p2);
+	state.gc_free(p3);
+	state.gc_free(p2);
+	state.gc_free(p1);
+	BOOST_CHECK_EQUAL(state.usedsize(), 0);
+
+	// the heap limit still holds
+	GcState small_state(2 * 1024 * 1024);
+	std::vector<void*> ptrs;
+	void* p = nullptr;
+	while ((p = small_state.gc_malloc(4096)) != nullptr)
+		ptrs.push_back(p);
+	BOOST_CHECK(!ptrs.empty());
+	BOOST_CHECK(ptrs.size() * 4096 <= 2 * 1024 * 1024);
+	BOOST_CHECK(small_state.gc_malloc(4 * 1024 * 1024) == nullptr);
+	for (auto item : ptrs)
+		small_state.gc_free(item);
+	BOOST_CHECK_EQUAL(small_state.usedsize(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -92,4 +92,68 @@ BOOST_AUTO_TEST_CASE(gc_grow_vector)
 	state.gc_free_array(p4, count4, sizeof(GcString));
 }
 
+BOOST_AUTO_TEST_CASE(gc_reset_test)
+{
+	GcState state(4 * 1024 * 1024);
+	size_t first_count = 0;
+	while (state.gc_malloc(4096))
+		first_count++;
+	auto p = state.gc_new_object<GcString>();
+	BOOST_CHECK(p == nullptr);
+
+	state.gc_reset();
+	BOOST_CHECK(state.usedsize() == 0);
+	BOOST_CHECK(state.malloc_count() == 0);
+	BOOST_CHECK(state.free_count() == 0);
+
+	// the wiped blocks are reused and the size limit counts them like new ones
+	auto first = (int64_t*)state.gc_malloc(sizeof(int64_t));
+	BOOST_CHECK(*first == 0);
+	size_t second_count = 1;
+	while (state.gc_malloc(4096))
+		second_count++;
+	BOOST_CHECK(second_count == first_count);
+}
+
+BOOST_AUTO_TEST_CASE(gc_free_foreign_pointer_test)
+{
+	GcState state;
+	auto p = state.gc_malloc(64);
+	auto used = state.usedsize();
+
+	int64_t on_stack[4] = { 0 };
+	std::unique_ptr<int64_t[]> on_heap(new int64_t[1]());
+	state.gc_free(on_stack + 2);
+	state.gc_free(on_heap.get());
+	state.gc_free((char*)p + 8);
+	BOOST_CHECK(state.usedsize() == used);
+	BOOST_CHECK(state.free_count() == 0);
+
+	state.gc_free(p);
+	state.gc_free(p);
+	BOOST_CHECK(state.usedsize() == 0);
+	BOOST_CHECK(state.free_count() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(size_limit_legacy_accounting_test)
+{
+	// the old allocator packed 520 byte buffers back to back into 1MB blocks. the chunks of their
+	// size class are bigger, the limit must still be hit after the same number of buffers
+	GcState state(4 * 1024 * 1024);
+	size_t count = 0;
+	while (state.gc_malloc(520))
+		count++;
+	BOOST_CHECK(count == 4 * ((1024 * 1024) / 520));
+
+	// freed buffers are reused before the limit is checked again
+	state.gc_reset();
+	std::vector<void*> buffers;
+	for (size_t i = 0; i < count; i++)
+		buffers.push_back(state.gc_malloc(520));
+	BOOST_CHECK(state.gc_malloc(520) == nullptr);
+	state.gc_free(buffers.back());
+	BOOST_CHECK(state.gc_malloc(520) != nullptr);
+	BOOST_CHECK(state.gc_malloc(520) == nullptr);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/protocol/protocol.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+/// Pushes signed transfers between funded accounts through database::push_transaction with every check
+/// on. Each transaction runs in its own undo session that is merged into the pending session, and every
+/// block undoes the pending session and applies the transactions again.
+BOOST_FIXTURE_TEST_CASE( undo_session_transfer_bench, database_fixture )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t blocks = 50;
+#else
+      const uint32_t blocks = 5;
+#endif
+      const uint32_t trx_per_block = 1000;
+      const uint32_t account_count = 200;
+
+      operation sample = transfer_operation();
+      const share_type fee = db.current_fee_schedule().calculate_fee( sample ).amount;
+      const share_type sends_per_account = blocks * trx_per_block / account_count + 1;
+
+      vector<fc::ecc::private_key> keys;
+      vector<account_id_type> accounts;
+      for( uint32_t i = 0; i < account_count; ++i )
+      {
+         const string name = "bench" + fc::to_string( i );
+         keys.push_back( generate_private_key( name ) );
+         accounts.push_back( create_account( name, keys.back().get_public_key() ).id );
+         fund( accounts.back()( db ), asset( sends_per_account * ( fee + trx_per_block ) ) );
+      }
+      generate_block();
+
+      fc::microseconds push_time;
+      fc::microseconds block_time;
+      for( uint32_t b = 0; b < blocks; ++b )
+      {
+         // signing is the wallet's work, the batch is built against the current head before the clock starts
+         vector<signed_transaction> batch;
+         batch.reserve( trx_per_block );
+         for( uint32_t t = 0; t < trx_per_block; ++t )
+         {
+            const uint32_t from = ( b * trx_per_block + t ) % account_count;
+            const uint32_t to = ( from + 1 + t % ( account_count - 1 ) ) % account_count;
+            const account_object& from_account = accounts[from]( db );
+            const account_object& to_account = accounts[to]( db );
+            transfer_operation op;
+            op.from = from_account.id;
+            op.to = to_account.id;
+            op.from_addr = from_account.addr;
+            op.to_addr = to_account.addr;
+            // distinct amounts keep the transactions of a batch apart for the dupe check
+            op.amount = asset( 1 + t );
+            signed_transaction tx;
+            tx.operations.push_back( op );
+            for( auto& o : tx.operations )
+               db.current_fee_schedule().set_fee( o );
+            set_expiration( db, tx );
+            tx.validate();
+            sign( tx, keys[from] );
+            batch.push_back( std::move( tx ) );
+         }
+
+         auto start_time = fc::time_point::now();
+         for( const auto& tx : batch )
+            db.push_transaction( tx );
+         auto pushed_time = fc::time_point::now();
+         auto block = generate_block();
+         block_time += fc::time_point::now() - pushed_time;
+         push_time += pushed_time - start_time;
+         BOOST_CHECK_EQUAL( block.transactions.size(), trx_per_block );
+      }
+      verify_asset_supplies( db );
+
+      const uint64_t transactions = uint64_t( blocks ) * trx_per_block;
+      ilog( "Pushed ${n} signed transfers in ${ms} milliseconds, ${tps} transactions per second. Applying them in ${b} blocks took ${bms} milliseconds.",
+            ("n", transactions)("ms", push_time.count() / 1000)
+            ("tps", transactions * 1000000 / std::max<int64_t>( push_time.count(), 1 ))
+            ("b", blocks)("bms", block_time.count() / 1000) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+#include <graphene/db/undo_database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/io/json.hpp>
+
+using namespace graphene::chain;
+using namespace graphene::db;
+
+namespace {
+
+/// Builds an undo state shaped like a block full of transfers: every transaction
+/// touches two balances and the account of its payer.
+void fill_block_undo_state( undo_state& state, uint32_t block_num, uint32_t trx_count )
+{
+   for( uint32_t i = 0; i < trx_count; ++i )
+   {
+      account_balance_object from;
+      from.id = account_balance_id_type( block_num * trx_count * 2 + i * 2 );
+      from.owner = account_id_type( i );
+      from.balance = 1000000 + i;
+      state.old_values[from.id] = from.clone();
+
+      account_balance_object to = from;
+      to.id = account_balance_id_type( block_num * trx_count * 2 + i * 2 + 1 );
+      to.owner = account_id_type( i + 1 );
+      state.old_values[to.id] = to.clone();
+
+      account_object acct;
+      acct.id = account_id_type( i );
+      acct.name = "account-" + fc::to_string( i );
+      state.old_values[acct.id] = acct.clone();
+   }
+   state.new_ids.insert( account_balance_id_type( (block_num + 1) * trx_count * 2 ) );
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( undo_storage_commit_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t blocks = 2000;
+#else
+      const uint32_t blocks = 200;
+#endif
+      const uint32_t trx_per_block = 100;
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      undo_storage storage;
+      storage.open( data_dir.path() / "undo" );
+
+      std::deque<undo_state> states( blocks );
+      for( uint32_t i = 0; i < blocks; ++i )
+         fill_block_undo_state( states[i], i, trx_per_block );
+
+      // legacy JSON encoding, as written by undo_storage before GRAPHENE_UNDO_STATE_FORMAT_VERSION
+      std::vector<undo_state_id_type> json_ids;
+      auto start_time = fc::time_point::now();
+      for( const auto& sta : states )
+      {
+         auto obj = sta.get_serializable_undo_state();
+         auto id = obj.undo_id();
+         storage.store( id, obj );
+         json_ids.push_back( id );
+      }
+      auto json_store = fc::time_point::now() - start_time;
+
+      start_time = fc::time_point::now();
+      for( const auto& id : json_ids )
+      {
+         undo_state sta;
+         BOOST_REQUIRE( storage.get_state( id, sta ) );
+      }
+      auto json_load = fc::time_point::now() - start_time;
+
+      std::vector<undo_state_id_type> raw_ids;
+      start_time = fc::time_point::now();
+      for( const auto& sta : states )
+         raw_ids.push_back( storage.store_undo_state( sta ) );
+      auto raw_store = fc::time_point::now() - start_time;
+
+      start_time = fc::time_point::now();
+      for( const auto& id : raw_ids )
+      {
+         undo_state sta;
+         BOOST_REQUIRE( storage.get_state( id, sta ) );
+         BOOST_CHECK_EQUAL( sta.old_values.size(), trx_per_block * 3 );
+      }
+      auto raw_load = fc::time_point::now() - start_time;
+
+      ilog( "undo commit per block: json ${js} us store / ${jl} us load, fc::raw ${rs} us store / ${rl} us load",
+            ("js", json_store.count() / blocks)("jl", json_load.count() / blocks)
+            ("rs", raw_store.count() / blocks)("rl", raw_load.count() / blocks) );
+
+      start_time = fc::time_point::now();
+      BOOST_CHECK_EQUAL( storage.migrate_legacy_states(), blocks );
+      ilog( "Migrated ${c} legacy undo states in ${t} milliseconds.",
+            ("c", blocks)("t", (fc::time_point::now() - start_time).count() / 1000) );
+      BOOST_CHECK_EQUAL( storage.migrate_legacy_states(), 0u );
+
+      // the format marker is set, so a reopened store is not scanned again;
+      // a JSON state written after that stays readable as is
+      auto late = states.front().get_serializable_undo_state();
+      storage.store( late.undo_id(), late );
+      storage.close();
+      storage.open( data_dir.path() / "undo" );
+      BOOST_CHECK_EQUAL( storage.migrate_legacy_states(), 0u );
+      {
+         undo_state sta;
+         BOOST_REQUIRE( storage.get_state( late.undo_id(), sta ) );
+      }
+
+      for( const auto& id : json_ids )
+      {
+         undo_state sta;
+         BOOST_REQUIRE( storage.get_state( id, sta ) );
+         BOOST_CHECK_EQUAL( sta.old_values.size(), trx_per_block * 3 );
+      }
+      storage.close();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
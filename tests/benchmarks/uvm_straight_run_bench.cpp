@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/uvm_chain_api.hpp>
+
+#include <uvm/lua.h>
+#include <uvm/lauxlib.h>
+#include <uvm/lstate.h>
+#include <uvm/uvm_lib.h>
+
+#include <fc/time.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace uvm::lua::lib;
+
+namespace {
+
+/// A loop whose body is mostly straight-line code: MOVE, LOADK, LOADBOOL, LOADNIL, NOT, JMP, TEST and TESTSET.
+const char* straight_code = R"(
+local x = 0
+for i = 1, 2000000 do
+   local a = 1
+   local b = a
+   local c = not b
+   local d = c or b
+   local e, f, g
+   if c then a = 2 else b = 3 end
+   local h = d and a
+   local k = true
+   x = h
+end
+return x
+)";
+
+/// A loop without a straight run longer than one instruction, it measures what the run lookup costs.
+const char* mixed_code = R"(
+local t = {}
+local s = 0
+for i = 1, 2000000 do
+   t[i % 64] = i
+   s = s + t[i % 64] * 2
+end
+return s
+)";
+
+int64_t run_code( const char* code, bool straight_runs, int& instructions )
+{
+   lua_State* L = create_lua_state( false );
+   L->disable_straight_runs = !straight_runs;
+   auto start_time = fc::time_point::now();
+   BOOST_REQUIRE_EQUAL( luaL_dostring( L, code ), 0 );
+   auto elapsed = fc::time_point::now() - start_time;
+   instructions = get_lua_state_instructions_executed_count( L );
+   close_lua_state( L );
+   return elapsed.count();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( uvm_straight_run_bench )
+{
+   if( !uvm::lua::api::global_uvm_chain_api )
+      uvm::lua::api::global_uvm_chain_api = new graphene::chain::UvmChainApi();
+
+   const uint32_t rounds = 5;
+   const char* names[] = { "straight", "mixed" };
+   const char* codes[] = { straight_code, mixed_code };
+   for( int c = 0; c < 2; ++c )
+   {
+      int64_t best_off = INT64_MAX, best_on = INT64_MAX;
+      int instructions_off = 0, instructions_on = 0;
+      // interleaved, so that noise on the machine hits both alike
+      for( uint32_t i = 0; i < rounds; ++i )
+      {
+         best_off = std::min( best_off, run_code( codes[c], false, instructions_off ) );
+         best_on = std::min( best_on, run_code( codes[c], true, instructions_on ) );
+      }
+      BOOST_CHECK_EQUAL( instructions_off, instructions_on );
+      ilog( "${n} loop of ${i} instructions: straight runs off ${off} ms, on ${on} ms (best of ${r})",
+            ("n", names[c])("i", instructions_on)("off", best_off / 1000)("on", best_on / 1000)("r", rounds) );
+   }
+}
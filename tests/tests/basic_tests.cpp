@@ -410,4 +410,24 @@ BOOST_AUTO_TEST_CASE( merkle_root )
    BOOST_CHECK( block.calculate_merkle_root() == c(dO) );
 }
 
+BOOST_AUTO_TEST_CASE( signature_keys_cache )
+{
+   auto alice_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "alice" ) ) );
+   auto bob_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "bob" ) ) );
+   const chain_id_type& chain_id = db.get_chain_id();
+
+   signed_transaction trx;
+   trx.operations.emplace_back( transfer_operation() );
+   trx.sign( alice_key, chain_id );
+   trx.cache_signature_keys( chain_id );
+   BOOST_CHECK( trx.get_signature_keys( chain_id ) == flat_set<public_key_type>{ alice_key.get_public_key() } );
+
+   // same transaction and digest, only the signature changes
+   trx.signatures.clear();
+   trx.sign( bob_key, chain_id );
+   BOOST_CHECK( trx.get_signature_keys( chain_id ) == flat_set<public_key_type>{ bob_key.get_public_key() } );
+   trx.cache_signature_keys( chain_id );
+   BOOST_CHECK( trx.get_signature_keys( chain_id ) == flat_set<public_key_type>{ bob_key.get_public_key() } );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
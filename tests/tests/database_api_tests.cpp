@@ -24,10 +24,13 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <graphene/app/api.hpp>
 #include <graphene/app/database_api.hpp>
 
 #include "../common/database_fixture.hpp"
 
+#include <mutex>
+
 using namespace graphene::chain;
 using namespace graphene::chain::test;
 
@@ -68,4 +71,171 @@ BOOST_FIXTURE_TEST_SUITE(database_api_tests, database_fixture)
       } FC_LOG_AND_RETHROW()
   }
 
+
+  BOOST_AUTO_TEST_CASE(transaction_history_pages) {
+      try {
+          // the index is registered by the transaction plugin, which the fixture does not load
+          db.add_index< primary_index<history_transaction_index> >();
+          const address alice( generate_private_key("alice").get_public_key() );
+          const address bob( generate_private_key("bob").get_public_key() );
+          auto add_history = [&]( const address& addr, uint32_t block_num ) {
+             db.create<history_transaction_object>( [&]( history_transaction_object& obj ) {
+                obj.addr = addr;
+                obj.block_num = block_num;
+             });
+          };
+          for( int i = 0; i < 3; ++i ) add_history( alice, 10 );
+          for( int i = 0; i < 2; ++i ) add_history( bob, 10 );
+          for( int i = 0; i < 2; ++i ) add_history( alice, 11 );
+          add_history( bob, 11 );
+          for( int i = 0; i < 4; ++i ) add_history( alice, 12 );
+          add_history( bob, 14 );
+
+          graphene::app::transaction_api trx_api( app );
+          // every page of at most limit entries, one more block of history arrives after the first page
+          auto all_pages = [&]( const std::function<graphene::app::transaction_history_page(optional<graphene::app::transaction_history_cursor>)>& fetch,
+                                uint32_t limit ) {
+             vector<object_id_type> ids;
+             optional<graphene::app::transaction_history_cursor> cursor;
+             bool first = true;
+             do {
+                auto page = fetch( cursor );
+                BOOST_CHECK( !page.entries.empty() );
+                BOOST_CHECK( page.entries.size() <= limit );
+                for( const auto& entry : page.entries )
+                   ids.push_back( entry.id );
+                cursor = page.next;
+                if( first )
+                {
+                   add_history( alice, 13 );
+                   add_history( bob, 13 );
+                   first = false;
+                }
+             } while( cursor.valid() );
+             return ids;
+          };
+          auto expected = [&]( const fc::optional<address>& addr, uint32_t start_block, uint32_t end_block ) {
+             vector<object_id_type> ids;
+             for( const auto& obj : db.get_index_type<history_transaction_index>().indices().get<by_block_num>() )
+                if( obj.block_num >= start_block && obj.block_num <= end_block && ( !addr.valid() || obj.addr == *addr ) )
+                   ids.push_back( obj.id );
+             return ids;
+          };
+
+          for( uint32_t limit : { 1, 2, 3, 5 } )
+          {
+             auto ids = all_pages( [&]( optional<graphene::app::transaction_history_cursor> after ) {
+                return trx_api.list_transactions_page( 10, 13, limit, after );
+             }, limit );
+             BOOST_CHECK( ids == expected( fc::optional<address>(), 10, 13 ) );
+             std::set<object_id_type> unique_ids( ids.begin(), ids.end() );
+             BOOST_CHECK_EQUAL( unique_ids.size(), ids.size() );
+
+             ids = all_pages( [&]( optional<graphene::app::transaction_history_cursor> after ) {
+                return trx_api.list_address_transactions( alice, 11, 13, limit, after );
+             }, limit );
+             BOOST_CHECK( ids == expected( alice, 11, 13 ) );
+             unique_ids = std::set<object_id_type>( ids.begin(), ids.end() );
+             BOOST_CHECK_EQUAL( unique_ids.size(), ids.size() );
+          }
+
+          GRAPHENE_REQUIRE_THROW( trx_api.list_transactions_page( 10, 13, 0, optional<graphene::app::transaction_history_cursor>() ), fc::exception );
+          GRAPHENE_REQUIRE_THROW( trx_api.list_address_transactions( alice, 10, 13, 0, optional<graphene::app::transaction_history_cursor>() ), fc::exception );
+          GRAPHENE_REQUIRE_THROW( trx_api.list_transactions_page( 10, 13, 1001, optional<graphene::app::transaction_history_cursor>() ), fc::exception );
+      } FC_LOG_AND_RETHROW()
+  }
+
+
+  BOOST_AUTO_TEST_CASE(coalesce_subscription_updates) {
+      try {
+          std::deque<vector<variant>> batches( 3 );
+          batches[0].push_back( fc::mutable_variant_object( "id", "1.2.5" )( "name", "a" )( "balance", 1 ) );
+          batches[0].push_back( fc::mutable_variant_object( "id", "1.2.6" )( "name", "b" ) );
+          batches[0].push_back( fc::mutable_variant_object( "id", "1.2.7" )( "delta", fc::mutable_variant_object( "balance", 3 ) ) );
+          batches[1].push_back( fc::mutable_variant_object( "id", "1.2.5" )( "delta", fc::mutable_variant_object( "balance", 2 ) ) );
+          batches[1].push_back( variant( "1.2.6" ) );
+          batches[1].push_back( fc::mutable_variant_object( "id", "1.2.7" )( "delta", fc::mutable_variant_object( "name", "c" ) ) );
+          batches[2].push_back( fc::mutable_variant_object( "id", "1.2.5" )( "delta", fc::mutable_variant_object( "name", "d" ) ) );
+          batches[2].push_back( fc::mutable_variant_object( "id", "1.2.8" )( "name", "e" ) );
+
+          auto merged = graphene::app::coalesce_subscription_updates( batches );
+          BOOST_REQUIRE_EQUAL( merged.size(), 4u );
+          // a delta folds into the queued full object, which stays a full object in its first position
+          const auto& first = merged[0].get_object();
+          BOOST_CHECK_EQUAL( first["id"].as_string(), "1.2.5" );
+          BOOST_CHECK( !first.contains( "delta" ) );
+          BOOST_CHECK_EQUAL( first["balance"].as_int64(), 2 );
+          BOOST_CHECK_EQUAL( first["name"].as_string(), "d" );
+          // a removal replaces the queued object
+          BOOST_CHECK_EQUAL( merged[1].as_string(), "1.2.6" );
+          // deltas fold into one delta
+          const auto& third = merged[2].get_object();
+          BOOST_CHECK_EQUAL( third["id"].as_string(), "1.2.7" );
+          BOOST_CHECK_EQUAL( third["delta"].get_object()["balance"].as_int64(), 3 );
+          BOOST_CHECK_EQUAL( third["delta"].get_object()["name"].as_string(), "c" );
+          BOOST_CHECK_EQUAL( merged[3].get_object()["name"].as_string(), "e" );
+      } FC_LOG_AND_RETHROW()
+  }
+
+  BOOST_AUTO_TEST_CASE(subscription_deltas) {
+      try {
+          const object_id_type dgp_id = dynamic_global_property_id_type();
+          // the callbacks run on the delivery thread
+          std::mutex received_mutex;
+          // notifications of the dynamic global properties, other objects may pass the bloom filter
+          auto subscribe = [&dgp_id, &received_mutex]( graphene::app::database_api& api, vector<variant>& received ) {
+             api.set_subscribe_callback( [&dgp_id, &received_mutex, &received]( const variant& updates ) {
+                std::lock_guard<std::mutex> lock( received_mutex );
+                for( const auto& update : updates.get_array() )
+                   if( update.is_object() && update.get_object()["id"].as<object_id_type>() == dgp_id )
+                      received.push_back( update );
+             }, false );
+             api.get_objects( { dgp_id } );
+          };
+          auto received_count = [&received_mutex]( const vector<variant>& received ) {
+             std::lock_guard<std::mutex> lock( received_mutex );
+             return received.size();
+          };
+          auto wait_for = [&received_count]( const vector<variant>& received, size_t count ) {
+             for( int i = 0; i < 100 && received_count( received ) < count; ++i )
+                fc::usleep( fc::milliseconds( 10 ) );
+             BOOST_REQUIRE_EQUAL( received_count( received ), count );
+          };
+
+          graphene::app::database_api early_api( db ), late_api( db ), full_api( db );
+          vector<variant> early, late, full;
+          subscribe( early_api, early );
+          subscribe( late_api, late );
+          subscribe( full_api, full );
+          early_api.set_subscription_deltas( true );
+
+          generate_block();
+          wait_for( early, 1 );
+          wait_for( late, 1 );
+          wait_for( full, 1 );
+          // nothing was sent to the session in delta mode before, it gets the whole object
+          BOOST_CHECK( !early[0].get_object().contains( "delta" ) );
+          BOOST_CHECK_EQUAL( early[0]["head_block_number"].as_uint64(), db.head_block_num() );
+
+          late_api.set_subscription_deltas( true );
+          generate_block();
+          wait_for( early, 2 );
+          wait_for( late, 2 );
+          wait_for( full, 2 );
+          const auto& delta = early[1].get_object();
+          BOOST_REQUIRE( delta.contains( "delta" ) );
+          BOOST_CHECK( delta["id"].as<object_id_type>() == dgp_id );
+          BOOST_CHECK_EQUAL( delta["delta"]["head_block_number"].as_uint64(), db.head_block_num() );
+          BOOST_CHECK( !delta["delta"].get_object().contains( "id" ) );
+          // the base of a delta is what this session was sent, the late session never got an object in delta mode
+          BOOST_CHECK( !late[1].get_object().contains( "delta" ) );
+          BOOST_CHECK( !full[1].get_object().contains( "delta" ) );
+          BOOST_CHECK_EQUAL( full[1]["head_block_number"].as_uint64(), db.head_block_num() );
+
+          generate_block();
+          wait_for( late, 3 );
+          BOOST_CHECK( late[2].get_object().contains( "delta" ) );
+      } FC_LOG_AND_RETHROW()
+  }
+
 BOOST_AUTO_TEST_SUITE_END()
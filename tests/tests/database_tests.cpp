@@ -27,9 +27,14 @@
 #include <graphene/chain/database.hpp>
 
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/contract_object.hpp>
+#include <graphene/chain/transaction_object.hpp>
 
 #include <fc/crypto/digest.hpp>
 
+#include <map>
+#include <random>
+
 #include "../common/database_fixture.hpp"
 
 using namespace graphene::chain;
@@ -59,3 +64,137 @@ BOOST_AUTO_TEST_CASE( undo_test )
       throw;
    }
 }
+
+BOOST_AUTO_TEST_CASE( merged_sessions_undo_test )
+{
+   try {
+      database db;
+      auto balances_of = [&]() {
+         std::map<object_id_type, int64_t> result;
+         for( const auto& b : db.get_index_type<account_balance_index>().indices() )
+            result[b.id] = b.balance.value;
+         return result;
+      };
+
+      auto setup = db._undo_db.start_undo_session();
+      vector<account_balance_id_type> ids;
+      for( int i = 0; i < 40; ++i )
+         ids.push_back( db.create<account_balance_object>( [&]( account_balance_object& obj ){ obj.balance = i; } ).id );
+      setup.commit();
+      auto before = balances_of();
+
+      // a block of transactions, some failing, each touching a few balances
+      auto block = db._undo_db.start_undo_session();
+      vector<account_balance_id_type> created;
+      for( int t = 0; t < 60; ++t )
+      {
+         auto trx = db._undo_db.start_undo_session();
+         for( int k = 0; k < 3; ++k )
+         {
+            auto id = ids[ (t * 7 + k * 13) % ids.size() ];
+            if( db.find( id ) )
+               db.modify( id( db ), [&]( account_balance_object& obj ){ obj.balance += 1000 + t; } );
+         }
+         if( t % 3 == 0 )
+            created.push_back( db.create<account_balance_object>( [&]( account_balance_object& obj ){ obj.balance = -t; } ).id );
+         if( t % 4 == 1 && !created.empty() && db.find( created.back() ) )
+            db.remove( created.back()( db ) );
+         if( t % 9 == 5 && db.find( ids[t % ids.size()] ) )
+            db.remove( ids[t % ids.size()]( db ) );
+         if( t % 5 == 4 )
+            trx.undo();
+         else
+            trx.merge();
+      }
+      BOOST_CHECK( balances_of() != before );
+
+      block.undo();
+      BOOST_CHECK( balances_of() == before );
+      auto next = db.create<account_balance_object>( [&]( account_balance_object& obj ){} ).id;
+      BOOST_CHECK( next == ids.back() + 1 );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( object_id_table_test )
+{
+   // the undo bookkeeping must answer and iterate like the ordered containers it replaced
+   std::mt19937 rng( 7 );
+   object_id_table<std::pair<object_id_type, int>> table;
+   std::map<object_id_type, int> expected;
+   for( int n = 0; n < 20000; ++n )
+   {
+      object_id_type id( 1 + rng() % 2, rng() % 4, rng() % 300 );
+      switch( rng() % 3 )
+      {
+      case 0:
+         table[id] = n;
+         expected[id] = n;
+         break;
+      case 1:
+         BOOST_REQUIRE_EQUAL( table.erase( id ), expected.erase( id ) == 1 );
+         break;
+      default:
+         auto found = table.find( id );
+         auto itr = expected.find( id );
+         BOOST_REQUIRE_EQUAL( found != nullptr, itr != expected.end() );
+         if( found )
+            BOOST_REQUIRE_EQUAL( found->second, itr->second );
+      }
+      if( n % 250 == 0 )
+      {
+         BOOST_REQUIRE_EQUAL( table.size(), expected.size() );
+         auto itr = expected.begin();
+         for( const auto& entry : table )
+         {
+            BOOST_REQUIRE( entry.first == itr->first );
+            BOOST_REQUIRE_EQUAL( entry.second, itr->second );
+            ++itr;
+         }
+      }
+   }
+}
+
+BOOST_AUTO_TEST_CASE( contract_storage_batch_test )
+{
+   try {
+      database db;
+      auto ses = db._undo_db.start_undo_session();
+      address contract( fc::ecc::private_key::regenerate( fc::sha256::hash( string( "contract" ) ) ).get_public_key() );
+      auto value_of = []( const string& s ) { return StorageDataType( s ); };
+
+      for( int i = 0; i < 40; i += 2 )
+         db.set_contract_storage( contract, "key" + fc::to_string( 100 + i ), value_of( "old" ) );
+      auto existing_id = db.get_contract_storage_object( contract, "key120" )->id;
+
+      // out of order, a mix of existing and new names, and a gap longer than the sequential walk
+      vector<contract_storage_write> writes;
+      for( const string& name : { "key139", "key120", "key000", "key121", "key101", "key199" } )
+      {
+         contract_storage_write write;
+         write.storage_name = name;
+         write.value = value_of( "new_" + name ).storage_data;
+         write.diff = value_of( "diff_" + name ).storage_data;
+         writes.push_back( std::move( write ) );
+      }
+      db.apply_contract_storage_changes( transaction_id_type(), contract, std::move( writes ) );
+
+      for( const string& name : { "key139", "key120", "key000", "key121", "key101", "key199" } )
+         BOOST_CHECK_EQUAL( db.get_contract_storage( contract, name ).as<string>(), "new_" + name );
+      BOOST_CHECK_EQUAL( db.get_contract_storage( contract, "key122" ).as<string>(), "old" );
+      BOOST_CHECK( db.get_contract_storage_object( contract, "key120" )->id == existing_id );
+      BOOST_CHECK_EQUAL( db.get_contract_all_storages( contract ).size(), 20u + 5u );
+      BOOST_CHECK_EQUAL( db.get_index_type<transaction_contract_storage_diff_index>().indices().size(), 6u );
+
+      ses.undo();
+      BOOST_CHECK( !db.get_contract_storage_object( contract, "key120" ).valid() );
+      BOOST_CHECK_EQUAL( db.get_index_type<transaction_contract_storage_diff_index>().indices().size(), 0u );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
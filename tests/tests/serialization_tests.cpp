@@ -148,4 +148,46 @@ BOOST_AUTO_TEST_CASE( extension_serialization_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( contract_storage_object_serialization_test )
+{
+   try
+   {
+      const string name = "users/XWCNbqZ5cqV4mJ7rAkLfDsb3ozKmdzoHWpa4b";
+      // one value fits the inline buffer, the other one does not
+      for( size_t value_size : { size_t(9), size_t(300) } )
+      {
+         std::vector<char> value( value_size );
+         for( size_t i = 0; i < value_size; ++i )
+            value[i] = char( i * 7 );
+
+         contract_storage_object obj;
+         obj.contract_address = address( fc::ecc::private_key::regenerate( fc::sha256::hash( string( "contract" ) ) ).get_public_key() );
+         obj.storage_name = name;
+         obj.storage_value = value;
+
+         // same bytes and json as the old string / vector<char> fields
+         auto packed = fc::raw::pack( obj );
+         std::vector<char> expected;
+         for( const auto& part : { fc::raw::pack( obj.id ), fc::raw::pack( obj.contract_address ), fc::raw::pack( name ), fc::raw::pack( value ) } )
+            expected.insert( expected.end(), part.begin(), part.end() );
+         BOOST_CHECK( packed == expected );
+         fc::variant var( obj );
+         BOOST_CHECK_EQUAL( var["storage_name"].as_string(), name );
+         BOOST_CHECK_EQUAL( var["storage_value"].as_string(), fc::variant( value ).as_string() );
+
+         auto unpacked = fc::raw::unpack<contract_storage_object>( packed );
+         BOOST_CHECK( unpacked.storage_value.to_vector() == value );
+         BOOST_CHECK( &unpacked.storage_name.str() == &obj.storage_name.str() );
+         auto from_json = var.as<contract_storage_object>();
+         BOOST_CHECK( from_json.storage_value == obj.storage_value );
+         BOOST_CHECK( from_json.storage_name == name );
+      }
+   }
+   catch ( const fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
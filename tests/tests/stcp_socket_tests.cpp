@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2017 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/stcp_socket.hpp>
+
+#include <fc/network/tcp_socket.hpp>
+#include <fc/network/ip.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using graphene::net::stcp_socket;
+
+/*
+ * write_gathered encodes the parts of a message in place and only stages the 16 byte blocks that
+ * straddle two parts and the padded last block. The peer must decrypt exactly what writesome of
+ * the concatenated, zero padded parts gives, so both are sent over one connection and compared.
+ */
+namespace {
+
+   const char* loopback = "127.0.0.1";
+
+   // the key exchange of each side waits for the other, so the accepting side runs as a task
+   void connect_pair( fc::tcp_server& server, stcp_socket& client, stcp_socket& accepted )
+   {
+      server.listen( fc::ip::endpoint( fc::ip::address( loopback ), 0 ) );
+      auto accepting = fc::async( [&]() {
+         server.accept( accepted.get_socket() );
+         accepted.accept();
+      } );
+      client.connect_to( fc::ip::endpoint( fc::ip::address( loopback ), server.get_port() ) );
+      accepting.wait();
+   }
+
+   std::vector<std::string> make_parts( const std::vector<size_t>& sizes )
+   {
+      std::vector<std::string> parts;
+      char next = 1;
+      for( size_t size : sizes )
+      {
+         std::string part( size, 0 );
+         for( auto& c : part )
+            c = next++;
+         parts.push_back( part );
+      }
+      return parts;
+   }
+
+   std::string padded_concatenation( const std::vector<std::string>& parts )
+   {
+      std::string all;
+      for( const auto& part : parts )
+         all += part;
+      all.resize( 16 * ( ( all.size() + 15 ) / 16 ), 0 );
+      return all;
+   }
+
+   std::string receive( stcp_socket& sock, size_t len )
+   {
+      std::string received( len, 0 );
+      sock.read( &received[0], len );
+      return received;
+   }
+
+   void check_gathered_matches_writesome( stcp_socket& sender, stcp_socket& receiver, const std::vector<size_t>& sizes )
+   {
+      auto parts = make_parts( sizes );
+      std::string expected = padded_concatenation( parts );
+      if( expected.empty() )
+         return;
+
+      std::vector<stcp_socket::write_part> write_parts;
+      for( const auto& part : parts )
+         write_parts.push_back( stcp_socket::write_part( part.data(), part.size() ) );
+      BOOST_CHECK_EQUAL( sender.write_gathered( write_parts ), expected.size() );
+      std::string gathered = receive( receiver, expected.size() );
+
+      for( size_t offset = 0; offset < expected.size(); )
+         offset += sender.writesome( expected.data() + offset, expected.size() - offset );
+      std::string written = receive( receiver, expected.size() );
+
+      BOOST_CHECK( written == expected );
+      BOOST_CHECK( gathered == written );
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(stcp_socket_tests)
+
+BOOST_AUTO_TEST_CASE( write_gathered_matches_writesome )
+{ try {
+   fc::tcp_server server;
+   stcp_socket client, accepted;
+   connect_pair( server, client, accepted );
+
+   const std::vector<std::vector<size_t>> cases = {
+      { 16 },                      // one aligned part
+      { 16, 32, 48 },              // aligned parts, nothing staged
+      { 1 },                       // one padded block
+      { 5, 7, 3 },                 // several parts within one padded block
+      { 24, 8 },                   // a block straddling two parts, no padding
+      { 10, 22, 17 },              // straddling blocks and padding
+      { 15, 1, 15, 1, 31 },        // parts ending one byte before or at a block boundary
+      { 0, 20, 0, 12 },            // empty parts
+      { 3, 40, 4096, 9 },          // a part longer than the write buffer
+      { 4090, 4100, 8191, 2 },     // straddling blocks around write buffer flushes
+   };
+   for( const auto& sizes : cases )
+   {
+      check_gathered_matches_writesome( client, accepted, sizes );
+      check_gathered_matches_writesome( accepted, client, sizes );
+   }
+
+   client.close();
+   accepted.close();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
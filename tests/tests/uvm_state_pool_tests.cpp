@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2017 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/uvm_chain_api.hpp>
+
+#include <uvm/lua.h>
+#include <uvm/lauxlib.h>
+#include <uvm/lstate.h>
+#include <uvm/uvm_lib.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace uvm::lua::lib;
+
+/*
+ * UvmStateScope takes its lua states from UvmStatePool, which rebuilds a released state in its
+ * wiped arena on a builder thread. Contract results must not depend on whether an invoke got such
+ * a state or a new one, so these tests dirty a pooled state and compare it with a state from
+ * create_lua_state.
+ */
+namespace {
+
+   // what an invoke can observe of a state, ending with the outcome of running the same code in it
+   struct state_fingerprint
+   {
+      std::vector<std::string> globals;
+      int top = 0;
+      int64_t used_size = 0;
+      uint64_t malloc_count = 0;
+      uint64_t free_count = 0;
+      int instructions_executed = 0;
+      int instructions_limit = 0;
+      bool in_sandbox = false;
+      bool notified_stop = false;
+      int test_value_type = 0;
+      int probe_status = 0;
+      std::string probe_result;
+      int64_t probe_used_size = 0;
+      uint64_t probe_malloc_count = 0;
+   };
+
+   const char* probe_code =
+      "local t = {} "
+      "for i = 1, 64 do t[i] = tostring(i * 7) .. 'x' end "
+      "local m = { a = 1, b = 2, [10] = 3 } "
+      "local s = '' "
+      "for k, v in pairs(m) do s = s .. tostring(k) .. '=' .. tostring(v) .. ';' end "
+      "return s .. tostring(#t) .. t[64] .. type(string.len) .. type(uvm) .. type(pairs) .. type(sha256_hex)";
+
+   std::string type_field( lua_State* L, const std::string& prefix )
+   {
+      std::string key = lua_type( L, -2 ) == LUA_TSTRING ? std::string( lua_tostring( L, -2 ) ) : std::string( lua_typename( L, lua_type( L, -2 ) ) );
+      return prefix + key + ":" + lua_typename( L, lua_type( L, -1 ) );
+   }
+
+   state_fingerprint fingerprint( lua_State* L )
+   {
+      state_fingerprint f;
+      f.top = lua_gettop( L );
+      lua_getglobal( L, "_G" );
+      int globals = lua_gettop( L );
+      lua_pushnil( L );
+      while( lua_next( L, globals ) )
+      {
+         f.globals.push_back( type_field( L, "" ) );
+         if( lua_type( L, -1 ) == LUA_TTABLE && lua_type( L, -2 ) == LUA_TSTRING && std::string( lua_tostring( L, -2 ) ) != "_G" )
+         {
+            std::string prefix = std::string( lua_tostring( L, -2 ) ) + ".";
+            int library = lua_gettop( L );
+            lua_pushnil( L );
+            while( lua_next( L, library ) )
+            {
+               f.globals.push_back( type_field( L, prefix ) );
+               lua_pop( L, 1 );
+            }
+         }
+         lua_pop( L, 1 );
+      }
+      lua_pop( L, 1 );
+
+      f.used_size = L->gc_state->usedsize();
+      f.malloc_count = L->gc_state->malloc_count();
+      f.free_count = L->gc_state->free_count();
+      f.instructions_executed = get_lua_state_instructions_executed_count( L );
+      f.instructions_limit = get_lua_state_instructions_limit( L );
+      f.in_sandbox = check_in_lua_sandbox( L );
+      f.notified_stop = check_lua_state_notified_stop( L );
+      f.test_value_type = get_lua_state_value_node( L, "pool_test_value" ).type;
+
+      f.probe_status = luaL_dostring( L, probe_code );
+      if( lua_type( L, -1 ) == LUA_TSTRING )
+         f.probe_result = lua_tostring( L, -1 );
+      f.probe_used_size = L->gc_state->usedsize();
+      f.probe_malloc_count = L->gc_state->malloc_count();
+      return f;
+   }
+
+   void check_same( const state_fingerprint& pooled, const state_fingerprint& fresh )
+   {
+      BOOST_REQUIRE_EQUAL( pooled.globals.size(), fresh.globals.size() );
+      for( size_t i = 0; i < fresh.globals.size(); i++ )
+         BOOST_REQUIRE_EQUAL( pooled.globals[i], fresh.globals[i] );
+      BOOST_CHECK_EQUAL( pooled.top, fresh.top );
+      BOOST_CHECK_EQUAL( pooled.used_size, fresh.used_size );
+      BOOST_CHECK_EQUAL( pooled.malloc_count, fresh.malloc_count );
+      BOOST_CHECK_EQUAL( pooled.free_count, fresh.free_count );
+      BOOST_CHECK_EQUAL( pooled.instructions_executed, fresh.instructions_executed );
+      BOOST_CHECK_EQUAL( pooled.instructions_limit, fresh.instructions_limit );
+      BOOST_CHECK_EQUAL( pooled.in_sandbox, fresh.in_sandbox );
+      BOOST_CHECK_EQUAL( pooled.notified_stop, fresh.notified_stop );
+      BOOST_CHECK_EQUAL( pooled.test_value_type, fresh.test_value_type );
+      BOOST_CHECK_EQUAL( pooled.probe_status, fresh.probe_status );
+      BOOST_CHECK_EQUAL( pooled.probe_result, fresh.probe_result );
+      BOOST_CHECK_EQUAL( pooled.probe_used_size, fresh.probe_used_size );
+      BOOST_CHECK_EQUAL( pooled.probe_malloc_count, fresh.probe_malloc_count );
+   }
+
+   // leaves behind everything an invoke can change: globals, libraries, stack, memory and state values
+   void dirty( lua_State* L, bool use_contract )
+   {
+      if( !use_contract )
+         luaL_dostring( L, "x = {} for i = 1, 2000 do x[i] = string.rep('y', i % 40) .. i end pairs = nil uvm = 1" );
+      lua_getglobal( L, "string" );
+      lua_pushnil( L );
+      lua_setfield( L, -2, "len" );
+      lua_pop( L, 1 );
+      lua_checkstack( L, 5000 );
+      for( int i = 0; i < 3000; i++ )
+         lua_pushinteger( L, i );
+      lua_createtable( L, 0, 0 );
+      lua_pushstring( L, std::string( 100000, 'z' ).c_str() );
+      L->gc_state->gc_malloc( 300 * 1024 );
+
+      UvmStateValue value;
+      value.int_value = 7;
+      set_lua_state_value( L, "pool_test_value", value, LUA_STATE_VALUE_INT );
+      set_lua_state_instructions_limit( L, 1000 );
+      GasManager( L ).add_gas( 123 );
+      enter_lua_sandbox( L );
+      notify_lua_state_stop( L );
+   }
+
+   void check_pooled_state_matches_fresh( bool use_contract )
+   {
+      if( !uvm::lua::api::global_uvm_chain_api )
+         uvm::lua::api::global_uvm_chain_api = new graphene::chain::UvmChainApi();
+
+      UvmStatePool pool( 1 );
+      for( int round = 0; round < 3; round++ )
+      {
+         lua_State* L = pool.acquire( use_contract );
+         BOOST_REQUIRE( L != nullptr );
+         dirty( L, use_contract );
+         pool.release( L, use_contract );
+         BOOST_REQUIRE_EQUAL( pool.idle_count( use_contract ), 1u );
+         BOOST_CHECK_EQUAL( pool.idle_count( !use_contract ), 0u );
+
+         lua_State* pooled = pool.acquire( use_contract );
+         BOOST_CHECK_EQUAL( pool.idle_count( use_contract ), 0u );
+         lua_State* fresh = create_lua_state( use_contract );
+         auto pooled_fingerprint = fingerprint( pooled );
+         auto fresh_fingerprint = fingerprint( fresh );
+         BOOST_CHECK( !fresh_fingerprint.globals.empty() );
+         check_same( pooled_fingerprint, fresh_fingerprint );
+         close_lua_state( fresh );
+         pool.release( pooled, use_contract );
+      }
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(uvm_state_pool_tests)
+
+BOOST_AUTO_TEST_CASE( pooled_state_matches_fresh_state )
+{
+   check_pooled_state_matches_fresh( false );
+}
+
+BOOST_AUTO_TEST_CASE( pooled_contract_state_matches_fresh_state )
+{
+   check_pooled_state_matches_fresh( true );
+}
+
+BOOST_AUTO_TEST_CASE( full_pool_closes_released_states )
+{
+   if( !uvm::lua::api::global_uvm_chain_api )
+      uvm::lua::api::global_uvm_chain_api = new graphene::chain::UvmChainApi();
+
+   UvmStatePool pool( 1 );
+   lua_State* first = pool.acquire( true );
+   lua_State* second = pool.acquire( true );
+   pool.release( first, true );
+   pool.release( second, true );
+   BOOST_CHECK_EQUAL( pool.idle_count( true ), 1u );
+   pool.clear();
+   BOOST_CHECK_EQUAL( pool.idle_count( true ), 0u );
+}
+
+BOOST_AUTO_TEST_CASE( released_arena_is_rebuilt_for_the_next_acquire )
+{
+   if( !uvm::lua::api::global_uvm_chain_api )
+      uvm::lua::api::global_uvm_chain_api = new graphene::chain::UvmChainApi();
+
+   // the builder thread may or may not have got to the arena when acquire runs, both must hand it out
+   UvmStatePool pool( 2 );
+   for( int round = 0; round < 50; round++ )
+   {
+      lua_State* first = pool.acquire( true );
+      lua_State* second = pool.acquire( true );
+      auto first_arena = first->gc_state;
+      auto second_arena = second->gc_state;
+      pool.release( first, true );
+      pool.release( second, true );
+      BOOST_CHECK_EQUAL( pool.idle_count( true ), 2u );
+
+      lua_State* again = pool.acquire( true );
+      BOOST_CHECK( again->gc_state == first_arena || again->gc_state == second_arena );
+      BOOST_CHECK_EQUAL( luaL_dostring( again, probe_code ), 0 );
+      pool.release( again, true );
+   }
+   pool.clear();
+   BOOST_CHECK_EQUAL( pool.idle_count( true ), 0u );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2017 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/uvm_chain_api.hpp>
+
+#include <uvm/lua.h>
+#include <uvm/lauxlib.h>
+#include <uvm/lstate.h>
+#include <uvm/uvm_lib.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace uvm::lua::lib;
+
+/*
+ * The interpreter runs straight-line runs of MOVE, LOADK, LOADBOOL, LOADNIL, GETUPVAL, NOT, JMP, TEST and
+ * TESTSET in one step. Gas is the instruction count, so these tests run the same code with the runs on and
+ * off and compare everything a contract call can observe, for every instruction limit up to the cost of
+ * the code, which makes the limit fall inside the runs as well.
+ */
+namespace {
+
+   struct run_outcome
+   {
+      int status = 0;
+      int instructions_executed = 0;
+      std::string result;
+      int exception_code = 0;
+      std::string exception_msg;
+      std::string compile_error;
+   };
+
+   run_outcome run( const char* code, bool straight_runs, int instructions_limit )
+   {
+      uvm::lua::api::global_uvm_chain_api->clear_exceptions( nullptr );
+      lua_State* L = create_lua_state( false );
+      L->disable_straight_runs = !straight_runs;
+      if( instructions_limit > 0 )
+         set_lua_state_instructions_limit( L, instructions_limit );
+
+      run_outcome outcome;
+      outcome.status = luaL_dostring( L, code );
+      for( int i = 1; i <= lua_gettop( L ); i++ )
+      {
+         outcome.result += lua_typename( L, lua_type( L, i ) );
+         if( lua_type( L, i ) == LUA_TSTRING || lua_type( L, i ) == LUA_TNUMBER )
+            outcome.result += std::string( ":" ) + lua_tostring( L, i );
+         outcome.result += ";";
+      }
+      outcome.instructions_executed = get_lua_state_instructions_executed_count( L );
+      outcome.exception_code = get_lua_state_value( L, "exception_code" ).int_value;
+      const char* msg = get_lua_state_value( L, "exception_msg" ).string_value;
+      outcome.exception_msg = msg ? msg : "";
+      outcome.compile_error = L->compile_error;
+      close_lua_state( L );
+      uvm::lua::api::global_uvm_chain_api->clear_exceptions( nullptr );
+      return outcome;
+   }
+
+   template<typename T>
+   void check_field( const char* field, const T& straight, const T& stepped, int instructions_limit )
+   {
+      BOOST_CHECK_MESSAGE( straight == stepped, field << " differs with instructions limit " << instructions_limit
+                           << ": " << straight << " with straight runs, " << stepped << " without" );
+   }
+
+   void check_same( const run_outcome& straight, const run_outcome& stepped, int instructions_limit )
+   {
+      check_field( "status", straight.status, stepped.status, instructions_limit );
+      check_field( "instructions executed", straight.instructions_executed, stepped.instructions_executed, instructions_limit );
+      check_field( "result", straight.result, stepped.result, instructions_limit );
+      check_field( "exception code", straight.exception_code, stepped.exception_code, instructions_limit );
+      check_field( "exception message", straight.exception_msg, stepped.exception_msg, instructions_limit );
+      check_field( "compile error", straight.compile_error, stepped.compile_error, instructions_limit );
+   }
+
+   void check_straight_runs_match_single_steps( const char* code )
+   {
+      if( !uvm::lua::api::global_uvm_chain_api )
+         uvm::lua::api::global_uvm_chain_api = new graphene::chain::UvmChainApi();
+
+      auto straight = run( code, true, 0 );
+      auto stepped = run( code, false, 0 );
+      check_same( straight, stepped, 0 );
+      BOOST_REQUIRE_GT( stepped.instructions_executed, 0 );
+      // every limit below the cost stops the code, some of them in the middle of a run
+      for( int limit = 1; limit <= stepped.instructions_executed + 1; limit++ )
+         check_same( run( code, true, limit ), run( code, false, limit ), limit );
+   }
+
+   // long runs of moves, constants, booleans, nils, not and tests between the loop and arithmetic instructions
+   const char* locals_code =
+      "local a, b, c, d = 1, 'two', nil, false "
+      "local s = 0 "
+      "for i = 1, 12 do "
+      "  local x = a local y = b local z = not c local w = not d "
+      "  local p, q, r = nil, true, x "
+      "  local t = c or w local u = d and x or y local v = q and z "
+      "  if t then s = s + i end "
+      "  if not u then s = s - 1 elseif v then s = s + 2 end "
+      "  local m = y local n = m local o = n "
+      "end "
+      "return s, a, b";
+
+   // GETUPVAL runs inside closures, calls between runs
+   const char* upvalues_code =
+      "local base, flag, name = 10, true, 'up' "
+      "local function f(k) "
+      "  local x = base local y = flag local z = name local w = not y "
+      "  if w then return k end "
+      "  local r = y and x or z "
+      "  return r + k "
+      "end "
+      "local total = 0 "
+      "for i = 1, 8 do total = total + f(i) end "
+      "return total, tostring(flag)";
+
+   // tail calls switch the closure without a new frame, runs in the caller, the callee and after the return
+   const char* tailcall_code =
+      "local function g(v) local a = v local b = a local c = not b if c then return 0 end return b + 1 end "
+      "local function f(v) local x = v local y = x local z = not y return g(y) end "
+      "local s = 0 "
+      "for i = 1, 6 do local m = s local n = m s = n + f(i) end "
+      "return s";
+
+   // a runtime error right after a run
+   const char* error_code =
+      "local a, b, c = 1, 2, nil "
+      "local x = a local y = b local z = not c "
+      "local t = c "
+      "return t.field";
+
+   // an error raised by a called function, with runs in both frames
+   const char* call_error_code =
+      "local function fail(v) local a = v local b = a local c = not b error('boom') end "
+      "local x, y = 1, true local z = not y local w = z or x "
+      "fail(w) "
+      "return z";
+}
+
+BOOST_AUTO_TEST_SUITE(uvm_straight_run_tests)
+
+BOOST_AUTO_TEST_CASE( locals_match_single_steps )
+{
+   check_straight_runs_match_single_steps( locals_code );
+}
+
+BOOST_AUTO_TEST_CASE( upvalues_match_single_steps )
+{
+   check_straight_runs_match_single_steps( upvalues_code );
+}
+
+BOOST_AUTO_TEST_CASE( tail_calls_match_single_steps )
+{
+   check_straight_runs_match_single_steps( tailcall_code );
+}
+
+BOOST_AUTO_TEST_CASE( errors_match_single_steps )
+{
+   check_straight_runs_match_single_steps( error_code );
+   check_straight_runs_match_single_steps( call_error_code );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,402 @@
+/*
+ * Copyright (c) 2017 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <uvm/lua.h>
+#include <uvm/lauxlib.h>
+#include <uvm/lobject.h>
+#include <uvm/lstate.h>
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Contract results hang on how uvm tables answer lookups, '#' and 'next', so these tests replay
+ * random writes against a model of the tables as they were kept before the flat hash part
+ * (a key string -> key map in front of a map sorted like table_sort_comparator) and check
+ * that the vm answers the same.
+ */
+namespace {
+
+   struct model_key
+   {
+      bool is_int;
+      int64_t i;
+      std::string s;
+   };
+
+   struct model_key_order
+   {
+      bool operator()( const model_key& x, const model_key& y ) const
+      {
+         if( x.is_int != y.is_int )
+            return x.is_int;
+         if( x.is_int )
+            return x.i < y.i;
+         if( x.s.size() != y.s.size() )
+            return x.s.size() < y.s.size();
+         return x.s < y.s;
+      }
+   };
+
+   struct model_value
+   {
+      bool is_nil = true;
+      int64_t v = 0;
+   };
+
+   struct model_table
+   {
+      std::vector<model_value> array;
+      std::map<model_key, model_value, model_key_order> entries;
+      std::map<std::string, model_key> keys;
+
+      static std::string key_string( const model_key& k ) { return k.is_int ? std::to_string(k.i) : k.s; }
+
+      model_value* find( const model_key& k )
+      {
+         if( k.is_int && k.i >= 1 && uint64_t(k.i) <= array.size() )
+            return &array[size_t(k.i - 1)];
+         auto it = keys.find( key_string(k) );
+         if( it == keys.end() )
+            return nullptr;
+         return &entries[it->second];
+      }
+
+      model_value get( const model_key& k )
+      {
+         auto v = find(k);
+         return v ? *v : model_value();
+      }
+
+      void set( const model_key& k, const model_value& v )
+      {
+         auto cell = find(k);
+         if( !cell )
+         {
+            if( k.is_int && uint64_t(k.i) == array.size() + 1 )
+            {
+               array.push_back( model_value() );
+               cell = &array.back();
+            }
+            else
+            {
+               keys[key_string(k)] = k;
+               cell = &entries[k];
+            }
+         }
+         *cell = v;
+      }
+
+      int64_t length()
+      {
+         uint64_t j = array.size();
+         if( j > 0 && array[j - 1].is_nil )
+         {
+            uint64_t i = 0;
+            while( j - i > 1 )
+            {
+               uint64_t m = (i + j) / 2;
+               if( array[m - 1].is_nil ) j = m;
+               else i = m;
+            }
+            return i;
+         }
+         if( entries.empty() )
+            return j;
+         uint64_t i = j;
+         j++;
+         while( !get_int(j).is_nil )
+         {
+            i = j;
+            j *= 2;
+         }
+         while( j - i > 1 )
+         {
+            uint64_t m = (i + j) / 2;
+            if( get_int(m).is_nil ) j = m;
+            else i = m;
+         }
+         return i;
+      }
+
+      model_value get_int( int64_t i ) { return get( model_key{ true, i, std::string() } ); }
+
+      std::vector<std::pair<model_key, int64_t>> traversal()
+      {
+         std::vector<std::pair<model_key, int64_t>> result;
+         for( size_t i = 0; i < array.size(); i++ )
+            if( !array[i].is_nil )
+               result.push_back( std::make_pair( model_key{ true, int64_t(i + 1), std::string() }, array[i].v ) );
+         for( const auto& e : entries )
+            if( !e.second.is_nil )
+               result.push_back( std::make_pair( e.first, e.second.v ) );
+         return result;
+      }
+   };
+
+   void push_key( lua_State* L, const model_key& k )
+   {
+      if( k.is_int )
+         lua_pushinteger( L, k.i );
+      else
+         lua_pushstring( L, k.s.c_str() );
+   }
+
+   model_value vm_get( lua_State* L, int table, const model_key& k )
+   {
+      if( k.is_int )
+         lua_rawgeti( L, table, k.i );
+      else
+      {
+         push_key( L, k );
+         lua_rawget( L, table );
+      }
+      model_value v;
+      if( !lua_isnil( L, -1 ) )
+      {
+         v.is_nil = false;
+         v.v = lua_tointeger( L, -1 );
+      }
+      lua_pop( L, 1 );
+      return v;
+   }
+
+   void vm_set( lua_State* L, int table, const model_key& k, const model_value& v )
+   {
+      if( !k.is_int )
+         push_key( L, k );
+      if( v.is_nil )
+         lua_pushnil( L );
+      else
+         lua_pushinteger( L, v.v );
+      if( k.is_int )
+         lua_rawseti( L, table, k.i );
+      else
+         lua_rawset( L, table );
+   }
+
+   std::vector<std::pair<model_key, int64_t>> vm_traversal( lua_State* L, int table )
+   {
+      std::vector<std::pair<model_key, int64_t>> result;
+      lua_pushnil( L );
+      while( lua_next( L, table ) )
+      {
+         model_key k{ lua_type( L, -2 ) == LUA_TNUMBER, 0, std::string() };
+         if( k.is_int )
+            k.i = lua_tointeger( L, -2 );
+         else
+            k.s = lua_tostring( L, -2 );
+         result.push_back( std::make_pair( k, int64_t(lua_tointeger( L, -1 )) ) );
+         lua_pop( L, 1 );
+      }
+      return result;
+   }
+
+   void check_same( lua_State* L, int table, model_table& model, const std::vector<model_key>& keys )
+   {
+      for( const auto& k : keys )
+      {
+         auto expected = model.get(k);
+         auto actual = vm_get( L, table, k );
+         BOOST_REQUIRE_EQUAL( actual.is_nil, expected.is_nil );
+         BOOST_REQUIRE_EQUAL( actual.v, expected.v );
+      }
+      BOOST_REQUIRE_EQUAL( int64_t(lua_rawlen( L, table )), model.length() );
+      auto expected = model.traversal();
+      auto actual = vm_traversal( L, table );
+      BOOST_REQUIRE_EQUAL( actual.size(), expected.size() );
+      for( size_t i = 0; i < expected.size(); i++ )
+      {
+         BOOST_REQUIRE_EQUAL( actual[i].first.is_int, expected[i].first.is_int );
+         BOOST_REQUIRE_EQUAL( actual[i].first.i, expected[i].first.i );
+         BOOST_REQUIRE_EQUAL( actual[i].first.s, expected[i].first.s );
+         BOOST_REQUIRE_EQUAL( actual[i].second, expected[i].second );
+      }
+   }
+
+   void replay_random_writes( const std::vector<model_key>& keys, uint32_t seed, size_t writes )
+   {
+      lua_State* L = luaL_newstate();
+      lua_createtable( L, 0, 0 );
+      int table = lua_gettop( L );
+      model_table model;
+      std::mt19937 rng( seed );
+      for( size_t n = 0; n < writes; n++ )
+      {
+         const model_key& k = keys[ rng() % keys.size() ];
+         model_value v;
+         if( rng() % 5 != 0 )
+         {
+            v.is_nil = false;
+            v.v = int64_t(n);
+         }
+         vm_set( L, table, k, v );
+         model.set( k, v );
+         if( n % 16 == 0 )
+            check_same( L, table, model, keys );
+      }
+      check_same( L, table, model, keys );
+      lua_close( L );
+   }
+
+   model_key int_key( int64_t i ) { return model_key{ true, i, std::string() }; }
+   model_key str_key( const std::string& s ) { return model_key{ false, 0, s }; }
+}
+
+BOOST_AUTO_TEST_SUITE(uvm_table_tests)
+
+BOOST_AUTO_TEST_CASE( sparse_integer_keys_match_previous_tables )
+{
+   std::vector<model_key> keys;
+   for( int64_t i = -3; i <= 40; i++ )
+      keys.push_back( int_key(i) );
+   for( int64_t i : { int64_t(1000), int64_t(1001), int64_t(1) << 40, INT64_MAX, INT64_MIN } )
+      keys.push_back( int_key(i) );
+   for( uint32_t seed = 1; seed <= 20; seed++ )
+      replay_random_writes( keys, seed, 600 );
+}
+
+BOOST_AUTO_TEST_CASE( string_and_integer_keys_match_previous_tables )
+{
+   // strings spelling integers share the integer's entry, whichever came first
+   std::vector<model_key> keys = { int_key(1), int_key(2), int_key(3), int_key(7), int_key(12), int_key(-3), int_key(100),
+                                   str_key("a"), str_key("b"), str_key("ab"), str_key("key1"), str_key("7"), str_key("12"),
+                                   str_key("-3"), str_key("05"), str_key("-0"), str_key("3"), str_key(""), str_key("100") };
+   for( uint32_t seed = 1; seed <= 20; seed++ )
+      replay_random_writes( keys, seed, 400 );
+}
+
+BOOST_AUTO_TEST_CASE( short_strings_are_pooled_by_contents )
+{
+   lua_State* L = luaL_newstate();
+   L->gc_state->set_exact_string_pool( true );
+   lua_pushstring( L, "ab" );
+   lua_pushstring( L, "abc" );
+   lua_pushlstring( L, "ab\0c", 4 );
+   lua_pushstring( L, "ab" );
+   lua_pushlstring( L, "ab\0c", 4 );
+   BOOST_CHECK( lua_tostring( L, 1 ) == lua_tostring( L, 4 ) );
+   BOOST_CHECK( lua_tostring( L, 3 ) == lua_tostring( L, 5 ) );
+   BOOST_CHECK( lua_tostring( L, 1 ) != lua_tostring( L, 2 ) );
+   BOOST_CHECK( lua_tostring( L, 1 ) != lua_tostring( L, 3 ) );
+   BOOST_CHECK( lua_rawequal( L, 1, 4 ) );
+   BOOST_CHECK( !lua_rawequal( L, 1, 2 ) );
+   BOOST_CHECK( !lua_rawequal( L, 1, 3 ) );
+
+   // long strings are not pooled and still compare by contents
+   std::string long_string( 100, 'x' );
+   lua_pushstring( L, long_string.c_str() );
+   lua_pushstring( L, long_string.c_str() );
+   BOOST_CHECK( lua_tostring( L, 6 ) != lua_tostring( L, 7 ) );
+   BOOST_CHECK( lua_rawequal( L, 6, 7 ) );
+   lua_close( L );
+}
+
+BOOST_AUTO_TEST_CASE( colliding_short_strings_are_pooled_apart )
+{
+   // luaS_hash with seed 1 is the hash the string pool files short strings under. The old pool kept
+   // one string per hash and matched with strncmp over the new string's length, which stops at a '\0'
+   const std::string first( "zbicvf" ), second( "bxhcvf" );
+   const std::string prefix( "ab" ), extended( "ab\0c!7O+q#CR]~", 14 );
+   BOOST_REQUIRE_EQUAL( luaS_hash( first.data(), first.size(), 1 ), luaS_hash( second.data(), second.size(), 1 ) );
+   BOOST_REQUIRE_EQUAL( luaS_hash( prefix.data(), prefix.size(), 1 ), luaS_hash( extended.data(), extended.size(), 1 ) );
+
+   // a colliding string does not replace the pooled one
+   lua_State* L = luaL_newstate();
+   L->gc_state->set_exact_string_pool( true );
+   lua_pushlstring( L, first.data(), first.size() );
+   lua_pushlstring( L, second.data(), second.size() );
+   lua_pushlstring( L, first.data(), first.size() );
+   lua_pushlstring( L, second.data(), second.size() );
+   BOOST_CHECK( lua_tostring( L, 1 ) == lua_tostring( L, 3 ) );
+   BOOST_CHECK( lua_tostring( L, 2 ) == lua_tostring( L, 4 ) );
+   BOOST_CHECK( lua_tostring( L, 1 ) != lua_tostring( L, 2 ) );
+   BOOST_CHECK( !lua_rawequal( L, 1, 2 ) );
+   BOOST_CHECK_EQUAL( lua_tostring( L, 2 ), second );
+   lua_close( L );
+
+   // neither the prefix nor the string with the embedded '\0' is handed the other, whichever is pooled first
+   for( int prefix_first = 0; prefix_first < 2; prefix_first++ )
+   {
+      const std::string& pooled = prefix_first ? prefix : extended;
+      const std::string& added = prefix_first ? extended : prefix;
+      L = luaL_newstate();
+      L->gc_state->set_exact_string_pool( true );
+      lua_pushlstring( L, pooled.data(), pooled.size() );
+      lua_pushlstring( L, added.data(), added.size() );
+      lua_pushlstring( L, added.data(), added.size() );
+      size_t len = 0;
+      const char* value = lua_tolstring( L, 2, &len );
+      BOOST_CHECK( std::string( value, len ) == added );
+      BOOST_CHECK( lua_tostring( L, 1 ) != value );
+      BOOST_CHECK( lua_tostring( L, 3 ) == value );
+      BOOST_CHECK( !lua_rawequal( L, 1, 2 ) );
+      lua_close( L );
+   }
+}
+
+BOOST_AUTO_TEST_CASE( legacy_string_pool_is_kept_before_the_fork )
+{
+   // without the EXACT_STRING_POOL fork a state pools strings the way it always did
+   const std::string first( "zbicvf" ), second( "bxhcvf" );
+   const std::string prefix( "ab" ), extended( "ab\0c!7O+q#CR]~", 14 );
+
+   // the last string of a hash replaces the pooled one, equal strings still compare equal
+   lua_State* L = luaL_newstate();
+   BOOST_REQUIRE( !L->gc_state->exact_string_pool() );
+   lua_pushlstring( L, first.data(), first.size() );
+   lua_pushlstring( L, second.data(), second.size() );
+   lua_pushlstring( L, first.data(), first.size() );
+   lua_pushlstring( L, second.data(), second.size() );
+   lua_pushlstring( L, second.data(), second.size() );
+   BOOST_CHECK( lua_tostring( L, 1 ) != lua_tostring( L, 3 ) );
+   BOOST_CHECK( lua_tostring( L, 2 ) != lua_tostring( L, 4 ) );
+   BOOST_CHECK( lua_tostring( L, 4 ) == lua_tostring( L, 5 ) );
+   BOOST_CHECK( lua_rawequal( L, 1, 3 ) );
+   BOOST_CHECK( lua_rawequal( L, 2, 4 ) );
+   BOOST_CHECK( !lua_rawequal( L, 1, 2 ) );
+   lua_close( L );
+
+   // a prefix up to a '\0' is handed the pooled string, whichever is pooled first
+   for( int prefix_first = 0; prefix_first < 2; prefix_first++ )
+   {
+      const std::string& pooled = prefix_first ? prefix : extended;
+      const std::string& added = prefix_first ? extended : prefix;
+      L = luaL_newstate();
+      lua_pushlstring( L, pooled.data(), pooled.size() );
+      lua_pushlstring( L, added.data(), added.size() );
+      size_t len = 0;
+      const char* value = lua_tolstring( L, 2, &len );
+      BOOST_CHECK( std::string( value, len ) == pooled );
+      BOOST_CHECK( lua_tostring( L, 1 ) == value );
+      lua_close( L );
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()